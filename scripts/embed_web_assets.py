@@ -0,0 +1,76 @@
+"""Compress the pages in web/ and embed them as flash-resident byte arrays.
+
+Runs as a PlatformIO pre-build script (extra_scripts = pre:scripts/embed_web_assets.py)
+and can also be run directly: python3 scripts/embed_web_assets.py
+
+For every web/<name>.html this generates WEB_ASSET_<NAME> in
+src/web_assets_data.h: the gzip-compressed page, its content type and an
+ETag derived from the compressed bytes. The output is only rewritten when
+it changes, so unchanged pages do not trigger a rebuild.
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUTPUT = os.path.join(PROJECT_DIR, "src", "web_assets_data.h")
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+}
+
+
+def byte_lines(data, per_line=16):
+    for i in range(0, len(data), per_line):
+        yield "    " + ", ".join("0x%02x" % b for b in data[i:i + per_line]) + ","
+
+
+def generate():
+    lines = [
+        "// Generated by scripts/embed_web_assets.py from web/. Do not edit.",
+        "#pragma once",
+        "",
+        '#include "web_assets.h"',
+        "",
+    ]
+    for filename in sorted(os.listdir(WEB_DIR)):
+        stem, extension = os.path.splitext(filename)
+        if extension not in CONTENT_TYPES:
+            continue
+        with open(os.path.join(WEB_DIR, filename), "rb") as f:
+            raw = f.read()
+        # mtime=0 keeps the output (and the ETag) reproducible
+        compressed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '\\"%s\\"' % hashlib.sha1(compressed).hexdigest()[:16]
+        name = stem.upper()
+
+        lines.append("// %s: %d bytes, %d gzipped" % (filename, len(raw), len(compressed)))
+        lines.append("static const uint8_t %s_GZ[] PROGMEM = {" % name)
+        lines.extend(byte_lines(compressed))
+        lines.append("};")
+        lines.append("const WebAsset WEB_ASSET_%s = {" % name)
+        lines.append('    "%s", %s_GZ, sizeof(%s_GZ), %d, "%s"' % (
+            CONTENT_TYPES[extension], name, name, len(raw), etag))
+        lines.append("};")
+        lines.append("")
+
+    content = "\n".join(lines)
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            if f.read() == content:
+                return
+    with open(OUTPUT, "w") as f:
+        f.write(content)
+    print("Embedded web assets into %s" % os.path.relpath(OUTPUT, PROJECT_DIR))
+
+
+generate()
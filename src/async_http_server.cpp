@@ -0,0 +1,588 @@
+#include "async_http_server.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "esp_heap_caps.h"
+
+#define SELECT_TIMEOUT_MS 1000
+
+// Output buffer layout: room for the headers, then the body
+#define OUTPUT_HEADER_RESERVE 384
+#define OUTPUT_INITIAL_SIZE 1024
+#define OUTPUT_MAX_SIZE (OUTPUT_HEADER_RESERVE + ASYNC_HTTP_MAX_RESPONSE_SIZE)
+
+// Grow `out` to at least `size` bytes, preferring PSRAM. On failure the
+// buffer is left as it was.
+static bool reserveOutput(AsyncHttpOutput& out, size_t size) {
+    if (size <= out.capacity) {
+        return true;
+    }
+    if (size > OUTPUT_MAX_SIZE) {
+        return false;
+    }
+    size_t capacity = out.capacity > 0 ? out.capacity : OUTPUT_INITIAL_SIZE;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    if (capacity > OUTPUT_MAX_SIZE) {
+        capacity = OUTPUT_MAX_SIZE;
+    }
+    char* data = nullptr;
+    if (psramFound()) {
+        data = (char*)heap_caps_realloc(out.data, capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (data == nullptr) {
+        data = (char*)heap_caps_realloc(out.data, capacity, MALLOC_CAP_8BIT);
+    }
+    if (data == nullptr) {
+        return false;
+    }
+    out.data = data;
+    out.capacity = capacity;
+    return true;
+}
+
+static void releaseOutput(AsyncHttpOutput& out) {
+    free(out.data);
+    out = {};
+}
+
+static const char* statusText(int statusCode) {
+    switch (statusCode) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 503: return "Service Unavailable";
+        default: return statusCode >= 500 ? "Internal Server Error" : "Unknown";
+    }
+}
+
+// Renders an HTTP/1.1 response into a connection's output buffer; nothing
+// is sent until the handler has returned and the RouteLock is released.
+// Since the whole body is in hand, every response gets a Content-Length.
+// The headers are formatted last, into the room reserved before the body.
+class SocketResponseSink : public ResponseSink {
+public:
+    SocketResponseSink(AsyncHttpOutput& out, int fd, bool keepAlive) : _out(out), _fd(fd), _keepAlive(keepAlive) {}
+
+    void addHeader(const char* name, const char* value) override {
+        if (_begun) {
+            return;
+        }
+        int written = snprintf(_extraHeaders + _extraUsed, sizeof(_extraHeaders) - _extraUsed,
+                               "%s: %s\r\n", name, value);
+        if (written > 0 && _extraUsed + written < sizeof(_extraHeaders)) {
+            _extraUsed += written;
+        } else {
+            _extraHeaders[_extraUsed] = '\0';  // Drop a header that does not fit
+        }
+    }
+
+    void begin(int statusCode, const char* contentType, size_t length = UNKNOWN_LENGTH) override {
+        if (_begun) {
+            return;
+        }
+        _begun = true;
+        _statusCode = statusCode;
+        _contentType = contentType;
+    }
+
+    size_t write(const char* data, size_t length) override {
+        if (!_begun) {
+            begin(200, "application/json");
+        }
+        if (_overflow || !reserveOutput(_out, OUTPUT_HEADER_RESERVE + _bodyLength + length)) {
+            _overflow = true;
+            return 0;
+        }
+        memcpy(_out.data + OUTPUT_HEADER_RESERVE + _bodyLength, data, length);
+        _bodyLength += length;
+        return length;
+    }
+    using ResponseSink::write;
+
+    void end() override {
+        if (_detached) {
+            return;
+        }
+        if (!_begun) {
+            sendError(500, "No response");
+        }
+        if (_overflow) {
+            // Nothing was sent yet, so the response can still be replaced
+            Serial.printf("Async HTTP: response over %u bytes or out of memory, answered with 500\n",
+                          (unsigned)ASYNC_HTTP_MAX_RESPONSE_SIZE);
+            static const char BODY[] = "{\"status\":\"error\",\"message\":\"Response too large\"}";
+            _overflow = false;
+            _bodyLength = 0;
+            _extraUsed = 0;
+            _extraHeaders[0] = '\0';
+            _keepAlive = false;
+            _statusCode = 500;
+            _contentType = "application/json";
+            write(BODY, sizeof(BODY) - 1);
+            if (_overflow) {
+                return;  // Not even room for that; ready() stays false
+            }
+        }
+        if (!reserveOutput(_out, OUTPUT_HEADER_RESERVE)) {
+            return;
+        }
+
+        char header[OUTPUT_HEADER_RESERVE];
+        int used = snprintf(header, sizeof(header),
+                            "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nConnection: %s\r\nContent-Length: %u\r\n%s\r\n",
+                            _statusCode, statusText(_statusCode), _contentType,
+                            _keepAlive ? "keep-alive" : "close", (unsigned)_bodyLength, _extraHeaders);
+        if (used <= 0 || (size_t)used >= sizeof(header)) {
+            return;
+        }
+        _out.start = OUTPUT_HEADER_RESERVE - used;
+        _out.end = OUTPUT_HEADER_RESERVE + _bodyLength;
+        memcpy(_out.data + _out.start, header, used);
+        _ready = true;
+    }
+
+    bool detach(DetachedSocket& socket) override {
+        if (_begun) {
+            return false;
+        }
+        socket.fd = _fd;
+        _begun = true;
+        _statusCode = 200;
+        _detached = true;
+        return true;
+    }
+
+    // The response is in the output buffer; false if it couldn't be rendered
+    bool ready() const { return _ready; }
+    // False if the response asked for the connection to be closed after it
+    bool keepAlive() const { return _keepAlive; }
+    // The socket now belongs to a stream and must be released, not closed
+    bool detached() const { return _detached; }
+
+private:
+    AsyncHttpOutput& _out;
+    int _fd;
+    bool _keepAlive;
+    bool _ready = false;
+    bool _overflow = false;
+    bool _detached = false;
+    const char* _contentType = "";
+    char _extraHeaders[192] = "";
+    size_t _extraUsed = 0;
+    size_t _bodyLength = 0;
+};
+
+// --- Request parsing ---
+
+struct ParsedRequest {
+    const char* method;
+    size_t methodLength;
+    const char* path;
+    size_t pathLength;
+    const char* ifNoneMatch;
+    size_t ifNoneMatchLength;
+    size_t headerLength;   // Including the blank line
+    size_t contentLength;
+    bool hasContentLength;
+    bool keepAlive;
+};
+
+static const char* findHeaderEnd(const char* data, size_t length) {
+    for (size_t i = 0; i + 3 < length; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+            return data + i;
+        }
+    }
+    return nullptr;
+}
+
+static bool headerIs(const char* line, size_t length, const char* name) {
+    size_t nameLength = strlen(name);
+    return length > nameLength && line[nameLength] == ':' && strncasecmp(line, name, nameLength) == 0;
+}
+
+static const char* headerValue(const char* line, size_t length, size_t& valueLength, const char* name) {
+    const char* value = line + strlen(name) + 1;
+    const char* end = line + length;
+    while (value < end && *value == ' ') {
+        value++;
+    }
+    valueLength = end - value;
+    return value;
+}
+
+// Content-Length: decimal digits only, without overflow. Anything else
+// (a sign, spaces inside, a value past SIZE_MAX) is malformed.
+static bool parseContentLength(const char* value, size_t length, size_t& contentLength) {
+    while (length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t')) {
+        length--;
+    }
+    if (length == 0) {
+        return false;
+    }
+    size_t number = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (value[i] < '0' || value[i] > '9') {
+            return false;
+        }
+        size_t digit = (size_t)(value[i] - '0');
+        if (number > (SIZE_MAX - digit) / 10) {
+            return false;
+        }
+        number = number * 10 + digit;
+    }
+    contentLength = number;
+    return true;
+}
+
+// Parse the request line and the headers we care about. Returns false for
+// a malformed request.
+static bool parseRequest(const char* data, const char* headerEnd, ParsedRequest& request) {
+    memset(&request, 0, sizeof(request));
+    request.headerLength = headerEnd - data + 4;
+
+    const char* lineEnd = (const char*)memchr(data, '\r', headerEnd - data + 1);
+    const char* methodEnd = (const char*)memchr(data, ' ', lineEnd - data);
+    if (methodEnd == nullptr) {
+        return false;
+    }
+    const char* pathStart = methodEnd + 1;
+    const char* pathEnd = (const char*)memchr(pathStart, ' ', lineEnd - pathStart);
+    if (pathEnd == nullptr) {
+        return false;
+    }
+    request.method = data;
+    request.methodLength = methodEnd - data;
+    request.path = pathStart;
+    request.pathLength = pathEnd - pathStart;
+    // HTTP/1.1 defaults to keep-alive, HTTP/1.0 to close
+    request.keepAlive = (size_t)(lineEnd - pathEnd) == 9 && strncmp(pathEnd + 1, "HTTP/1.1", 8) == 0;
+
+    const char* line = lineEnd + 2;
+    while (line < headerEnd) {
+        const char* next = (const char*)memchr(line, '\r', headerEnd - line + 1);
+        size_t length = next - line;
+        size_t valueLength;
+        if (headerIs(line, length, "Content-Length")) {
+            const char* value = headerValue(line, length, valueLength, "Content-Length");
+            size_t contentLength;
+            if (!parseContentLength(value, valueLength, contentLength) ||
+                (request.hasContentLength && contentLength != request.contentLength)) {
+                return false;  // Unparseable, or two that disagree about where the body ends
+            }
+            request.contentLength = contentLength;
+            request.hasContentLength = true;
+        } else if (headerIs(line, length, "Connection")) {
+            const char* value = headerValue(line, length, valueLength, "Connection");
+            if (valueLength == 5 && strncasecmp(value, "close", 5) == 0) {
+                request.keepAlive = false;
+            } else if (valueLength == 10 && strncasecmp(value, "keep-alive", 10) == 0) {
+                request.keepAlive = true;
+            }
+        } else if (headerIs(line, length, "If-None-Match")) {
+            request.ifNoneMatch = headerValue(line, length, request.ifNoneMatchLength, "If-None-Match");
+        }
+        line = next + 2;
+    }
+    return true;
+}
+
+static HttpMethod parseMethod(const char* method, size_t length) {
+    if (length == 3 && strncmp(method, "GET", 3) == 0) return HttpMethod::GET;
+    if (length == 4 && strncmp(method, "POST", 4) == 0) return HttpMethod::POST;
+    return HttpMethod::UNKNOWN;
+}
+
+// Best effort, for a socket that isn't kept: one non-blocking send
+static void sendSimpleError(int fd, int statusCode, const char* message) {
+    AsyncHttpOutput out = {};
+    SocketResponseSink response(out, fd, false);
+    response.sendError(statusCode, message);
+    response.end();
+    if (response.ready()) {
+        send(fd, out.data + out.start, out.end - out.start, MSG_DONTWAIT);
+    }
+    releaseOutput(out);
+}
+
+// --- Server ---
+
+bool AsyncHttpServer::begin(uint16_t port) {
+    for (size_t i = 0; i < ASYNC_HTTP_MAX_CONNECTIONS; i++) {
+        connections[i].fd = -1;
+        connections[i].used = 0;
+        connections[i].out = {};
+        connections[i].closeAfterSend = false;
+        connections[i].buffer = (char*)malloc(ASYNC_HTTP_BUFFER_SIZE);
+        if (connections[i].buffer == nullptr) {
+            Serial.println("Async HTTP: failed to allocate connection buffers");
+            return false;
+        }
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenFd < 0) {
+        Serial.println("Async HTTP: socket() failed");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, ASYNC_HTTP_MAX_CONNECTIONS) != 0) {
+        Serial.printf("Async HTTP: bind/listen on port %u failed (errno %d)\n", port, errno);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    if (xTaskCreate(taskEntry, "async_http", ASYNC_HTTP_TASK_STACK, this, 1, &task) != pdPASS) {
+        Serial.println("Async HTTP: failed to start task");
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    Serial.printf("Async HTTP server listening on port %u (%d connections)\n", port, ASYNC_HTTP_MAX_CONNECTIONS);
+    return true;
+}
+
+void AsyncHttpServer::taskEntry(void* param) {
+    static_cast<AsyncHttpServer*>(param)->run();
+}
+
+void AsyncHttpServer::run() {
+    for (;;) {
+        // A connection with a response to send waits for the socket to be
+        // writable; pipelined requests behind it wait in its buffer
+        fd_set readSet;
+        fd_set writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        FD_SET(listenFd, &readSet);
+        int maxFd = listenFd;
+        for (size_t i = 0; i < ASYNC_HTTP_MAX_CONNECTIONS; i++) {
+            if (connections[i].fd >= 0) {
+                FD_SET(connections[i].fd, connections[i].out.data != nullptr ? &writeSet : &readSet);
+                if (connections[i].fd > maxFd) {
+                    maxFd = connections[i].fd;
+                }
+            }
+        }
+
+        struct timeval timeout = { SELECT_TIMEOUT_MS / 1000, (SELECT_TIMEOUT_MS % 1000) * 1000 };
+        int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout);
+        if (ready < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        if (ready > 0 && FD_ISSET(listenFd, &readSet)) {
+            acceptConnection();
+        }
+
+        unsigned long now = millis();
+        for (size_t i = 0; i < ASYNC_HTTP_MAX_CONNECTIONS; i++) {
+            Connection& conn = connections[i];
+            if (conn.fd < 0) {
+                continue;
+            }
+
+            if (conn.out.data != nullptr) {
+                if (ready > 0 && FD_ISSET(conn.fd, &writeSet)) {
+                    size_t before = conn.out.start;
+                    if (!sendPending(conn)) {
+                        closeConnection(conn);
+                        continue;
+                    }
+                    if (conn.out.start != before || conn.out.data == nullptr) {
+                        conn.lastActivity = now;
+                    }
+                    // Sent: go on with the requests that were pipelined behind it
+                    if (conn.out.data == nullptr && !processBuffer(conn)) {
+                        closeConnection(conn);
+                    }
+                } else if (now - conn.lastActivity >= ASYNC_HTTP_SEND_TIMEOUT_MS) {
+                    closeConnection(conn);  // The client stopped reading
+                }
+            } else if (ready > 0 && FD_ISSET(conn.fd, &readSet)) {
+                int received = recv(conn.fd, conn.buffer + conn.used, ASYNC_HTTP_BUFFER_SIZE - conn.used, 0);
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    continue;
+                }
+                if (received <= 0) {
+                    closeConnection(conn);
+                    continue;
+                }
+                conn.used += received;
+                conn.lastActivity = now;
+                if (!processBuffer(conn)) {
+                    closeConnection(conn);
+                }
+            } else if (now - conn.lastActivity >= ASYNC_HTTP_IDLE_TIMEOUT_MS) {
+                closeConnection(conn);
+            }
+        }
+    }
+}
+
+void AsyncHttpServer::acceptConnection() {
+    struct sockaddr_in peer;
+    socklen_t peerLength = sizeof(peer);
+    int fd = accept(listenFd, (struct sockaddr*)&peer, &peerLength);
+    if (fd < 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < ASYNC_HTTP_MAX_CONNECTIONS; i++) {
+        if (connections[i].fd < 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            connections[i].fd = fd;
+            connections[i].used = 0;
+            connections[i].lastActivity = millis();
+            connections[i].peer = peer.sin_addr.s_addr;
+            connections[i].closeAfterSend = false;
+            return;
+        }
+    }
+
+    // All connection slots busy
+    sendSimpleError(fd, 503, "Too many connections");
+    close(fd);
+}
+
+void AsyncHttpServer::closeConnection(Connection& conn) {
+    close(conn.fd);
+    conn.fd = -1;
+    conn.used = 0;
+    releaseOutput(conn.out);
+}
+
+bool AsyncHttpServer::sendPending(Connection& conn) {
+    AsyncHttpOutput& out = conn.out;
+    while (out.start < out.end) {
+        int sent = send(conn.fd, out.data + out.start, out.end - out.start, 0);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;  // The rest when select() says the socket is writable
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        out.start += sent;
+    }
+    releaseOutput(out);
+    return !conn.closeAfterSend;
+}
+
+bool AsyncHttpServer::sendError(Connection& conn, int statusCode, const char* message) {
+    SocketResponseSink response(conn.out, conn.fd, false);
+    response.sendError(statusCode, message);
+    response.end();
+    conn.closeAfterSend = true;
+    conn.used = 0;  // Nothing after a bad request is read
+    return response.ready() && sendPending(conn);
+}
+
+bool AsyncHttpServer::processBuffer(Connection& conn) {
+    // Several pipelined requests may be in the buffer. They are answered in
+    // order, so stop at one whose response is still being sent.
+    while (conn.used > 0 && conn.out.data == nullptr) {
+        const char* headerEnd = findHeaderEnd(conn.buffer, conn.used);
+        if (headerEnd == nullptr) {
+            if (conn.used == ASYNC_HTTP_BUFFER_SIZE) {
+                return sendError(conn, 413, "Request headers too large");
+            }
+            return true;  // Wait for the rest of the headers
+        }
+
+        ParsedRequest parsed;
+        if (!parseRequest(conn.buffer, headerEnd, parsed)) {
+            return sendError(conn, 400, "Malformed request");
+        }
+        // Compared without adding, which could wrap for huge lengths
+        if (parsed.contentLength > ASYNC_HTTP_BUFFER_SIZE - parsed.headerLength) {
+            return sendError(conn, 413, "Request body too large");
+        }
+        if (conn.used < parsed.headerLength + parsed.contentLength) {
+            return true;  // Wait for the rest of the body
+        }
+
+        EndpointRequest request;
+        request.method = parseMethod(parsed.method, parsed.methodLength);
+        request.content = String();
+        if (parsed.contentLength > 0) {
+            request.content.concat(conn.buffer + parsed.headerLength, parsed.contentLength);
+        }
+        request.offset = 0;
+        request.client = conn.peer;
+        if (parsed.ifNoneMatch != nullptr) {
+            request.ifNoneMatch.concat(parsed.ifNoneMatch, parsed.ifNoneMatchLength);
+        }
+        const char* queryStart = (const char*)memchr(parsed.path, '?', parsed.pathLength);
+        if (queryStart != nullptr) {
+            request.query.concat(queryStart + 1, parsed.path + parsed.pathLength - queryStart - 1);
+        }
+
+        SocketResponseSink response(conn.out, conn.fd, parsed.keepAlive);
+        bool isRoot = parsed.pathLength == 1 && parsed.path[0] == '/';
+        if (isRoot && rootHandler != nullptr && request.method == HttpMethod::GET) {
+            request.endpoint = Endpoint::UNKNOWN;
+            RouteLock lock;
+            rootHandler(request, response);
+        } else {
+            const Route* route = EndpointMapper::findRoute(request.method, parsed.path, parsed.pathLength);
+            if (route != nullptr) {
+                request.endpoint = (route->flags & ROUTE_HTTP) ? route->endpoint : Endpoint::UNKNOWN;
+                if (route->flags & ROUTE_PREFIX) {
+                    request.pathParam = EndpointMapper::pathParam(parsed.path, parsed.pathLength);
+                }
+            } else {
+                // Unknown path or wrong method: route() answers 404 or 405
+                String path;
+                path.concat(parsed.path, parsed.pathLength);
+                request.endpoint = EndpointMapper::pathToEndpoint(path, request.method);
+            }
+            EndpointMapper::route(request, response);
+        }
+        response.end();
+
+        if (response.detached()) {
+            // Anything pipelined behind a stream request is dropped
+            releaseOutput(conn.out);
+            conn.fd = -1;
+            conn.used = 0;
+            return true;
+        }
+        if (!response.ready()) {
+            return false;
+        }
+
+        size_t consumed = parsed.headerLength + parsed.contentLength;
+        memmove(conn.buffer, conn.buffer + consumed, conn.used - consumed);
+        conn.used -= consumed;
+
+        // The lock is released by now; most responses go out right here
+        conn.closeAfterSend = !response.keepAlive();
+        conn.lastActivity = millis();
+        if (!sendPending(conn)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "endpoint_mapper.h"
+#include "response_sink.h"
+
+// Event-driven HTTP/1.1 server on its own FreeRTOS task. A single select()
+// loop serves several keep-alive connections at once, each with a fixed
+// request buffer, and dispatches through the same EndpointMapper routes as
+// the WebServer. Responses are rendered into a per-connection output buffer
+// while the handler holds the RouteLock, and sent from the select() loop
+// as the non-blocking socket takes them, so a slow client only holds up its
+// own connection. Enabled with -DUSE_ASYNC_HTTP_SERVER.
+
+#ifndef ASYNC_HTTP_MAX_CONNECTIONS
+#define ASYNC_HTTP_MAX_CONNECTIONS 8
+#endif
+
+#ifndef ASYNC_HTTP_BUFFER_SIZE
+#define ASYNC_HTTP_BUFFER_SIZE 2048  // Per connection: request line, headers and body
+#endif
+
+#ifndef ASYNC_HTTP_IDLE_TIMEOUT_MS
+#define ASYNC_HTTP_IDLE_TIMEOUT_MS 10000  // Close idle keep-alive connections
+#endif
+
+#ifndef ASYNC_HTTP_MAX_RESPONSE_SIZE
+#define ASYNC_HTTP_MAX_RESPONSE_SIZE 65536  // Largest response body; larger ones are answered with 500
+#endif
+
+#ifndef ASYNC_HTTP_SEND_TIMEOUT_MS
+#define ASYNC_HTTP_SEND_TIMEOUT_MS 5000  // Close a connection whose client takes nothing for this long
+#endif
+
+#ifndef ASYNC_HTTP_TASK_STACK
+#define ASYNC_HTTP_TASK_STACK 8192  // Handlers run on this task, signing included
+#endif
+
+// A rendered response waiting to be sent: bytes [start, end) of data.
+// Allocated per response (in PSRAM when the board has it) and freed once sent.
+struct AsyncHttpOutput {
+    char* data;
+    size_t capacity;
+    size_t start;
+    size_t end;
+};
+
+class AsyncHttpServer {
+public:
+    // Handler for "/", which is not part of the route table
+    void onRoot(EndpointHandler handler) { rootHandler = handler; }
+
+    // Open the listening socket and start the server task
+    bool begin(uint16_t port = 80);
+
+private:
+    struct Connection {
+        int fd;
+        char* buffer;       // ASYNC_HTTP_BUFFER_SIZE bytes
+        size_t used;
+        unsigned long lastActivity;
+        uint32_t peer;      // IPv4 address, the rate limiting key
+        AsyncHttpOutput out;
+        bool closeAfterSend;  // Connection: close, or an error
+    };
+
+    static void taskEntry(void* param);
+    void run();
+    void acceptConnection();
+    void closeConnection(Connection& conn);
+    // Handle every complete request in the buffer, up to the first whose
+    // response can't be sent at once; false = close the connection
+    bool processBuffer(Connection& conn);
+    // Render an error response and close the connection once it's sent
+    bool sendError(Connection& conn, int statusCode, const char* message);
+    // Send as much of the pending response as the socket takes; false =
+    // close the connection (send failed, or sent and closeAfterSend)
+    bool sendPending(Connection& conn);
+
+    int listenFd = -1;
+    Connection connections[ASYNC_HTTP_MAX_CONNECTIONS];
+    EndpointHandler rootHandler = nullptr;
+    TaskHandle_t task = nullptr;
+};
@@ -10,12 +10,32 @@
 #include <ArduinoJson.h>
 #include "crypto.h"
 #include "endpoint_mapper.h"
-
-
-// Define Queue properties
-#define REQUEST_QUEUE_LENGTH 5
-#define REQUEST_QUEUE_ITEM_SIZE sizeof(char*) // Size of the pointer to the data
-#define REQUEST_QUEUE_RECEIVE_TIMEOUT_MS 10 // Timeout for waiting on the queue
+#include "response_sink.h"
+#include "job_table.h"
+#include "egwtp.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include <atomic>
+
+
+// Queues hold slot indices. Each can hold every slot, so sending to one
+// never fails once a slot has been taken.
+#define REQUEST_QUEUE_ITEM_SIZE sizeof(uint8_t)
+#define REQUEST_SLOT_COUNT (BLE_REQUEST_SLOTS + BLE_LARGE_REQUEST_SLOTS)
+static_assert(REQUEST_SLOT_COUNT < BLE_NO_SLOT, "slot indices are queued as uint8_t");
+static_assert(BLE_REASSEMBLY_ENTRIES >= BLE_LARGE_REQUEST_SLOTS, "need a reassembly entry per large slot");
+
+// Set while the controller reports the link as congested, i.e. its
+// notification buffers are full
+static std::atomic<bool> linkCongested{false};
+
+static void onGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t, esp_ble_gatts_cb_param_t* param) {
+    if (event == ESP_GATTS_CONGEST_EVT) {
+        linkCongested.store(param->congest.congested);
+    } else if (event == ESP_GATTS_DISCONNECT_EVT) {
+        linkCongested.store(false);
+    }
+}
 
 BLEHandler::BLEHandler(WebServer* server) : webServer(server) {
     pServer = nullptr;
@@ -25,12 +45,35 @@ BLEHandler::BLEHandler(WebServer* server) : webServer(server) {
     pServerCallbacks = nullptr;
     isAdvertising = false;
 
-    // Create the queue
-    _requestQueue = xQueueCreate(REQUEST_QUEUE_LENGTH, REQUEST_QUEUE_ITEM_SIZE);
-    if (_requestQueue == nullptr) {
+    // One packet buffer for all responses instead of a String per response
+    _packetBuffer = (char*)malloc(MAX_BLE_PACKET_SIZE);
+    if (_packetBuffer == nullptr) {
+        Serial.println("Error allocating BLE packet buffer!");
+    }
+
+    // Create the request slots and the queues that pass them around
+    _slots = (BleRequestSlot*)malloc(REQUEST_SLOT_COUNT * sizeof(BleRequestSlot));
+    char* slotData = (char*)malloc(BLE_REQUEST_SLOTS * (BLE_REQUEST_SIZE + 1) +
+                                   BLE_LARGE_REQUEST_SLOTS * (BLE_LARGE_REQUEST_SIZE + 1));
+    _freeSlots = xQueueCreate(BLE_REQUEST_SLOTS, REQUEST_QUEUE_ITEM_SIZE);
+    _freeLargeSlots = xQueueCreate(BLE_LARGE_REQUEST_SLOTS, REQUEST_QUEUE_ITEM_SIZE);
+    _requestQueue = xQueueCreate(REQUEST_SLOT_COUNT, REQUEST_QUEUE_ITEM_SIZE);
+    _priorityQueue = xQueueCreate(REQUEST_SLOT_COUNT, REQUEST_QUEUE_ITEM_SIZE);
+    _busy = xSemaphoreCreateMutex();
+    _reassemblyLock = xSemaphoreCreateMutex();
+    if (_slots == nullptr || slotData == nullptr || _freeSlots == nullptr || _freeLargeSlots == nullptr ||
+        _requestQueue == nullptr || _priorityQueue == nullptr || _busy == nullptr || _reassemblyLock == nullptr) {
         Serial.println("Error creating BLE request queue!");
+        free(_slots);
+        free(slotData);
+        _slots = nullptr;
         // Handle error appropriately - maybe halt or signal failure
     } else {
+        for (uint8_t index = 0; index < REQUEST_SLOT_COUNT; index++) {
+            _slots[index].data = slotData;
+            slotData += (index < BLE_REQUEST_SLOTS ? BLE_REQUEST_SIZE : BLE_LARGE_REQUEST_SIZE) + 1;
+            releaseSlot(index);
+        }
         Serial.println("BLE request queue created successfully.");
     }
 }
@@ -46,6 +89,8 @@ void BLEHandler::init() {
     esp_bluedroid_enable();
     
     BLEDevice::init("Sourceful Zippy Zap");
+    BLEDevice::setMTU(BLE_MAX_MTU);  // Clients that ask get the largest MTU both sides support
+    BLEDevice::setCustomGattsHandler(onGattsEvent);
     btStart();
     esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);  // Release classic BT memory
     
@@ -53,7 +98,7 @@ void BLEHandler::init() {
     pServer = BLEDevice::createServer();
     
     // Add server connection callbacks to detect disconnections
-    pServerCallbacks = new SrcfulBLEServerCallbacks();
+    pServerCallbacks = new SrcfulBLEServerCallbacks(this);
     pServer->setCallbacks(pServerCallbacks);
     
     // Create service with extended attribute table size for iOS
@@ -95,6 +140,14 @@ void BLEHandler::init() {
     // Start service
     pService->start();
 
+    // Serve requests as they arrive rather than from loop()
+    if (_worker == nullptr && _busy != nullptr && _slots != nullptr &&
+        xTaskCreatePinnedToCore(workerEntry, "ble_requests", BLE_TASK_STACK, this, BLE_TASK_PRIORITY, &_worker,
+                                BLE_TASK_CORE) != pdPASS) {
+        _worker = nullptr;
+        Serial.println("BLE: failed to start request task");
+    }
+
     // Improved advertising configuration for iOS compatibility
     BLEAdvertising* pAdvertising = BLEDevice::getAdvertising();
     pAdvertising->addServiceUUID(SRCFUL_SERVICE_UUID);
@@ -119,6 +172,18 @@ void BLEHandler::init() {
 }
 
 void BLEHandler::stop() {
+    // Wait for the request in progress, if any, then retire the worker.
+    // Holding both locks means it isn't deleted halfway through expiring
+    // reassemblies with _reassemblyLock taken, which would block the
+    // write and disconnect callbacks for good.
+    if (_worker != nullptr) {
+        xSemaphoreTake(_busy, portMAX_DELAY);
+        xSemaphoreTake(_reassemblyLock, portMAX_DELAY);
+        vTaskDelete(_worker);
+        _worker = nullptr;
+        xSemaphoreGive(_reassemblyLock);
+        xSemaphoreGive(_busy);
+    }
     if (pServer != nullptr) {
         pServer->getAdvertising()->stop();
         isAdvertising = false;
@@ -141,210 +206,500 @@ void BLEHandler::checkAdvertising() {
     }
 }
 
-// Optimize string literals by making them PROGMEM
-static const char RESPONSE_OK[] PROGMEM = "EGWTP/1.1 200 OK\r\n";
-static const char CONTENT_TYPE[] PROGMEM = "Content-Type: text/json\r\n";
-static const char CONTENT_LENGTH[] PROGMEM = "Content-Length: ";
-static const char LOCATION[] PROGMEM = "Location: ";
-static const char METHOD[] PROGMEM = "Method: ";
-static const char OFFSET[] PROGMEM = "Offset: ";
-
 // Error messages
-static const char ERROR_INVALID_JSON[] PROGMEM = "{\"status\":\"error\",\"message\":\"Invalid JSON\"}";
-static const char ERROR_MISSING_CREDS[] PROGMEM = "{\"status\":\"error\",\"message\":\"Missing credentials\"}";
 static const char ERROR_INVALID_REQUEST[] PROGMEM = "{\"status\":\"error\",\"message\":\"Invalid request format\"}";
-static const char ERROR_NOT_FOUND[] PROGMEM = "{\"status\":\"error\",\"message\":\"Endpoint not found\"}";
-static const char SUCCESS_WIFI_UPDATE[] PROGMEM = "{\"status\":\"success\",\"message\":\"WiFi credentials updated\"}";
-static const char SUCCESS_WIFI_RESET[] PROGMEM = "{\"status\":\"success\",\"message\":\"WiFi reset successful\"}";
-
-// Modify constructResponse to use PROGMEM strings
-String BLEHandler::constructResponse(const String& location, const String& method, 
-                                   const String& data, int offset) {
-    String header;
-    
-    // Add each part separately to avoid concatenation issues
-    header += FPSTR(RESPONSE_OK);
-    header += FPSTR(LOCATION);
-    header += location;
-    header += "\r\n";
-    
-    header += FPSTR(METHOD);
-    header += method;
-    header += "\r\n";
-    
-    header += FPSTR(CONTENT_TYPE);
-    
-    header += FPSTR(CONTENT_LENGTH);
-    header += String(data.length());
-    header += "\r\n";
-    
-    if (offset > 0) {
-        header += FPSTR(OFFSET);
-        header += String(offset);
-        header += "\r\n";
+static const char ERROR_TOO_LARGE[] PROGMEM = "{\"status\":\"error\",\"message\":\"Request too large\"}";
+static const char ERROR_BUSY[] PROGMEM = "{\"status\":\"error\",\"message\":\"Too many requests in progress\"}";
+
+bool BLEHandler::sendResponseBytes(const char* location, const char* method,
+                                   const char* data, size_t length, int offset, size_t* page) {
+    if (_packetBuffer == nullptr) {
+        return false;
     }
-    
-    header += "\r\n";
-    String response = header + data.substring(offset);
-    
-    if (response.length() > MAX_BLE_PACKET_SIZE) {
-        response = response.substring(0, MAX_BLE_PACKET_SIZE);
+    size_t packetLength = egwtpFrameResponse(_packetBuffer, MAX_BLE_PACKET_SIZE, location, method,
+                                             data, length, offset, page);
+    pResponseChar->setValue((uint8_t*)_packetBuffer, packetLength);
+    pResponseChar->notify();  // Add notification
+    return true;
+}
+
+bool BLEHandler::sendResponse(const String& location, const String& method,
+                              const String& data, int offset) {
+    return sendResponseBytes(location.c_str(), method.c_str(), data.c_str(), data.length(), offset);
+}
+
+// Wait until the controller can take another notification for the connection
+static bool waitUntilSendable(BLEServer* server, uint16_t connId) {
+    uint32_t waitedMs = 0;
+    while (linkCongested.load() || esp_ble_get_cur_sendable_packets_num(connId) == 0) {
+        if (server->getConnectedCount() == 0 || waitedMs >= BLE_STREAM_CONGESTION_TIMEOUT_MS) {
+            return false;
+        }
+        vTaskDelay(1);
+        waitedMs += portTICK_PERIOD_MS;
     }
-    
-    return response;
+    return true;
 }
 
-bool BLEHandler::sendResponse(const String& location, const String& method, 
-                            const String& data, int offset) {
-    String response = constructResponse(location, method, data, offset);
-    pResponseChar->setValue((uint8_t*)response.c_str(), response.length());
-    pResponseChar->notify();  // Add notification
+bool BLEHandler::streamResponse(const char* location, const char* method, const char* data, size_t length) {
+    if (_packetBuffer == nullptr || pServer == nullptr) {
+        return false;
+    }
+    char header[192];
+    size_t headerLength = egwtpFormatHeader(header, sizeof(header), location, method, length, 0);
+    if (headerLength == 0) {
+        return false;
+    }
+
+    uint16_t connId = pServer->getConnId();
+    uint16_t mtu = pServer->getPeerMTU(connId);
+    size_t capacity = mtu > 3 ? mtu - 3 : 20;  // ATT notification payload
+    if (capacity > MAX_BLE_PACKET_SIZE) {
+        capacity = MAX_BLE_PACKET_SIZE;
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t total = headerLength + length;
+    size_t position = 0;
+    uint16_t sequence = 0;
+    while (position < total) {
+        if (!waitUntilSendable(pServer, connId)) {
+            metricsRecordBleStream(mtu, position, (uint32_t)(esp_timer_get_time() - start), false);
+            Serial.printf("BLE stream abandoned after %u of %u bytes\n", (unsigned)position, (unsigned)total);
+            return false;
+        }
+        size_t frameLength = egwtpStreamFrame(_packetBuffer, capacity, sequence++, header, headerLength,
+                                              data, length, position);
+        pResponseChar->setValue((uint8_t*)_packetBuffer, frameLength);
+        pResponseChar->notify();
+    }
+
+    uint32_t elapsedUs = (uint32_t)(esp_timer_get_time() - start);
+    metricsRecordBleStream(mtu, total, elapsedUs, true);
+    Serial.printf("BLE stream: %u bytes in %u frames, %u us at MTU %u\n", (unsigned)total, sequence,
+                  elapsedUs, mtu);
     return true;
 }
 
-// handleRequest processes a single request string
-void BLEHandler::handleRequest(const String& request) {
-    String method, path, content;
-    int offset = 0;
-    // Reserve some space to potentially reduce reallocations during parsing
-    method.reserve(10);
-    path.reserve(64);
-    // Content reservation depends heavily on expected payload size
+// NUL-terminates a view into `buffer` by overwriting the delimiter after it
+static void terminate(char* buffer, EgwtpSpan span) {
+    if (span.data != nullptr) {
+        buffer[span.data - buffer + span.length] = '\0';
+    }
+}
 
-    if (!parseRequest(request, method, path, content, offset)) {
+// handleRequest processes the request parsed into a slot when it was queued
+void BLEHandler::handleRequest(BleRequestSlot& slot) {
+    if (slot.error == BleSlotError::TOO_LARGE) {
+        Serial.println("Request too large.");
+        sendResponseBytes("", "", ERROR_TOO_LARGE, strlen(ERROR_TOO_LARGE), 0);
+        return;
+    }
+    if (slot.error == BleSlotError::BUSY) {
+        Serial.println("No slot to reassemble the request.");
+        sendResponseBytes("", "", ERROR_BUSY, strlen(ERROR_BUSY), 0);
+        return;
+    }
+    if (slot.parse != EgwtpParseResult::OK) {
         Serial.println("Failed to parse request.");
-        // Send error response - use FPSTR to avoid String allocation for the error message itself
-        sendResponse(path, method, FPSTR(ERROR_INVALID_REQUEST), 0);
+        sendResponseBytes("", "", ERROR_INVALID_REQUEST, strlen(ERROR_INVALID_REQUEST), 0);
         return;
     }
 
-    Serial.printf("Parsed Request: Method='%s', Path='%s', Offset=%d, Content Length=%d\n",
-                  method.c_str(), path.c_str(), offset, content.length());
-    // Serial.println("Content: " + content); // Optional: Print content
+    // The slot is ours until it is handed back, so the views can be used as
+    // C strings by the response cache and the framing
+    const EgwtpRequest& request = slot.request;
+    terminate(slot.data, request.method);
+    terminate(slot.data, request.path);
+    terminate(slot.data, request.requestId);
+    terminate(slot.data, request.content);
+
+    Serial.printf("Parsed Request: Method='%s', Path='%s', Offset=%d, Content Length=%u\n",
+                  request.method.data, request.path.data, request.offset, (unsigned)request.contentLength);
 
-    handleRequestInternal(method, path, content, offset);
+    handleRequestInternal(request, slot.connId + 1u);  // 0 would bypass the rate limiter
 }
 
-void BLEHandler::handleRequestInternal(const String& method, const String& path, 
-                                     const String& content, int offset) {
+void BLEHandler::handleRequestInternal(const EgwtpRequest& parsed, uint32_t client) {
+    // Views terminated by handleRequest
+    const char* method = parsed.method.data;
+    const char* path = parsed.path.data;
+    // Without a Request-Id the body tells apart requests to the same path
+    const char* key = !parsed.requestId.empty() ? parsed.requestId.data : parsed.content.data;
+    if (parsed.offset > 0) {
+        size_t length = 0;
+        const char* body = _responseCache.find(method, path, key, millis(), length);
+        if (body != nullptr) {
+            sendResponseBytes(path, method, body, length, parsed.offset);
+            return;
+        }
+    }
+
     // Create endpoint request
     EndpointRequest request;
-    request.method = EndpointMapper::stringToMethod(method);
-    request.endpoint = EndpointMapper::pathToEndpoint(path);
-    request.content = content;
-    request.offset = offset;
+    request.method = EndpointMapper::stringToMethod(method, parsed.method.length);
+    const Route* route = EndpointMapper::findRoute(request.method, path, parsed.path.length);
+    if (route != nullptr) {
+        // HTTP-only routes (e.g. /api/stream, which needs a socket) are 404 here
+        request.endpoint = (route->flags & ROUTE_BLE) ? route->endpoint : Endpoint::UNKNOWN;
+        if ((route->flags & ROUTE_BLE) && (route->flags & ROUTE_PREFIX)) {
+            request.pathParam = EndpointMapper::pathParam(path, parsed.path.length);
+        }
+    } else {
+        // Unknown path or wrong method: route() answers 404 or 405
+        request.endpoint = EndpointMapper::pathToEndpoint(path, request.method);
+    }
+    if (parsed.content.length > 0) {
+        request.content.concat(parsed.content.data, parsed.content.length);
+    }
+    request.offset = parsed.offset;
+    request.transport = RequestTransport::BLE;
+    const char* queryStart = (const char*)memchr(path, '?', parsed.path.length);
+    if (queryStart != nullptr) {
+        request.query.concat(queryStart + 1, path + parsed.path.length - queryStart - 1);
+    }
+    request.client = client;
 
     // Route request through endpoint mapper
-    EndpointResponse response = EndpointMapper::route(request);
+    BufferResponseSink response;
+    EndpointMapper::route(request, response);
+    response.end();
+
+    // Send response using BLE protocol format. Keep bodies that need more
+    // pages, which the client will ask for with Offset; that is also the
+    // fallback when a stream is abandoned.
+    const String& body = response.body();
+    if (parsed.stream && parsed.offset == 0) {
+        if (!streamResponse(path, method, body.c_str(), body.length())) {
+            _responseCache.store(method, path, key, body.c_str(), body.length(), millis());
+        }
+        return;
+    }
+    size_t page = 0;
+    sendResponseBytes(path, method, body.c_str(), body.length(), parsed.offset, &page);
+    if ((size_t)parsed.offset + page < body.length()) {
+        _responseCache.store(method, path, key, body.c_str(), body.length(), millis());
+    }
+}
 
-    // Send response using BLE protocol format
-    sendResponse(path, method, response.data, offset);
+// Push the result of every finished job submitted over BLE, framed like the
+// response to GET /api/jobs/{id}, so clients don't have to poll
+void BLEHandler::notifyFinishedJobs() {
+    JobInfo job;
+    while (jobTakeFinished(RequestTransport::BLE, job)) {
+        EndpointRequest request;
+        request.method = HttpMethod::GET;
+        request.endpoint = Endpoint::JOBS;
+        request.offset = 0;
+        request.transport = RequestTransport::BLE;
+        request.pathParam = String(job.id);
+
+        BufferResponseSink response;
+        EndpointMapper::route(request, response);
+        response.end();
+        char location[32];
+        snprintf(location, sizeof(location), "/api/jobs/%u", (unsigned)job.id);
+        const String& body = response.body();
+        size_t page = 0;
+        sendResponseBytes(location, "GET", body.c_str(), body.length(), 0, &page);
+        if (page < body.length()) {
+            // Clients page the rest with Offset requests without a body or id
+            _responseCache.store("GET", location, "", body.c_str(), body.length(), millis());
+        }
+    }
 }
 
-bool BLEHandler::parseRequest(const String& request, String& method, String& path, 
-                            String& content, int& offset) {
-    int headerEnd = request.indexOf("\r\n\r\n");
-    if (headerEnd == -1) return false;
-    
-    String header = request.substring(0, headerEnd);
-    content = request.substring(headerEnd + 4);
-    
-    // Parse first line
-    int firstLineEnd = header.indexOf("\r\n");
-    String firstLine = header.substring(0, firstLineEnd);
-    
-    if (!firstLine.endsWith(" EGWTTP/1.1")) return false;
-    
-    int methodEnd = firstLine.indexOf(" ");
-    method = firstLine.substring(0, methodEnd);
-    
-    // Get path and trim whitespace
-    path = firstLine.substring(methodEnd + 1, firstLine.length() - 10);
-    path.trim();  // Trim as a separate operation
-    
-    // Parse headers
-    offset = 0;
-    if (header.indexOf("Offset: ") != -1) {
-        int offsetStart = header.indexOf("Offset: ") + 8;
-        int offsetEnd = header.indexOf("\r\n", offsetStart);
-        offset = header.substring(offsetStart, offsetEnd).toInt();
+bool BLEHandler::handlePendingRequest() {
+    // Cheap requests go ahead of a backlog of expensive ones
+    uint8_t index;
+    if (xQueueReceive(_priorityQueue, &index, 0) != pdPASS && xQueueReceive(_requestQueue, &index, 0) != pdPASS) {
+        return false;
     }
-    
+    BleRequestSlot& slot = _slots[index];
+    Serial.printf("Dequeued request (%u bytes)\n", (unsigned)slot.length);
+
+    // Process the request; the response has been notified when this returns
+    handleRequest(slot);
+    metricsRecordBleRequest((uint32_t)(esp_timer_get_time() - slot.receivedAt));
+
+    // Hand the slot back for the next write
+    releaseSlot(index);
     return true;
 }
 
-void BLEHandler::handlePendingRequest() {
-    if (_requestQueue == nullptr) return;
+void BLEHandler::workerEntry(void* handler) {
+    static_cast<BLEHandler*>(handler)->workerLoop();
+}
 
-    // Receive the pointer to the data
-    char* buffer = nullptr;
-    if (xQueueReceive(_requestQueue, &buffer, pdMS_TO_TICKS(REQUEST_QUEUE_RECEIVE_TIMEOUT_MS)) == pdPASS) {
-        if (buffer != nullptr) {
-            Serial.printf("Dequeued request (%d bytes)\n", strlen(buffer));
+void BLEHandler::workerLoop() {
+    for (;;) {
+        // enqueueRequest notifies once per request. Draining both queues on
+        // every wake-up means a notification is never needed twice; the
+        // timeout picks up jobs that finished in the meantime, and requests
+        // whose client stopped writing while no other writes arrive.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_JOB_POLL_MS));
+
+        xSemaphoreTake(_reassemblyLock, portMAX_DELAY);
+        expireReassemblies(millis());
+        xSemaphoreGive(_reassemblyLock);
+
+        xSemaphoreTake(_busy, portMAX_DELAY);
+        notifyFinishedJobs();
+        xSemaphoreGive(_busy);
+
+        bool handled = true;
+        while (handled) {
+            xSemaphoreTake(_busy, portMAX_DELAY);
+            handled = handlePendingRequest();
+            xSemaphoreGive(_busy);
+        }
+    }
+}
 
-            // Create a String object from the buffer
-            String receivedRequest(buffer);
+void BLEHandler::releaseSlot(uint8_t index) {
+    xQueueSend(index < BLE_REQUEST_SLOTS ? _freeSlots : _freeLargeSlots, &index, 0);
+}
 
-            // Process the request
-            handleRequest(receivedRequest);
+// Hand a filled slot to the worker; the route's cost class picks the
+// queue. Requests that didn't parse are cheap and answered with an error.
+void BLEHandler::queueRequest(uint8_t index) {
+    BleRequestSlot& slot = _slots[index];
+    CostClass cost = CostClass::CHEAP;
+    if (slot.error == BleSlotError::NONE && slot.parse == EgwtpParseResult::OK) {
+        const EgwtpRequest& request = slot.request;
+        HttpMethod method = EndpointMapper::stringToMethod(request.method.data, request.method.length);
+        cost = EndpointMapper::costClass(EndpointMapper::findRoute(method, request.path.data, request.path.length));
+    }
 
-            // Free the buffer that was allocated in enqueueRequest
-            free(buffer);
-        }
+    // The worker owns the slot until it hands the index back
+    QueueHandle_t queue = cost == CostClass::EXPENSIVE ? _requestQueue : _priorityQueue;
+    if (xQueueSend(queue, &index, 0) != pdPASS) {
+        releaseSlot(index);
+        return;
+    }
+    if (_worker != nullptr) {
+        xTaskNotifyGive(_worker);
     }
 }
 
-void BLEHandler::enqueueRequest(const String& requestStr) {
-    if (_requestQueue == nullptr) {
+void BLEHandler::enqueueRequest(uint16_t connId, const uint8_t* data, size_t length) {
+    if (_slots == nullptr) {
         Serial.println("Error: Request queue is null in enqueueRequest.");
         return;
     }
+    xSemaphoreTake(_reassemblyLock, portMAX_DELAY);
+    receiveWrite(connId, data, length);
+    xSemaphoreGive(_reassemblyLock);
+}
 
-    // Create a buffer to store the raw data
-    char* buffer = (char*)malloc(requestStr.length() + 1);
-    if (buffer == nullptr) {
-        Serial.println("Error: Failed to allocate buffer for BLE request");
+void BLEHandler::dropReassemblies(uint16_t connId) {
+    if (_slots == nullptr) {
         return;
     }
+    xSemaphoreTake(_reassemblyLock, portMAX_DELAY);
+    for (BleReassembly& pending : _reassembly) {
+        if (!pending.active || pending.connId != connId) {
+            continue;
+        }
+        if (pending.slot != BLE_NO_SLOT) {
+            metricsRecordBleReassemblyDropped();
+            Serial.printf("BLE connection %u closed during a request\n", connId);
+            releaseSlot(pending.slot);
+        }
+        pending.active = false;
+    }
+    xSemaphoreGive(_reassemblyLock);
+}
 
-    // Copy the string data to the buffer
-    strcpy(buffer, requestStr.c_str());
+void BLEHandler::receiveWrite(uint16_t connId, const uint8_t* data, size_t length) {
+    uint32_t now = millis();
+    expireReassemblies(now);
 
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    BaseType_t xResult = xQueueSendFromISR(_requestQueue, &buffer, &xHigherPriorityTaskWoken);
+    // More of a request this connection has started
+    for (BleReassembly& pending : _reassembly) {
+        if (pending.active && pending.connId == connId) {
+            appendToReassembly(pending, data, length, now);
+            return;
+        }
+    }
 
-    if (xResult != pdPASS) {
-        Serial.println("Error: Failed to enqueue BLE request (Queue full?). Request lost.");
-        free(buffer);  // Free the buffer if enqueue failed
+    if (length > BLE_REQUEST_SIZE) {
+        Serial.printf("Error: BLE request of %u bytes is too large. Request lost.\n", (unsigned)length);
+        return;
     }
-    // Note: We don't free the buffer here if enqueue succeeded because the receiving task will free it
-    
-    // Yield if necessary
-    if (xHigherPriorityTaskWoken) {
-        portYIELD_FROM_ISR();
+
+    // Take a free slot and copy the write into it
+    uint8_t index;
+    if (xQueueReceive(_freeSlots, &index, 0) != pdPASS) {
+        metricsRecordBleSlotsExhausted();
+        Serial.println("Error: No free BLE request slot (queue full?). Request lost.");
+        return;
+    }
+    BleRequestSlot& slot = _slots[index];
+    slot.receivedAt = esp_timer_get_time();
+    slot.connId = connId;
+    slot.error = BleSlotError::NONE;
+    slot.length = length;
+    memcpy(slot.data, data, length);
+    slot.data[length] = '\0';
+
+    // Parse once, here, in place
+    slot.parse = egwtpParseRequest(slot.data, length, slot.request);
+    if (slot.parse == EgwtpParseResult::INCOMPLETE) {
+        // The first write of a longer request: collect it in a large slot,
+        // or answer from this one that there's none free
+        if (startReassembly(connId, slot.receivedAt, data, length, now)) {
+            releaseSlot(index);
+        } else {
+            size_t expected = slot.request.headerLength > 0 ?
+                slot.request.headerLength + slot.request.contentLength : 0;
+            refuseReassembly(index, expected, now);
+        }
+        return;
     }
+    queueRequest(index);
 }
 
-void BLERequestCallback::onWrite(BLECharacteristic* pCharacteristic) {
+// False if there's no entry or large slot free; nothing is taken then
+bool BLEHandler::startReassembly(uint16_t connId, int64_t receivedAt, const uint8_t* data, size_t length,
+                                 uint32_t now) {
+    BleReassembly* pending = nullptr;
+    for (BleReassembly& entry : _reassembly) {
+        if (!entry.active) {
+            pending = &entry;
+            break;
+        }
+    }
+    uint8_t index;
+    if (pending == nullptr || xQueueReceive(_freeLargeSlots, &index, 0) != pdPASS) {
+        return false;
+    }
+
+    BleRequestSlot& slot = _slots[index];
+    slot.receivedAt = receivedAt;
+    slot.connId = connId;
+    slot.error = BleSlotError::NONE;
+    slot.length = 0;
+    *pending = BleReassembly{ true, connId, index, 0, 0, now };
+    appendToReassembly(*pending, data, length, now);
+    return true;
+}
+
+// Answer the first write of a request, in small slot `index`, with the busy
+// error, and drop the rest of the request as it arrives. Without the length
+// (header not complete yet), writes are dropped until the client pauses for
+// BLE_REASSEMBLY_TIMEOUT_MS.
+void BLEHandler::refuseReassembly(uint8_t index, size_t expected, uint32_t now) {
+    metricsRecordBleReassemblyDropped();
+    Serial.println("Error: No free BLE reassembly slot. Request refused.");
+    BleRequestSlot& slot = _slots[index];
+    uint16_t connId = slot.connId;  // The worker owns the slot once it's queued
+    size_t received = slot.length;
+    slot.error = BleSlotError::BUSY;
+    slot.length = 0;
+    slot.data[0] = '\0';
+    queueRequest(index);
+
+    for (BleReassembly& pending : _reassembly) {
+        if (!pending.active) {
+            size_t discard = expected == 0 ? SIZE_MAX : (expected > received ? expected - received : 0);
+            pending = BleReassembly{ discard > 0, connId, BLE_NO_SLOT, expected, discard, now };
+            return;
+        }
+    }
+}
+
+void BLEHandler::appendToReassembly(BleReassembly& pending, const uint8_t* data, size_t length, uint32_t now) {
+    pending.lastWriteMs = now;
+    if (pending.slot == BLE_NO_SLOT) {
+        // Rest of a request that was too large
+        pending.discard = length < pending.discard ? pending.discard - length : 0;
+        pending.active = pending.discard > 0;
+        return;
+    }
+
+    BleRequestSlot& slot = _slots[pending.slot];
+    if (length > BLE_LARGE_REQUEST_SIZE - slot.length) {
+        rejectReassembly(pending, slot.length + length);
+        return;
+    }
+    memcpy(slot.data + slot.length, data, length);
+    slot.length += length;
+    slot.data[slot.length] = '\0';
+    if (slot.length < pending.expected) {
+        return;  // Content still arriving; no need to parse again yet
+    }
+
+    slot.parse = egwtpParseRequest(slot.data, slot.length, slot.request);
+    if (slot.parse == EgwtpParseResult::INCOMPLETE) {
+        if (slot.request.headerLength > 0) {
+            pending.expected = slot.request.headerLength + slot.request.contentLength;
+            if (pending.expected > BLE_LARGE_REQUEST_SIZE) {
+                rejectReassembly(pending, slot.length);
+            }
+        }
+        return;
+    }
+
+    // Complete (or malformed, which gets its error response as usual)
+    pending.active = false;
+    metricsRecordBleReassembled();
+    queueRequest(pending.slot);
+}
+
+// Answer a request that outgrew its slot with an error, reusing the slot,
+// and drop the rest of it as it arrives
+void BLEHandler::rejectReassembly(BleReassembly& pending, size_t received) {
+    metricsRecordBleReassemblyDropped();
+    BleRequestSlot& slot = _slots[pending.slot];
+    slot.error = BleSlotError::TOO_LARGE;
+    slot.length = 0;
+    slot.data[0] = '\0';
+    queueRequest(pending.slot);
+
+    pending.slot = BLE_NO_SLOT;
+    pending.discard = pending.expected > received ? pending.expected - received : 0;
+    pending.active = pending.discard > 0;
+}
+
+// Give up on requests whose client stopped writing halfway. The slot is
+// queued as it is, still INCOMPLETE, so the client gets the invalid request
+// error and later writes start a new request.
+void BLEHandler::expireReassemblies(uint32_t now) {
+    for (BleReassembly& pending : _reassembly) {
+        if (!pending.active || now - pending.lastWriteMs <= BLE_REASSEMBLY_TIMEOUT_MS) {
+            continue;
+        }
+        pending.active = false;
+        if (pending.slot != BLE_NO_SLOT) {
+            metricsRecordBleReassemblyDropped();
+            Serial.printf("BLE request from connection %u timed out after %u bytes\n", pending.connId,
+                          (unsigned)_slots[pending.slot].length);
+            queueRequest(pending.slot);
+        }
+    }
+}
+
+void BLERequestCallback::onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
     // Ensure handler is valid
     if (handler == nullptr) {
          Serial.println("Error: BLEHandler is null in onWrite callback!");
          return;
      }
 
-    std::string value = pCharacteristic->getValue();
-    if (!value.empty()) {
+    // Copied straight from the characteristic's value into a request slot.
+    // The write and exec-write event parameters both start with conn_id.
+    size_t length = pCharacteristic->getLength();
+    if (length > 0) {
         // Limit logged output size if necessary
-        Serial.printf("Received BLE write request (%d bytes)\n", value.length());
-
-        // Create an Arduino String object from the received data.
-        String requestStr = String(value.c_str());
-
-        // Use the public handler method to enqueue the request
-        handler->enqueueRequest(requestStr);
+        Serial.printf("Received BLE write request (%u bytes)\n", (unsigned)length);
+        handler->enqueueRequest(param->write.conn_id, pCharacteristic->getData(), length);
+    }
+}
 
-         // IMPORTANT: 'requestStr' goes out of scope here. The handler's 
-         // enqueueRequest method handles the copy needed for the queue.
+void SrcfulBLEServerCallbacks::onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+    if (handler != nullptr) {
+        handler->dropReassemblies(param->disconnect.conn_id);
     }
 }
 
@@ -9,18 +9,121 @@
 #include <string>
 #include <ArduinoJson.h>
 #include "ble_constants.h"
+#include "ble_response_cache.h"
+#include "egwtp.h"
 #include <WebServer.h>
 
 // Include FreeRTOS queue headers
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#ifndef BLE_MAX_MTU
+#define BLE_MAX_MTU 517  // Largest ATT MTU offered to clients; notifications carry MTU - 3 bytes
+#endif
+
+#ifndef BLE_STREAM_CONGESTION_TIMEOUT_MS
+#define BLE_STREAM_CONGESTION_TIMEOUT_MS 2000  // Give up a stream if the link stays congested this long
+#endif
+
+#ifndef BLE_TASK_STACK
+#define BLE_TASK_STACK 8192  // Handlers run on this task, signing included
+#endif
+
+#ifndef BLE_TASK_PRIORITY
+#define BLE_TASK_PRIORITY 2  // Above loop(), so a request doesn't wait out a loop iteration
+#endif
+
+// The application core on dual-core chips, where the Bluetooth controller
+// and host run on core 0; single-core chips (ESP32-C3) only have core 0
+#ifndef BLE_TASK_CORE
+#if CONFIG_FREERTOS_UNICORE
+#define BLE_TASK_CORE 0
+#else
+#define BLE_TASK_CORE 1
+#endif
+#endif
+
+#ifndef BLE_REQUEST_SLOTS
+#define BLE_REQUEST_SLOTS 8  // Requests queued or being handled at once
+#endif
+
+#ifndef BLE_REQUEST_SIZE
+#define BLE_REQUEST_SIZE 512  // Largest single write: an attribute value is at most 512 bytes
+#endif
+
+// Requests split over several writes are collected in large slots, one per
+// request being received; these bound how many and how big
+#ifndef BLE_LARGE_REQUEST_SLOTS
+#define BLE_LARGE_REQUEST_SLOTS 2
+#endif
+
+#ifndef BLE_LARGE_REQUEST_SIZE
+#define BLE_LARGE_REQUEST_SIZE 4096
+#endif
+
+// Requests partway through arriving, one per connection at most. Entries
+// outnumber the large slots so a request refused for want of a slot can
+// still have the rest of its writes dropped.
+#ifndef BLE_REASSEMBLY_ENTRIES
+#ifdef CONFIG_BT_ACL_CONNECTIONS
+#define BLE_REASSEMBLY_ENTRIES CONFIG_BT_ACL_CONNECTIONS
+#else
+#define BLE_REASSEMBLY_ENTRIES 4
+#endif
+#endif
+
+#ifndef BLE_REASSEMBLY_TIMEOUT_MS
+#define BLE_REASSEMBLY_TIMEOUT_MS 3000  // A request whose next write takes longer is answered with an error
+#endif
+
+#ifndef BLE_JOB_POLL_MS
+#define BLE_JOB_POLL_MS 250  // How often the idle worker looks for finished jobs to push
+#endif
 
 class BLERequestCallback;
 class BLEResponseCallback;
 
+// A preallocated request buffer. Slots are handed from the write callback
+// to the worker and back by index, through the request and free queues.
+// The first BLE_REQUEST_SLOTS hold BLE_REQUEST_SIZE bytes, the rest
+// BLE_LARGE_REQUEST_SIZE.
+enum class BleSlotError : uint8_t {
+    NONE,
+    TOO_LARGE,  // Reassembly gave up on a request larger than a slot
+    BUSY        // No large slot was free to reassemble the request
+};
+
+struct BleRequestSlot {
+    int64_t receivedAt;  // esp_timer time of the (first) write, for the request-to-notify latency
+    uint16_t connId;
+    BleSlotError error;      // Answer with this error instead of handling the request
+    size_t length;
+    EgwtpParseResult parse;  // Parsed when queued, to pick the queue
+    EgwtpRequest request;    // Views into `data`
+    char* data;              // NUL-terminated
+};
+
+static constexpr uint8_t BLE_NO_SLOT = 0xFF;
+
+// A request arriving in several writes from one connection
+struct BleReassembly {
+    bool active;
+    uint16_t connId;
+    uint8_t slot;          // Large slot collecting it; BLE_NO_SLOT while dropping the rest of a request too large
+    size_t expected;       // Header and content bytes, once the header is in; 0 before
+    size_t discard;        // Bytes still to drop, without a slot
+    uint32_t lastWriteMs;
+};
+
+class BLEHandler;
+
 // Custom server callbacks to handle connection events
 class SrcfulBLEServerCallbacks: public BLEServerCallbacks {
 public:
+    SrcfulBLEServerCallbacks(BLEHandler* handler) : handler(handler) {}
+
     void onConnect(BLEServer* pServer) override {
         Serial.println("BLE client connected");
     }
@@ -30,6 +133,12 @@ public:
         // Restart advertising when disconnected to allow new connections
         BLEDevice::startAdvertising();
     }
+
+    // Called after the overload above, with the connection that closed
+    void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+
+private:
+    BLEHandler* handler;
 };
 
 class BLEHandler {
@@ -38,10 +147,16 @@ public:
     void init();
     void stop();
     bool sendResponse(const String& location, const String& method, const String& data, int offset = 0);
-    void handleRequest(const String& request);
+    // `page`, if given, receives the number of body bytes that fit in the packet
+    bool sendResponseBytes(const char* location, const char* method, const char* data, size_t length,
+                           int offset = 0, size_t* page = nullptr);
     void checkAdvertising();
-    void handlePendingRequest();
-    void enqueueRequest(const String& requestStr);
+    // Copies one write from connection `connId` into a free slot and queues
+    // it, or collects it until the request's Content-Length has arrived.
+    // Dropped (and counted) if every slot is taken.
+    void enqueueRequest(uint16_t connId, const uint8_t* data, size_t length);
+    // Frees any partial request from connection `connId`, which has closed
+    void dropReassemblies(uint16_t connId);
 
 private:
     WebServer* webServer;
@@ -53,21 +168,53 @@ private:
     BLEResponseCallback* pResponseCallback;
     SrcfulBLEServerCallbacks* pServerCallbacks;
     bool isAdvertising;
-    QueueHandle_t _requestQueue = nullptr;
+    BleRequestSlot* _slots = nullptr;        // Small then large slots, allocated once
+    QueueHandle_t _freeSlots = nullptr;      // Indices of unused small slots
+    QueueHandle_t _freeLargeSlots = nullptr; // Indices of unused large slots
+    // Written by the write and disconnect callbacks, which the Bluetooth
+    // host task runs, and expired by the worker too; guarded by _reassemblyLock
+    BleReassembly _reassembly[BLE_REASSEMBLY_ENTRIES] = {};
+    SemaphoreHandle_t _reassemblyLock = nullptr;
+    QueueHandle_t _requestQueue = nullptr;   // Slot indices of requests to expensive routes
+    QueueHandle_t _priorityQueue = nullptr;  // Everything else, served first
+    // Worker task that serves both queues; woken by enqueueRequest. Holds
+    // _busy while it handles a request, so stop() can't tear BLE down under it.
+    TaskHandle_t _worker = nullptr;
+    SemaphoreHandle_t _busy = nullptr;
+    char* _packetBuffer = nullptr;  // MAX_BLE_PACKET_SIZE bytes
+    // Bodies longer than one packet. Offset reads are paged from here instead
+    // of re-running the handler, whose output may differ between pages
+    // (e.g. fresh nonces from /api/crypto/sign).
+    BleResponseCache _responseCache;
     
-    String constructResponse(const String& location, const String& method, 
-                           const String& data, int offset);
-    bool parseRequest(const String& request, String& method, String& path, 
-                     String& content, int& offset);
-    void handleRequestInternal(const String& method, const String& path, 
-                             const String& content, int offset);
+    void handleRequest(BleRequestSlot& slot);
+    void handleRequestInternal(const EgwtpRequest& parsed, uint32_t client);
+    // Send the whole response as stream frames of one notification each.
+    // False if the transfer was abandoned (link congested or client gone).
+    bool streamResponse(const char* location, const char* method, const char* data, size_t length);
+    void notifyFinishedJobs();
+    static void workerEntry(void* handler);
+    void workerLoop();
+    // Handles one queued request, cheap ones first. False if both queues are empty.
+    bool handlePendingRequest();
+    void releaseSlot(uint8_t index);
+    void queueRequest(uint8_t index);
+    // The reassembly functions expect the caller to hold _reassemblyLock
+    void receiveWrite(uint16_t connId, const uint8_t* data, size_t length);
+    bool startReassembly(uint16_t connId, int64_t receivedAt, const uint8_t* data, size_t length, uint32_t now);
+    void refuseReassembly(uint8_t index, size_t expected, uint32_t now);
+    void appendToReassembly(BleReassembly& pending, const uint8_t* data, size_t length, uint32_t now);
+    void rejectReassembly(BleReassembly& pending, size_t received);
+    void expireReassemblies(uint32_t now);
 
 };
 
 class BLERequestCallback : public BLECharacteristicCallbacks {
 public:
     BLERequestCallback(BLEHandler* handler) : handler(handler) {}
-    void onWrite(BLECharacteristic* pCharacteristic);
+    // Called once per write, and once per long (prepared) write when it is
+    // executed
+    void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) override;
 private:
     BLEHandler* handler;
 };
@@ -0,0 +1,86 @@
+#include "ble_response_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool keyMatches(const char* stored, const char* method, const char* path, const char* requestId) {
+    const char* parts[] = { method, path, requestId };
+    for (const char* part : parts) {
+        if (strcmp(stored, part) != 0) {
+            return false;
+        }
+        stored += strlen(stored) + 1;
+    }
+    return true;
+}
+
+BleResponseCache::Entry* BleResponseCache::findEntry(const char* method, const char* path, const char* requestId,
+                                                     uint32_t now) {
+    for (Entry& entry : _entries) {
+        if (entry.data != nullptr && now - entry.storedAt <= BLE_RESPONSE_CACHE_TTL_MS &&
+            keyMatches(entry.data, method, path, requestId)) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+const char* BleResponseCache::find(const char* method, const char* path, const char* requestId, uint32_t now,
+                                   size_t& length) {
+    Entry* entry = findEntry(method, path, requestId, now);
+    if (entry == nullptr) {
+        _misses++;
+        return nullptr;
+    }
+    _hits++;
+    entry->lastUse = ++_uses;
+    length = entry->bodyLength;
+    return entry->data + entry->keyLength;
+}
+
+bool BleResponseCache::store(const char* method, const char* path, const char* requestId, const char* body,
+                             size_t length, uint32_t now) {
+    if (length > BLE_RESPONSE_CACHE_MAX_BODY) {
+        return false;
+    }
+
+    // Same key, else a free or expired slot, else the least recently used
+    Entry* slot = findEntry(method, path, requestId, now);
+    if (slot == nullptr) {
+        for (Entry& entry : _entries) {
+            if (entry.data == nullptr || now - entry.storedAt > BLE_RESPONSE_CACHE_TTL_MS) {
+                slot = &entry;
+                break;
+            }
+            if (slot == nullptr || entry.lastUse < slot->lastUse) {
+                slot = &entry;
+            }
+        }
+    }
+
+    size_t methodLength = strlen(method) + 1;
+    size_t pathLength = strlen(path) + 1;
+    size_t idLength = strlen(requestId) + 1;
+    size_t keyLength = methodLength + pathLength + idLength;
+    free(slot->data);
+    char* data = (char*)malloc(keyLength + length);
+    slot->data = data;
+    if (data == nullptr) {
+        return false;
+    }
+    memcpy(data, method, methodLength);
+    memcpy(data + methodLength, path, pathLength);
+    memcpy(data + methodLength + pathLength, requestId, idLength);
+    memcpy(data + keyLength, body, length);
+    slot->keyLength = keyLength;
+    slot->bodyLength = length;
+    slot->storedAt = now;
+    slot->lastUse = ++_uses;
+    return true;
+}
+
+void BleResponseCache::clear() {
+    for (Entry& entry : _entries) {
+        free(entry.data);
+        entry.data = nullptr;
+    }
+}
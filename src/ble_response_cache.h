@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recent BLE response bodies, keyed by (method, path, request id).
+// A response longer than one packet is read in pages: the client repeats
+// the request with an Offset header. Those repeats are served by slicing
+// the stored body, so every page comes from the same response and costs a
+// copy instead of another handler run. Entries expire after
+// BLE_RESPONSE_CACHE_TTL_MS, and the least recently used one makes room
+// when all are taken. Only used from the task serving BLE requests, so
+// there is no locking.
+// No Arduino dependencies, so it also builds on the host (see
+// tools/ble_paging_check.cpp).
+
+#ifndef BLE_RESPONSE_CACHE_ENTRIES
+#define BLE_RESPONSE_CACHE_ENTRIES 4
+#endif
+
+#ifndef BLE_RESPONSE_CACHE_TTL_MS
+#define BLE_RESPONSE_CACHE_TTL_MS 10000  // Time to page through one response
+#endif
+
+#ifndef BLE_RESPONSE_CACHE_MAX_BODY
+#define BLE_RESPONSE_CACHE_MAX_BODY 16384  // Larger bodies re-run the handler per page
+#endif
+
+class BleResponseCache {
+public:
+    ~BleResponseCache() { clear(); }
+
+    // Stored body for the key, or nullptr if there is none or it has
+    // expired. Valid until the next store() or clear().
+    const char* find(const char* method, const char* path, const char* requestId, uint32_t now,
+                     size_t& length);
+
+    // Keep a copy of `body`, replacing any entry with the same key. False if
+    // it is too large or the copy can't be allocated.
+    bool store(const char* method, const char* path, const char* requestId, const char* body, size_t length,
+               uint32_t now);
+
+    void clear();
+
+    uint32_t hits() const { return _hits; }
+    uint32_t misses() const { return _misses; }
+
+private:
+    struct Entry {
+        char* data = nullptr;   // "method\0path\0requestId\0" followed by the body
+        size_t keyLength = 0;
+        size_t bodyLength = 0;
+        uint32_t storedAt = 0;
+        uint32_t lastUse = 0;   // Value of _uses when last found or stored
+    };
+
+    Entry* findEntry(const char* method, const char* path, const char* requestId, uint32_t now);
+
+    Entry _entries[BLE_RESPONSE_CACHE_ENTRIES];
+    uint32_t _uses = 0;
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+};
@@ -5,9 +5,9 @@ static bool hex_string_to_bytes(const char* hex_string, uint8_t* bytes, size_t l
 static void bytes_to_hex_string(const uint8_t* bytes, size_t length, char* hex_string);
 static String base64url_encode(const uint8_t* data, size_t length);
 static int get_random(uint8_t *dest, unsigned size);
-static void calculate_sha256(const char* input, uint8_t* output);
 static const struct uECC_Curve_t* create_curve(void);
 static bool create_signature(const char* data, const char* private_key_hex, uint8_t* signature_out);
+static bool signer_sign(crypto_signer_t* signer, const char* data, size_t length, uint8_t* signature_out);
 
 String crypto_get_public_key(const char* private_key_hex) {
     const struct uECC_Curve_t* curve = create_curve();
@@ -77,6 +77,36 @@ String crypto_create_signature_hex(const char* data, const char* private_key_hex
     return String(signature_hex);
 }
 
+bool crypto_signer_begin(crypto_signer_t* signer, const char* private_key_hex) {
+    signer->ready = false;
+    mbedtls_md_init(&signer->md);
+    signer->curve = create_curve();
+    if (!signer->curve || !hex_string_to_bytes(private_key_hex, signer->private_key, 32)) {
+        return false;
+    }
+    if (mbedtls_md_setup(&signer->md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) != 0) {
+        return false;
+    }
+    signer->ready = true;
+    return true;
+}
+
+bool crypto_signer_sign_hex(crypto_signer_t* signer, const char* data, size_t length, char* signature_hex) {
+    uint8_t signature[64];
+    if (!signer_sign(signer, data, length, signature)) {
+        signature_hex[0] = '\0';
+        return false;
+    }
+    bytes_to_hex_string(signature, 64, signature_hex);
+    return true;
+}
+
+void crypto_signer_end(crypto_signer_t* signer) {
+    mbedtls_md_free(&signer->md);
+    memset(signer->private_key, 0, sizeof(signer->private_key));
+    signer->ready = false;
+}
+
 // Private helper functions
 static bool hex_string_to_bytes(const char* hex_string, uint8_t* bytes, size_t length) {
     if (strlen(hex_string) != length * 2) {
@@ -94,8 +124,10 @@ static bool hex_string_to_bytes(const char* hex_string, uint8_t* bytes, size_t l
 }
 
 static void bytes_to_hex_string(const uint8_t* bytes, size_t length, char* hex_string) {
+    static const char DIGITS[] = "0123456789abcdef";
     for (size_t i = 0; i < length; i++) {
-        sprintf(hex_string + 2*i, "%02x", bytes[i]);
+        hex_string[2*i] = DIGITS[bytes[i] >> 4];
+        hex_string[2*i + 1] = DIGITS[bytes[i] & 0x0f];
     }
     hex_string[length * 2] = '\0';
 }
@@ -123,16 +155,6 @@ static int get_random(uint8_t *dest, unsigned size) {
     return 1;
 }
 
-static void calculate_sha256(const char* input, uint8_t* output) {
-    mbedtls_md_context_t ctx;
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
-    mbedtls_md_starts(&ctx);
-    mbedtls_md_update(&ctx, (const unsigned char*)input, strlen(input));
-    mbedtls_md_finish(&ctx, output);
-    mbedtls_md_free(&ctx);
-}
-
 static const struct uECC_Curve_t* create_curve(void) {
     const struct uECC_Curve_t* curve = uECC_secp256r1();
     if (curve) {
@@ -141,23 +163,26 @@ static const struct uECC_Curve_t* create_curve(void) {
     return curve;
 }
 
-// Add the common signature creation function
-static bool create_signature(const char* data, const char* private_key_hex, uint8_t* signature_out) {
-    const struct uECC_Curve_t* curve = create_curve();
-    if (!curve) {
+// Hash and sign with an initialized signer; the hash context is restarted
+// for every message
+static bool signer_sign(crypto_signer_t* signer, const char* data, size_t length, uint8_t* signature_out) {
+    if (!signer->ready) {
         return false;
     }
-
-    uint8_t private_key[32];
     uint8_t hash[32];
-    
-    if (!hex_string_to_bytes(private_key_hex, private_key, 32)) {
+    if (mbedtls_md_starts(&signer->md) != 0 ||
+        mbedtls_md_update(&signer->md, (const unsigned char*)data, length) != 0 ||
+        mbedtls_md_finish(&signer->md, hash) != 0) {
         return false;
     }
-    
-    // Calculate hash
-    calculate_sha256(data, hash);
-    
-    // Sign the hash
-    return uECC_sign(private_key, hash, 32, signature_out, curve);
-} 
\ No newline at end of file
+    return uECC_sign(signer->private_key, hash, 32, signature_out, signer->curve);
+}
+
+// One-off signature through a temporary signer
+static bool create_signature(const char* data, const char* private_key_hex, uint8_t* signature_out) {
+    crypto_signer_t signer;
+    bool ok = crypto_signer_begin(&signer, private_key_hex) &&
+              signer_sign(&signer, data, strlen(data), signature_out);
+    crypto_signer_end(&signer);
+    return ok;
+}
@@ -28,6 +28,24 @@ String crypto_create_signature_base64url(const char* data, const char* private_k
 // Create a signature and return it as hex string
 String crypto_create_signature_hex(const char* data, const char* private_key_hex);
 
+// Signing context for many signatures with the same key. The key is decoded
+// and the curve and SHA-256 context are set up once, in crypto_signer_begin.
+typedef struct {
+    const struct uECC_Curve_t* curve;
+    mbedtls_md_context_t md;
+    uint8_t private_key[32];
+    bool ready;
+} crypto_signer_t;
+
+// Returns false (and leaves the signer unusable) if the key is malformed
+bool crypto_signer_begin(crypto_signer_t* signer, const char* private_key_hex);
+
+// Sign `length` bytes of `data`; writes 128 hex characters and a NUL
+bool crypto_signer_sign_hex(crypto_signer_t* signer, const char* data, size_t length, char* signature_hex);
+
+// Wipe the key and release the hash context
+void crypto_signer_end(crypto_signer_t* signer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,277 @@
+#include "egwtp.h"
+#include <ctype.h>
+
+// --- Request parsing ---
+
+// Consumes the "\r\n" that `p` points at
+static EgwtpParseResult lineEnd(const char*& p, const char* end) {
+    if (end - p < 2) {
+        return EgwtpParseResult::INCOMPLETE;
+    }
+    if (p[1] != '\n') {
+        return EgwtpParseResult::MALFORMED;
+    }
+    p += 2;
+    return EgwtpParseResult::OK;
+}
+
+static bool nameIs(EgwtpSpan name, const char* expected) {
+    if (name.length != strlen(expected)) {
+        return false;
+    }
+    for (size_t i = 0; i < name.length; i++) {
+        if (tolower((unsigned char)name.data[i]) != tolower((unsigned char)expected[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decimal digits only, at most `max`
+static bool parseNumber(EgwtpSpan value, uint32_t max, uint32_t& number) {
+    if (value.empty()) {
+        return false;
+    }
+    number = 0;
+    for (size_t i = 0; i < value.length; i++) {
+        char c = value.data[i];
+        if (c < '0' || c > '9' || number > (max - (uint32_t)(c - '0')) / 10) {
+            return false;
+        }
+        number = number * 10 + (uint32_t)(c - '0');
+    }
+    return true;
+}
+
+static EgwtpParseResult applyHeader(EgwtpRequest& request, EgwtpSpan name, EgwtpSpan value) {
+    uint32_t number;
+    if (nameIs(name, "Content-Length")) {
+        if (request.hasContentLength || !parseNumber(value, UINT32_MAX, number)) {
+            return EgwtpParseResult::MALFORMED;
+        }
+        request.hasContentLength = true;
+        request.contentLength = number;
+    } else if (nameIs(name, "Offset")) {
+        if (!parseNumber(value, INT32_MAX, number)) {
+            return EgwtpParseResult::MALFORMED;
+        }
+        request.offset = (int)number;
+    } else if (nameIs(name, "Request-Id")) {
+        request.requestId = value;
+    } else if (nameIs(name, "Stream")) {
+        request.stream = value.equals("1");
+    }
+    return EgwtpParseResult::OK;
+}
+
+// Advances `p` to the first of `stop` or '\r'; false if the buffer ends first
+static bool scanTo(const char*& p, const char* end, char stop) {
+    while (p < end && *p != stop && *p != '\r') {
+        p++;
+    }
+    return p < end;
+}
+
+static void skipSpaces(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+}
+
+EgwtpParseResult egwtpParseRequest(const char* data, size_t length, EgwtpRequest& request) {
+    request = EgwtpRequest();
+    const char* p = data;
+    const char* end = data + length;
+    EgwtpParseResult result;
+
+    // Request line: method, path and protocol token, separated by spaces
+    const char* method = p;
+    if (!scanTo(p, end, ' ')) {
+        return EgwtpParseResult::INCOMPLETE;
+    }
+    if (*p != ' ' || p == method) {
+        return EgwtpParseResult::MALFORMED;
+    }
+    request.method = EgwtpSpan(method, p - method);
+    skipSpaces(p, end);
+
+    const char* path = p;
+    if (!scanTo(p, end, ' ')) {
+        return EgwtpParseResult::INCOMPLETE;
+    }
+    if (*p != ' ' || p == path) {
+        return EgwtpParseResult::MALFORMED;
+    }
+    request.path = EgwtpSpan(path, p - path);
+    skipSpaces(p, end);
+
+    const char* version = p;
+    if (!scanTo(p, end, '\r')) {
+        return EgwtpParseResult::INCOMPLETE;
+    }
+    EgwtpSpan token(version, p - version);
+    if (!token.equals("EGWTTP/1.1") && !token.equals("EGWTP/1.1")) {
+        return EgwtpParseResult::MALFORMED;
+    }
+    if ((result = lineEnd(p, end)) != EgwtpParseResult::OK) {
+        return result;
+    }
+
+    // Headers, up to the blank line
+    for (;;) {
+        if (p == end) {
+            return EgwtpParseResult::INCOMPLETE;
+        }
+        if (*p == '\r') {
+            if ((result = lineEnd(p, end)) != EgwtpParseResult::OK) {
+                return result;
+            }
+            break;
+        }
+
+        const char* name = p;
+        if (!scanTo(p, end, ':')) {
+            return EgwtpParseResult::INCOMPLETE;
+        }
+        if (*p != ':' || p == name) {
+            return EgwtpParseResult::MALFORMED;
+        }
+        EgwtpSpan headerName(name, p - name);
+        p++;
+        skipSpaces(p, end);
+
+        const char* value = p;
+        if (!scanTo(p, end, '\r')) {
+            return EgwtpParseResult::INCOMPLETE;
+        }
+        const char* valueEnd = p;
+        while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+            valueEnd--;
+        }
+        if ((result = lineEnd(p, end)) != EgwtpParseResult::OK) {
+            return result;
+        }
+        if ((result = applyHeader(request, headerName, EgwtpSpan(value, valueEnd - value))) !=
+            EgwtpParseResult::OK) {
+            return result;
+        }
+    }
+
+    // Content. The header fields are complete even if it hasn't all arrived.
+    request.headerLength = p - data;
+    size_t available = end - p;
+    if (!request.hasContentLength) {
+        request.contentLength = available;
+    } else if (available < request.contentLength) {
+        return EgwtpParseResult::INCOMPLETE;
+    }
+    request.content = EgwtpSpan(p, request.contentLength);
+    return EgwtpParseResult::OK;
+}
+
+// --- Response framing ---
+
+namespace {
+
+// Appends to a fixed buffer, truncating; remembers whether anything was cut
+struct Writer {
+    char* out;
+    size_t capacity;
+    size_t used = 0;
+    bool overflow = false;
+
+    Writer(char* out, size_t capacity) : out(out), capacity(capacity) {}
+
+    void append(const char* data, size_t length) {
+        if (length > capacity - used) {
+            overflow = true;
+            length = capacity - used;
+        }
+        if (length > 0) {
+            memcpy(out + used, data, length);
+            used += length;
+        }
+    }
+
+    void append(EgwtpSpan text) { append(text.data, text.length); }
+
+    void appendNumber(uint32_t value) {
+        char digits[10];
+        size_t count = sizeof(digits);
+        do {
+            digits[--count] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        append(digits + count, sizeof(digits) - count);
+    }
+};
+
+}  // namespace
+
+size_t egwtpFormatHeader(char* out, size_t capacity, EgwtpSpan location, EgwtpSpan method, size_t length,
+                         int offset) {
+    Writer writer(out, capacity);
+    writer.append("EGWTP/1.1 200 OK\r\nLocation: ");
+    writer.append(location);
+    writer.append("\r\nMethod: ");
+    writer.append(method);
+    writer.append("\r\nContent-Type: text/json\r\nContent-Length: ");
+    writer.appendNumber((uint32_t)length);
+    writer.append("\r\n");
+    if (offset > 0) {
+        writer.append("Offset: ");
+        writer.appendNumber((uint32_t)offset);
+        writer.append("\r\n");
+    }
+    writer.append("\r\n");
+    return writer.overflow ? 0 : writer.used;
+}
+
+size_t egwtpFrameResponse(char* packet, size_t capacity, EgwtpSpan location, EgwtpSpan method,
+                          const char* data, size_t length, int offset, size_t* page) {
+    if (page != nullptr) {
+        *page = 0;
+    }
+    size_t used = egwtpFormatHeader(packet, capacity, location, method, length, offset);
+    if (used == 0) {
+        return capacity;  // Header alone overflows; send the truncated header
+    }
+
+    if (offset < 0 || (size_t)offset >= length) {
+        return used;
+    }
+    size_t bytes = length - offset;
+    if (bytes > capacity - used) {
+        bytes = capacity - used;
+    }
+    memcpy(packet + used, data + offset, bytes);
+    if (page != nullptr) {
+        *page = bytes;
+    }
+    return used + bytes;
+}
+
+size_t egwtpStreamFrame(char* frame, size_t capacity, uint16_t sequence, const char* header, size_t headerLength,
+                        const char* body, size_t bodyLength, size_t& position) {
+    size_t total = headerLength + bodyLength;
+    if (position >= total || capacity <= EGWTP_FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    frame[0] = (char)(sequence & 0xFF);
+    frame[1] = (char)(sequence >> 8);
+    for (int i = 0; i < 4; i++) {
+        frame[2 + i] = (char)((total >> (8 * i)) & 0xFF);
+    }
+
+    size_t used = EGWTP_FRAME_HEADER_SIZE;
+    while (used < capacity && position < total) {
+        // Copy from whichever part `position` is in
+        const char* source = position < headerLength ? header + position : body + (position - headerLength);
+        size_t available = position < headerLength ? headerLength - position : total - position;
+        size_t bytes = capacity - used < available ? capacity - used : available;
+        memcpy(frame + used, source, bytes);
+        used += bytes;
+        position += bytes;
+    }
+    return used;
+}
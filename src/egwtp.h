@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Parsing and framing of EGWTP, the HTTP-like protocol on the BLE request
+// and response characteristics. A request is
+//
+//   METHOD /path EGWTTP/1.1\r\n
+//   Header: value\r\n
+//   ...\r\n
+//   \r\n
+//   content
+//
+// ("EGWTP/1.1", as in responses, is accepted too). A response packet is a
+// header block followed by one page of the body; clients read the rest by
+// repeating the request with an Offset header. Clients that send
+// "Stream: 1" get the whole response instead, as a run of numbered frames,
+// one per notification.
+// Nothing here allocates, and there are no Arduino dependencies, so it also
+// builds on the host (see tools/ble_paging_check.cpp, tools/egwtp_fuzz.cpp
+// and tools/egwtp_bench.cpp).
+
+// Each stream frame starts with the sequence number (uint16) and the total
+// length of the streamed message (uint32), little-endian
+#define EGWTP_FRAME_HEADER_SIZE 6
+
+// A run of bytes in someone else's buffer, not NUL-terminated
+struct EgwtpSpan {
+    const char* data = nullptr;
+    size_t length = 0;
+
+    EgwtpSpan() = default;
+    EgwtpSpan(const char* data, size_t length) : data(data), length(length) {}
+    EgwtpSpan(const char* text) : data(text), length(strlen(text)) {}
+
+    bool empty() const { return length == 0; }
+    bool equals(const char* text) const { return strlen(text) == length && memcmp(data, text, length) == 0; }
+};
+
+enum class EgwtpParseResult : uint8_t {
+    OK,
+    INCOMPLETE,  // No blank line yet, or fewer content bytes than Content-Length
+    MALFORMED
+};
+
+// A parsed request. Spans point into the parsed buffer; absent headers
+// leave theirs empty (data == nullptr).
+struct EgwtpRequest {
+    EgwtpSpan method;
+    EgwtpSpan path;       // Query string included
+    EgwtpSpan requestId;  // Request-Id, trailing spaces trimmed
+    EgwtpSpan content;
+    size_t headerLength = 0;     // Request line and headers, blank line included
+    bool hasContentLength = false;
+    size_t contentLength = 0;    // Content-Length if given, else whatever follows the headers
+    int offset = 0;              // Offset
+    bool stream = false;         // "Stream: 1"
+};
+
+// Parses a request in a single pass over `data`. Header names are case
+// insensitive and unknown headers are skipped. With a Content-Length the
+// content is exactly that many bytes (anything after it is ignored) and
+// the result is INCOMPLETE until they have all arrived (headerLength and
+// contentLength are already set then); without one the content is the
+// rest of the buffer.
+EgwtpParseResult egwtpParseRequest(const char* data, size_t length, EgwtpRequest& request);
+
+// Writes the header block, blank line included, for a response of `length`
+// body bytes. Returns its length, or 0 if it doesn't fit in `capacity`.
+size_t egwtpFormatHeader(char* out, size_t capacity, EgwtpSpan location, EgwtpSpan method, size_t length,
+                         int offset);
+
+// Writes the header and the page of `data` starting at `offset` into
+// `packet`, truncated to `capacity` bytes. Returns the packet length.
+// `page`, if given, receives the number of body bytes in the packet.
+size_t egwtpFrameResponse(char* packet, size_t capacity, EgwtpSpan location, EgwtpSpan method,
+                          const char* data, size_t length, int offset, size_t* page = nullptr);
+
+// Writes the stream frame carrying the message bytes from `position` on
+// and advances `position`. The message is `header` followed by `body`.
+// Returns the frame length, at most `capacity`; 0 once the message is done.
+size_t egwtpStreamFrame(char* frame, size_t capacity, uint16_t sequence, const char* header, size_t headerLength,
+                        const char* body, size_t bodyLength, size_t& position);
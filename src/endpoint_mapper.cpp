@@ -1,44 +1,146 @@
 #include "endpoint_mapper.h"
 #include "endpoint_types.h"
 #include "ble_handler.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "esp_timer.h"
+#include "metrics.h"
+#include "request_arena.h"
+#include "rate_limit.h"
+#include "route_hash.h"
 
-// Define path constants
-const char* EndpointMapper::WIFI_CONFIG_PATH = "/api/wifi";
-const char* EndpointMapper::SYSTEM_INFO_PATH = "/api/system/info";
-const char* EndpointMapper::WIFI_RESET_PATH = "/api/wifi/reset";
-const char* EndpointMapper::CRYPTO_INFO_PATH = "/api/crypto";
-const char* EndpointMapper::NAME_INFO_PATH = "/api/name";
-const char* EndpointMapper::WIFI_STATUS_PATH = "/api/wifi";
-const char* EndpointMapper::WIFI_SCAN_PATH = "/api/wifi/scan";
-const char* EndpointMapper::BLE_STOP_PATH = "/api/ble/stop";
-const char* EndpointMapper::CRYPTO_SIGN_PATH = "/api/crypto/sign";
-
-Endpoint EndpointMapper::pathToEndpoint(const String& path) {
-    if (path == WIFI_CONFIG_PATH) return Endpoint::WIFI_CONFIG;
-    if (path == SYSTEM_INFO_PATH) return Endpoint::SYSTEM_INFO;
-    if (path == WIFI_RESET_PATH) return Endpoint::WIFI_RESET;
-    if (path == CRYPTO_INFO_PATH) return Endpoint::CRYPTO_INFO;
-    if (path == NAME_INFO_PATH) return Endpoint::NAME_INFO;
-    if (path == WIFI_STATUS_PATH) return Endpoint::WIFI_STATUS;
-    if (path == WIFI_SCAN_PATH) return Endpoint::WIFI_SCAN;
-    if (path == BLE_STOP_PATH) return Endpoint::BLE_STOP;
-    if (path == CRYPTO_SIGN_PATH) return Endpoint::CRYPTO_SIGN;
-    return Endpoint::UNKNOWN;
+// The route table. Add new endpoints here; HTTP registration, BLE routing
+// and the path lookup hash are all generated from it.
+static constexpr Route ROUTES[] = {
+    { "/api/wifi",        HttpMethod::POST, Endpoint::WIFI_CONFIG, handleWiFiConfig, ROUTE_ALL | ROUTE_EXPENSIVE },
+    { "/api/wifi",        HttpMethod::GET,  Endpoint::WIFI_STATUS, handleWiFiStatus, ROUTE_ALL },
+    { "/api/system/info", HttpMethod::GET,  Endpoint::SYSTEM_INFO, handleSystemInfo, ROUTE_ALL },
+    { "/api/wifi/reset",  HttpMethod::POST, Endpoint::WIFI_RESET,  handleWiFiReset,  ROUTE_ALL | ROUTE_EXPENSIVE },
+    { "/api/crypto",      HttpMethod::GET,  Endpoint::CRYPTO_INFO, handleCryptoInfo, ROUTE_ALL },
+    { "/api/name",        HttpMethod::GET,  Endpoint::NAME_INFO,   handleNameInfo,   ROUTE_ALL },
+    { "/api/wifi/scan",   HttpMethod::GET,  Endpoint::WIFI_SCAN,   handleWiFiScan,   ROUTE_ALL | ROUTE_EXPENSIVE },
+    { "/api/ble/stop",    HttpMethod::POST, Endpoint::BLE_STOP,    handleBleStop,    ROUTE_ALL },
+    { "/api/crypto/sign", HttpMethod::POST, Endpoint::CRYPTO_SIGN, handleCryptoSign, ROUTE_ALL | ROUTE_EXPENSIVE },
+    { "/api/metrics",     HttpMethod::GET,  Endpoint::METRICS,     handleMetrics,    ROUTE_ALL },
+    { "/api/stream",      HttpMethod::GET,  Endpoint::STREAM,      handleStream,     ROUTE_HTTP },
+    { "/api/readings",    HttpMethod::GET,  Endpoint::READINGS,    handleReadings,   ROUTE_ALL | ROUTE_EXPENSIVE },
+    { "/api/jobs/",       HttpMethod::GET,  Endpoint::JOBS,        handleJobs,       ROUTE_ALL | ROUTE_PREFIX },
+};
+static constexpr size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+static_assert(ROUTE_COUNT < 255, "Route indexes are stored in uint8_t");
+
+// --- Compile-time perfect hash over (method, path), see route_hash.h ---
+
+static constexpr size_t ROUTE_HASH_BUCKETS = hashBucketCount(ROUTE_COUNT);
+static constexpr size_t ROUTE_HASH_SIZE = hashTableSize(ROUTE_COUNT);
+static constexpr RouteHashTable<ROUTE_HASH_BUCKETS, ROUTE_HASH_SIZE> ROUTE_HASH =
+    buildRouteHashTable<ROUTE_HASH_BUCKETS, ROUTE_HASH_SIZE>(ROUTES);
+static_assert(ROUTE_HASH.ok, "No collision-free hash for the route table");
+
+// --- (endpoint, method) -> route, used by route() ---
+
+static constexpr size_t ENDPOINT_COUNT = (size_t)Endpoint::UNKNOWN;
+static constexpr size_t METHOD_COUNT = (size_t)HttpMethod::UNKNOWN;
+
+struct EndpointIndex {
+    uint8_t routes[ENDPOINT_COUNT][METHOD_COUNT];  // Route index + 1, 0 = none
+};
+
+static constexpr EndpointIndex buildEndpointIndex() {
+    EndpointIndex index = {};
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        index.routes[(size_t)ROUTES[i].endpoint][(size_t)ROUTES[i].method] = (uint8_t)(i + 1);
+    }
+    return index;
+}
+
+static constexpr EndpointIndex ENDPOINT_INDEX = buildEndpointIndex();
+
+const Route* EndpointMapper::routes() {
+    return ROUTES;
+}
+
+size_t EndpointMapper::routeCount() {
+    return ROUTE_COUNT;
+}
+
+// Paths below a ROUTE_PREFIX route, e.g. /api/jobs/7. Only reached when the
+// exact lookup misses, and there are few prefix routes, so a scan is fine.
+static const Route* findPrefixRoute(HttpMethod method, const char* path, size_t length) {
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        const Route& route = ROUTES[i];
+        if (!(route.flags & ROUTE_PREFIX) || route.method != method) {
+            continue;
+        }
+        size_t prefixLength = constLength(route.path);
+        if (length > prefixLength && strncmp(route.path, path, prefixLength) == 0) {
+            return &route;
+        }
+    }
+    return nullptr;
+}
+
+const Route* EndpointMapper::findRoute(HttpMethod method, const char* path, size_t length) {
+    if (method == HttpMethod::UNKNOWN || path == nullptr) {
+        return nullptr;
+    }
+
+    // Ignore any query string
+    const char* query = (const char*)memchr(path, '?', length);
+    if (query != nullptr) {
+        length = query - path;
+    }
+
+    const Route* route = routeHashFind(ROUTE_HASH, ROUTES, (uint32_t)method, path, length);
+    return route != nullptr ? route : findPrefixRoute(method, path, length);
+}
+
+const Route* EndpointMapper::findRoute(HttpMethod method, const String& path) {
+    return findRoute(method, path.c_str(), path.length());
+}
+
+String EndpointMapper::pathParam(const char* path, size_t length) {
+    const char* query = (const char*)memchr(path, '?', length);
+    if (query != nullptr) {
+        length = query - path;
+    }
+    String param;
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        const Route& route = ROUTES[i];
+        size_t prefixLength = constLength(route.path);
+        if ((route.flags & ROUTE_PREFIX) && length > prefixLength && strncmp(route.path, path, prefixLength) == 0) {
+            param.concat(path + prefixLength, length - prefixLength);
+            break;
+        }
+    }
+    return param;
+}
+
+String EndpointMapper::pathParam(const String& path) {
+    return pathParam(path.c_str(), path.length());
+}
+
+Endpoint EndpointMapper::pathToEndpoint(const String& path, HttpMethod method) {
+    const Route* route = findRoute(method, path);
+    if (route == nullptr) {
+        // Known path with another method still maps to its endpoint so that
+        // route() can answer 405 instead of 404
+        route = findRoute(method == HttpMethod::GET ? HttpMethod::POST : HttpMethod::GET, path);
+    }
+    return route != nullptr ? route->endpoint : Endpoint::UNKNOWN;
 }
 
 String EndpointMapper::endpointToPath(Endpoint endpoint) {
-    switch (endpoint) {
-        case Endpoint::WIFI_CONFIG: return WIFI_CONFIG_PATH;
-        case Endpoint::SYSTEM_INFO: return SYSTEM_INFO_PATH;
-        case Endpoint::WIFI_RESET: return WIFI_RESET_PATH;
-        case Endpoint::CRYPTO_INFO: return CRYPTO_INFO_PATH;
-        case Endpoint::NAME_INFO: return NAME_INFO_PATH;
-        case Endpoint::WIFI_STATUS: return WIFI_STATUS_PATH;
-        case Endpoint::WIFI_SCAN: return WIFI_SCAN_PATH;
-        case Endpoint::BLE_STOP: return BLE_STOP_PATH;
-        case Endpoint::CRYPTO_SIGN: return CRYPTO_SIGN_PATH;
-        default: return "";
+    if (endpoint == Endpoint::UNKNOWN) {
+        return "";
+    }
+    for (size_t method = 0; method < METHOD_COUNT; method++) {
+        uint8_t index = ENDPOINT_INDEX.routes[(size_t)endpoint][method];
+        if (index != 0) {
+            return ROUTES[index - 1].path;
+        }
     }
+    return "";
 }
 
 HttpMethod EndpointMapper::stringToMethod(const String& method) {
@@ -47,6 +149,12 @@ HttpMethod EndpointMapper::stringToMethod(const String& method) {
     return HttpMethod::UNKNOWN;
 }
 
+HttpMethod EndpointMapper::stringToMethod(const char* method, size_t length) {
+    if (length == 3 && strncmp(method, "GET", 3) == 0) return HttpMethod::GET;
+    if (length == 4 && strncmp(method, "POST", 4) == 0) return HttpMethod::POST;
+    return HttpMethod::UNKNOWN;
+}
+
 String EndpointMapper::methodToString(HttpMethod method) {
     switch (method) {
         case HttpMethod::GET: return "GET";
@@ -55,99 +163,85 @@ String EndpointMapper::methodToString(HttpMethod method) {
     }
 }
 
-EndpointResponse EndpointMapper::route(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.statusCode = 404;
-    response.contentType = "application/json";
-    response.data = "{\"status\":\"error\",\"message\":\"Endpoint not found\"}";
-
-    // Route based on endpoint and method
-    switch (request.endpoint) {
-        case Endpoint::WIFI_CONFIG:
-            if (request.method == HttpMethod::POST) {
-                return handleWiFiConfig(request);
-            } else if (request.method == HttpMethod::GET) {
-                return handleWiFiStatus(request);
-            }
-            break;
-            
-        case Endpoint::SYSTEM_INFO:
-            if (request.method == HttpMethod::GET) {
-                return handleSystemInfo(request);
-            }
-            break;
-            
-        case Endpoint::WIFI_RESET:
-            if (request.method == HttpMethod::POST) {
-                return handleWiFiReset(request);
-            }
-            break;
-            
-        case Endpoint::CRYPTO_INFO:
-            if (request.method == HttpMethod::GET) {
-                return handleCryptoInfo(request);
-            }
-            break;
-            
-        case Endpoint::NAME_INFO:
-            if (request.method == HttpMethod::GET) {
-                return handleNameInfo(request);
-            }
-            break;
-            
-        case Endpoint::WIFI_STATUS:
-            if (request.method == HttpMethod::GET) {
-                return handleWiFiStatus(request);
-            }
-            break;
-            
-        case Endpoint::WIFI_SCAN:
-            if (request.method == HttpMethod::GET) {
-                return handleWiFiScan(request);
-            }
-            break;
-            
-        case Endpoint::BLE_STOP:
-            if (request.method == HttpMethod::POST) {
-                #if defined(USE_BLE_SETUP)
-                    extern unsigned long bleShutdownTime;
-                    // Schedule BLE shutdown in 10 seconds
-                    bleShutdownTime = millis() + 10000;
-                    response.statusCode = 200;
-                    response.data = "{\"status\":\"success\",\"message\":\"BLE shutdown scheduled\"}";
-                    return response;
-                #else
-                    response.statusCode = 400;
-                    response.data = "{\"status\":\"error\",\"message\":\"BLE not enabled\"}";
-                    return response;
-                #endif
-            }
-            break;
-            
-        case Endpoint::CRYPTO_SIGN:
-            if (request.method == HttpMethod::POST) {
-                return handleCryptoSign(request);
-            }
-            break;
-            
-        default:
-            break;
+CostClass EndpointMapper::costClass(const Route* route) {
+    return route != nullptr && (route->flags & ROUTE_EXPENSIVE) ? CostClass::EXPENSIVE : CostClass::CHEAP;
+}
+
+CostClass EndpointMapper::costClass(Endpoint endpoint, HttpMethod method) {
+    if (endpoint == Endpoint::UNKNOWN || method == HttpMethod::UNKNOWN) {
+        return CostClass::CHEAP;
+    }
+    uint8_t index = ENDPOINT_INDEX.routes[(size_t)endpoint][(size_t)method];
+    return index != 0 ? costClass(&ROUTES[index - 1]) : CostClass::CHEAP;
+}
+
+static SemaphoreHandle_t routeMutex() {
+    // Function-local static, so creation is thread-safe
+    static SemaphoreHandle_t mutex = xSemaphoreCreateRecursiveMutex();
+    return mutex;
+}
+
+RouteLock::RouteLock() {
+    xSemaphoreTakeRecursive(routeMutex(), portMAX_DELAY);
+}
+
+RouteLock::~RouteLock() {
+    xSemaphoreGiveRecursive(routeMutex());
+}
+
+static void dispatch(const EndpointRequest& request, ResponseSink& response) {
+    if (request.endpoint == Endpoint::UNKNOWN) {
+        response.sendError(404, "Endpoint not found");
+        return;
+    }
+
+    if (request.method != HttpMethod::UNKNOWN) {
+        uint8_t index = ENDPOINT_INDEX.routes[(size_t)request.endpoint][(size_t)request.method];
+        if (index != 0) {
+            ROUTES[index - 1].handler(request, response);
+            return;
+        }
     }
 
-    response.statusCode = 405;
-    response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-    return response;
+    response.sendError(405, "Method not allowed");
+}
+
+// 429 in the usual error shape; retryAfter is repeated in the body for BLE
+// clients, which don't get headers
+static void sendRateLimited(ResponseSink& response, uint32_t retryAfter) {
+    char header[12];
+    snprintf(header, sizeof(header), "%u", (unsigned)retryAfter);
+    response.addHeader("Retry-After", header);
+    response.begin(429, "application/json");
+    response.write("{\"status\":\"error\",\"message\":\"Too many requests\",\"retryAfter\":");
+    response.write(header);
+    response.write("}");
+}
+
+void EndpointMapper::route(const EndpointRequest& request, ResponseSink& response) {
+    uint32_t retryAfter = rateLimitAdmit(request.transport, request.client,
+                                         costClass(request.endpoint, request.method));
+    if (retryAfter != 0) {
+        int64_t start = esp_timer_get_time();
+        sendRateLimited(response, retryAfter);
+        metricsRecordRequest(request.endpoint, request.transport, response.statusCode(),
+                             (uint32_t)(esp_timer_get_time() - start), 0);
+        return;
+    }
+
+    RouteLock lock;
+    int64_t start = esp_timer_get_time();
+    dispatch(request, response);
+    metricsRecordRequest(request.endpoint, request.transport, response.statusCode(),
+                         (uint32_t)(esp_timer_get_time() - start), requestArena.peak());
+    requestArena.reset();
 }
 
 void EndpointMapper::printPaths() {
     Serial.println("Registered paths:");
-    Serial.println(WIFI_CONFIG_PATH);
-    Serial.println(SYSTEM_INFO_PATH);
-    Serial.println(WIFI_RESET_PATH);
-    Serial.println(CRYPTO_INFO_PATH);
-    Serial.println(NAME_INFO_PATH);
-    Serial.println(WIFI_STATUS_PATH);
-    Serial.println(WIFI_SCAN_PATH);
-    Serial.println(BLE_STOP_PATH);
-    Serial.println(CRYPTO_SIGN_PATH);
-} 
\ No newline at end of file
+    for (size_t i = 0; i < ROUTE_COUNT; i++) {
+        Serial.print(methodToString(ROUTES[i].method));
+        Serial.print(" ");
+        Serial.println(ROUTES[i].path);
+    }
+}
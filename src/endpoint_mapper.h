@@ -4,24 +4,58 @@
 #include "endpoint_types.h"
 #include "endpoints.h"
 
+typedef void (*EndpointHandler)(const EndpointRequest& request, ResponseSink& response);
+
+// One entry of the route table. The table in endpoint_mapper.cpp is the only
+// place routes are defined; HTTP registration and BLE routing are derived from it.
+struct Route {
+    const char* path;
+    HttpMethod method;
+    Endpoint endpoint;
+    EndpointHandler handler;
+    uint8_t flags;   // RouteFlags
+};
+
+// Serializes handler execution between transports running on different
+// tasks (the async HTTP server task and the loop task serving BLE).
+// Recursive, so nested use is harmless.
+class RouteLock {
+public:
+    RouteLock();
+    ~RouteLock();
+};
+
 class EndpointMapper {
 public:
-    // Define path constants
-    static const char* WIFI_CONFIG_PATH;
-    static const char* SYSTEM_INFO_PATH;
-    static const char* WIFI_RESET_PATH;
-    static const char* CRYPTO_INFO_PATH;
-    static const char* NAME_INFO_PATH;
-    static const char* WIFI_STATUS_PATH;
-    static const char* WIFI_SCAN_PATH;
-    static const char* BLE_STOP_PATH;
-    static const char* CRYPTO_SIGN_PATH;
+    // Route table access
+    static const Route* routes();
+    static size_t routeCount();
+
+    // O(1) lookup of (method, path) through the compile-time perfect hash.
+    // A query string ("?...") in the path is ignored. Paths below a
+    // ROUTE_PREFIX route match it. Returns nullptr if unknown.
+    static const Route* findRoute(HttpMethod method, const char* path, size_t length);
+    static const Route* findRoute(HttpMethod method, const String& path);
+
+    // The part of `path` below the ROUTE_PREFIX route it falls under, without
+    // the query string; empty for other paths
+    static String pathParam(const char* path, size_t length);
+    static String pathParam(const String& path);
 
     // Mapping functions
-    static Endpoint pathToEndpoint(const String& path);
+    static Endpoint pathToEndpoint(const String& path, HttpMethod method);
     static String endpointToPath(Endpoint endpoint);
     static HttpMethod stringToMethod(const String& method);
+    static HttpMethod stringToMethod(const char* method, size_t length);
     static String methodToString(HttpMethod method);
-    static EndpointResponse route(const EndpointRequest& request);
+    // Rate limiting class of a route; unknown routes are cheap
+    static CostClass costClass(const Route* route);
+    static CostClass costClass(Endpoint endpoint, HttpMethod method);
+
+    // Dispatch to the handler, which writes into the sink. The transport calls
+    // response.end() afterwards. Requests over their client's rate limit get
+    // 429 without waiting for the lock; others hold a RouteLock while the
+    // handler runs, and the request arena is rewound once it returns.
+    static void route(const EndpointRequest& request, ResponseSink& response);
     static void printPaths();
-}; 
\ No newline at end of file
+};
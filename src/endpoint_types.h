@@ -20,5 +20,32 @@ enum class Endpoint {
     WIFI_SCAN,
     BLE_STOP,
     CRYPTO_SIGN,
+    METRICS,
+    STREAM,
+    READINGS,
+    JOBS,
     UNKNOWN
-}; 
\ No newline at end of file
+};
+
+// Transports a route is exposed on
+enum RouteFlags : uint8_t {
+    ROUTE_HTTP = 1 << 0,
+    ROUTE_BLE = 1 << 1,
+    ROUTE_ALL = ROUTE_HTTP | ROUTE_BLE,
+    ROUTE_PREFIX = 1 << 2,  // Path ends in '/' and also matches anything below it
+    ROUTE_EXPENSIVE = 1 << 3  // Rate limited as CostClass::EXPENSIVE (ECC math, radio, big bodies)
+};
+
+// Rate limiting class of a route; each client has a token bucket per class
+enum class CostClass : uint8_t {
+    CHEAP,
+    EXPENSIVE,
+    COUNT
+};
+
+// Transport a request arrived on
+enum class RequestTransport : uint8_t {
+    HTTP,
+    BLE,
+    COUNT
+};
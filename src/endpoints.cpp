@@ -1,116 +1,203 @@
 #include <Arduino.h>
 #include "endpoint_types.h"
 #include "endpoints.h"
+#include "json_writer.h"
 #include <WiFi.h>
 #include <esp_system.h>
 #include "crypto.h"
 #include "graphql.h"
-#include "html.h"
+#include "web_assets.h"
+#include "name_cache.h"
+#include "wifi_manager.h"
+#include "wifi_scan.h"
+#include "time_sync.h"
+#include "response_cache.h"
+#include "metrics.h"
+#include "event_stream.h"
+#include "reading_history.h"
+#include "request_arena.h"
+#include "job_table.h"
 
 // External function declarations
 extern bool connectToWiFi(const String& ssid, const String& password, bool updateGlobals = true);
 
-EndpointResponse handleWiFiConfig(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+// Answer 202 Accepted for a submitted job, pointing at its status resource
+static void sendJobAccepted(ResponseSink& response, uint32_t id, const char* message) {
+    char location[24];
+    snprintf(location, sizeof(location), "/api/jobs/%u", (unsigned)id);
+    response.addHeader("Location", location);
+    response.begin(202, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    json.member("status", "accepted");
+    json.member("message", message);
+    json.member("job", id);
+    json.member("location", location);
+    json.endObject();
+}
+
+// Job input: the SSID and password, each NUL-terminated
+static void wifiConnectJob(const void* input, size_t length, JobResult& result) {
+    const char* ssid = (const char*)input;
+    const char* password = ssid + strlen(ssid) + 1;
+    if (connectToWiFi(ssid, password)) {
+        result.status = 200;
+        strlcpy(result.message, "WiFi credentials updated and connected", sizeof(result.message));
+    } else {
+        result.status = 500;
+        strlcpy(result.message, "Failed to connect with provided credentials", sizeof(result.message));
+    }
+}
+
+void handleWiFiConfig(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::POST) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
     if (request.content.length() > 0) {
-        StaticJsonDocument<128> doc;
+        ArenaJsonDocument doc(arenaJsonCapacity(request.content.length()));
         DeserializationError error = deserializeJson(doc, request.content);
         
         Serial.println("Received WiFi config request:");
         Serial.println(request.content);
         
+        if (error == DeserializationError::NoMemory) {
+            response.sendError(413, "Request too large");
+            return;
+        }
         if (error) {
             Serial.println("JSON parsing failed");
-            response.statusCode = 400;
-            response.data = "{\"status\":\"error\",\"message\":\"Invalid JSON\"}";
-            return response;
+            response.sendError(400, "Invalid JSON");
+            return;
         }
         
         if (!doc.containsKey("ssid") || !doc.containsKey("psk")) {
             Serial.println("Missing ssid or psk in request");
-            response.statusCode = 400;
-            response.data = "{\"status\":\"error\",\"message\":\"Missing credentials\"}";
-            return response;
+            response.sendError(400, "Missing credentials");
+            return;
         }
         
-        String ssid = doc["ssid"].as<const char*>();
-        String password = doc["psk"].as<const char*>();
+        const char* ssid = doc["ssid"] | "";
+        const char* password = doc["psk"] | "";
+        size_t ssidLength = strlen(ssid);
+        size_t passwordLength = strlen(password);
+        if (ssidLength == 0 || ssidLength > 32 || passwordLength > 64) {
+            response.sendError(400, "Invalid credentials");
+            return;
+        }
         
         Serial.print("Setting WiFi SSID: ");
         Serial.println(ssid);
-        Serial.println("Setting WiFi password (length): " + String(password.length()));
+        Serial.println("Setting WiFi password (length): " + String(passwordLength));
         
-        // Try to connect with new credentials
-        Serial.println("Attempting to connect to WiFi...");
-        if (connectToWiFi(ssid, password)) {
-            response.statusCode = 200;
-            response.data = "{\"status\":\"success\",\"message\":\"WiFi credentials updated and connected\"}";
-        } else {
-            response.statusCode = 500;
-            response.data = "{\"status\":\"error\",\"message\":\"Failed to connect with provided credentials\"}";
+        // Connecting takes up to WIFI_CONNECT_TIMEOUT_MS; run it as a job and
+        // let the client poll (or, over BLE, get notified)
+        char input[32 + 1 + 64 + 1];
+        memcpy(input, ssid, ssidLength + 1);
+        memcpy(input + ssidLength + 1, password, passwordLength + 1);
+        uint32_t id = jobSubmit("wifi_connect", wifiConnectJob, input, ssidLength + passwordLength + 2,
+                                request.transport);
+        if (id == 0) {
+            response.addHeader("Retry-After", "5");
+            response.sendError(503, "Too many jobs in progress");
+            return;
         }
+        Serial.printf("Connecting to WiFi as job %u\n", (unsigned)id);
+        sendJobAccepted(response, id, "Connecting to WiFi");
+    } else {
+        response.sendError(400, "No body provided");
     }
-    
-    return response;
 }
 
-EndpointResponse handleSystemInfo(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
+// Fields of /api/system/info that only change on WiFi or provisioning
+// events. Written as an unterminated object so volatile fields can follow.
+static void buildSystemInfoStatic(ResponseSink& sink) {
+    extern String getId();
+    extern const char* PRIVATE_KEY_HEX;
     
+    JsonWriter json(sink);
+    json.beginObject();
+    json.member("deviceId", getId());
+    json.member("cpuFreq", ESP.getCpuFreqMHz());
+    json.member("flashSize", ESP.getFlashChipSize());
+    json.member("sdkVersion", ESP.getSdkVersion());
+    json.member("publicKey", crypto_get_public_key(PRIVATE_KEY_HEX));
+    
+    if (WiFi.status() == WL_CONNECTED) {
+        json.member("wifiStatus", "connected");
+        json.member("localIP", WiFi.localIP().toString());
+        json.member("ssid", WiFi.SSID());
+    } else {
+        json.member("wifiStatus", "disconnected");
+    }
+}
+
+void handleSystemInfo(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::GET) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    StaticJsonDocument<384> doc;
-    extern String getId();
-    String deviceId = getId();
+    const CachedResponse& cached = responseCacheFetch(CacheSlot::SYSTEM_INFO_STATIC, buildSystemInfoStatic);
     
-    doc["deviceId"] = deviceId;
-    doc["heap"] = ESP.getFreeHeap();
-    doc["cpuFreq"] = ESP.getCpuFreqMHz();
-    doc["flashSize"] = ESP.getFlashChipSize();
-    doc["sdkVersion"] = ESP.getSdkVersion();
-    
-    extern const char* PRIVATE_KEY_HEX;
-    String publicKey = crypto_get_public_key(PRIVATE_KEY_HEX);
-    doc["publicKey"] = publicKey;
+    response.begin(200, "application/json");
+    response.write(cached.body);
     
+    // Volatile fields are spliced in after the cached prefix
+    JsonWriter json(response);
+    json.resumeObject();
+    json.member("heap", ESP.getFreeHeap());
     if (WiFi.status() == WL_CONNECTED) {
-        doc["wifiStatus"] = "connected";
-        doc["localIP"] = WiFi.localIP().toString();
-        doc["ssid"] = WiFi.SSID();
-        doc["rssi"] = WiFi.RSSI();
-    } else {
-        doc["wifiStatus"] = "disconnected";
+        json.member("rssi", WiFi.RSSI());
     }
     
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    return response;
+    WiFiConnectMetrics wifiMetrics = wifiManager.metrics();
+    json.beginObject("wifiConnect");
+    json.member("attempts", wifiMetrics.attempts);
+    json.member("fastAttempts", wifiMetrics.fastAttempts);
+    json.member("failures", wifiMetrics.failures);
+    json.member("associateMs", wifiMetrics.lastAssociateMs);
+    json.member("connectMs", wifiMetrics.lastConnectMs);
+    json.member("reconnectMs", wifiMetrics.lastReconnectMs);
+    json.member("bootToConnectMs", wifiMetrics.bootToConnectMs);
+    json.member("fast", wifiMetrics.lastWasFast);
+    json.endObject();
+    
+    TimeSyncStatus timeStatus = timeSyncStatus();
+    json.beginObject("time");
+    json.member("state", timeSyncStateName(timeStatus.state));
+    json.member("lastSync", (long)timeStatus.lastSyncEpoch);
+    if (timeStatus.estimatedErrorMs >= 0) {
+        json.member("errorMs", timeStatus.estimatedErrorMs);
+    } else {
+        json.member("errorMs", nullptr);
+    }
+    json.member("driftPpm", timeStatus.driftPpm);
+    json.member("correctionMs", (long)timeStatus.correctionMs);
+    json.member("syncCount", timeStatus.syncCount);
+    json.endObject();
+    
+    ResponseCacheStats cacheStats = responseCacheStats();
+    uint32_t lookups = cacheStats.hits + cacheStats.misses;
+    json.beginObject("responseCache");
+    json.member("hits", cacheStats.hits);
+    json.member("misses", cacheStats.misses);
+    json.member("hitRatio", lookups > 0 ? (double)cacheStats.hits / lookups : 0.0);
+    json.member("savedUs", cacheStats.savedUs);
+    json.endObject();
+    
+    json.endObject();
 }
 
-EndpointResponse handleWiFiReset(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+void handleWiFiReset(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::POST) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
     WiFi.disconnect();
+    wifiManager.reset();
     extern String configuredSSID;
     extern String configuredPassword;
     extern bool isProvisioned;
@@ -121,240 +208,498 @@ EndpointResponse handleWiFiReset(const EndpointRequest& request) {
     isProvisioned = false;
     
     setupAP();
+    responseCacheInvalidate(CACHE_EVENT_PROVISIONING);
     
-    response.statusCode = 200;
-    response.data = "{\"status\":\"success\",\"message\":\"WiFi reset successful\"}";
-    return response;
+    response.sendSuccess("WiFi reset successful");
 }
 
-EndpointResponse handleCryptoInfo(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
+static void buildCryptoInfo(ResponseSink& sink) {
+    extern String getId();
+    extern const char* PRIVATE_KEY_HEX;
     
+    JsonWriter json(sink);
+    json.beginObject();
+    json.member("deviceName", "software_zap");
+    json.member("serialNumber", getId());
+    json.member("publicKey", crypto_get_public_key(PRIVATE_KEY_HEX));
+    json.endObject();
+}
+
+void handleCryptoInfo(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::GET) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    StaticJsonDocument<512> doc;
-    
-    doc["deviceName"] = "software_zap";
-    
-    extern String getId();
-    doc["serialNumber"] = getId();
-    
-    extern const char* PRIVATE_KEY_HEX;
-    String publicKey = crypto_get_public_key(PRIVATE_KEY_HEX);
-    doc["publicKey"] = publicKey;
-    
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    return response;
+    // Never changes at runtime, so polling clients get 304s via the ETag
+    responseCacheServe(request, response, CacheSlot::CRYPTO_INFO, buildCryptoInfo);
 }
 
-EndpointResponse handleNameInfo(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+void handleNameInfo(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::GET) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    extern String getId();
-    String name = fetchGatewayName(getId());
-    
-    StaticJsonDocument<256> doc;
-    doc["name"] = name;
-    
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    return response;
+    // Served from cache; a stale or missing value is refreshed in the background
+    NameCacheStatus cache = nameCacheGet();
+    
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    json.member("name", cache.name);
+    json.member("cached", cache.cached);
+    json.member("stale", cache.stale);
+    json.member("refreshing", cache.refreshing);
+    if (cache.ageSeconds >= 0) {
+        json.member("ageSeconds", cache.ageSeconds);
+    } else {
+        json.member("ageSeconds", nullptr);
+    }
+    json.member("hits", cache.hits);
+    json.member("misses", cache.misses);
+    json.endObject();
 }
 
-EndpointResponse handleWiFiStatus(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+void handleWiFiStatus(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::GET) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    StaticJsonDocument<1024> doc;  // Increased size to accommodate SSID list
-    JsonArray ssids = doc.createNestedArray("ssids");
-    
-    // Get the cached scan results
-    extern std::vector<String> lastScanResults;
-    for (const String& ssid : lastScanResults) {
-        ssids.add(ssid);
+    // Served from the scan cache, strongest network first; never waits for a scan
+    size_t count = wifiScanCount();
+    WiFiScanResult result;
+
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    json.beginArray("ssids");
+    for (size_t i = 0; i < count && wifiScanResult(i, result); i++) {
+        json.value(result.ssid);
     }
+    json.endArray();
+    json.beginArray("networks");
+    for (size_t i = 0; i < count && wifiScanResult(i, result); i++) {
+        char bssid[18];
+        snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 result.bssid[0], result.bssid[1], result.bssid[2],
+                 result.bssid[3], result.bssid[4], result.bssid[5]);
+        json.beginObject();
+        json.member("ssid", result.ssid);
+        json.member("bssid", bssid);
+        json.member("rssi", result.rssi);
+        json.member("channel", result.channel);
+        json.member("auth", wifiScanAuthName(result.authMode));
+        json.endObject();
+    }
+    json.endArray();
+    json.member("scanning", wifiScanRunning());
+    json.member("scanAgeMs", wifiScanAgeMs());
     
     // Add connected network info if connected
     if (WiFi.status() == WL_CONNECTED) {
-        doc["connected"] = WiFi.SSID();
+        json.member("connected", WiFi.SSID());
     } else {
-        doc["connected"] = nullptr;  // JSON null if not connected
+        json.member("connected", nullptr);  // JSON null if not connected
     }
-    
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    return response;
+    extern const char* MDNS_NAME;
+    json.member("hostname", MDNS_NAME);  // Lets the setup page build its redirect
+    json.endObject();
 }
 
-EndpointResponse handleWiFiScan(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+void handleWiFiScan(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::GET) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    // Start async WiFi scan
-    WiFi.scanNetworks(true);  // true = async scan
-    
-    StaticJsonDocument<128> doc;
-    doc["status"] = "scan initiated";
-    
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    return response;
+    // Results land in the scan cache and are served by GET /api/wifi
+    if (wifiScanStart()) {
+        response.send(200, "application/json", "{\"status\":\"scan initiated\"}");
+    } else {
+        response.send(200, "application/json", "{\"status\":\"scan in progress\"}");
+    }
 }
 
-EndpointResponse handleInitializeForm(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "text/html";
-    response.statusCode = 200;
-    response.data = FPSTR(INITIALIZE_FORM_HTML);
-    return response;
+void handleInitializeForm(const EndpointRequest& request, ResponseSink& response) {
+    serveWebAsset(request, response, WEB_ASSET_INITIALIZE);
 }
 
-EndpointResponse handleInitialize(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+void handleInitialize(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::POST) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
     if (request.content.length() == 0) {
-        response.statusCode = 400;
-        response.data = "{\"status\":\"error\",\"message\":\"No body provided\"}";
-        return response;
+        response.sendError(400, "No body provided");
+        return;
     }
 
-    StaticJsonDocument<512> requestDoc;
+    ArenaJsonDocument requestDoc(arenaJsonCapacity(request.content.length()));
     DeserializationError error = deserializeJson(requestDoc, request.content);
     
-    if (error || !requestDoc.containsKey("wallet")) {
-        response.statusCode = 400;
-        response.data = "{\"status\":\"error\",\"message\":\"Invalid JSON or missing wallet\"}";
-        return response;
+    if (error == DeserializationError::NoMemory) {
+        response.sendError(413, "Request too large");
+        return;
+    }
+    if (error || !requestDoc["wallet"].is<const char*>()) {
+        response.sendError(400, "Invalid JSON or missing wallet");
+        return;
     }
 
     extern String getId();
-    String deviceId = getId();
-    String idAndWallet = deviceId + ":" + requestDoc["wallet"].as<String>();
+    const char* idAndWallet = requestArena.format("%s:%s", getId().c_str(), requestDoc["wallet"].as<const char*>());
+    if (idAndWallet == nullptr) {
+        response.sendError(413, "Request too large");
+        return;
+    }
     
     extern const char* PRIVATE_KEY_HEX;
-    String signature = crypto_create_signature_hex(idAndWallet.c_str(), PRIVATE_KEY_HEX);
-    
-    StaticJsonDocument<512> doc;
-    doc["idAndWallet"] = idAndWallet;
-    doc["signature"] = signature;
-    
-    response.statusCode = 200;
-    serializeJson(doc, response.data);
-    
-    return response;
+    String signature = crypto_create_signature_hex(idAndWallet, PRIVATE_KEY_HEX);
+    
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    json.member("idAndWallet", idAndWallet);
+    json.member("signature", signature);
+    json.endObject();
 }
 
-EndpointResponse handleCryptoSign(const EndpointRequest& request) {
-    EndpointResponse response;
-    response.contentType = "application/json";
-    
+// Signs "message|nonce|timestamp|serial" (or "nonce|timestamp|serial" for an
+// empty message) with a fresh nonce from the hardware RNG and writes the
+// {"message", "sign"} members. The combined message is scratch space in the
+// request arena, released again before returning.
+static void writeSignedEnvelope(JsonWriter& json, crypto_signer_t& signer, const char* message,
+                                const char* timestamp, const char* serial) {
+    char nonce[8];
+    snprintf(nonce, sizeof(nonce), "%u", (unsigned)(100000u + esp_random() % 900000u));
+
+    size_t mark = requestArena.mark();
+    const char* combinedMessage = message[0] != '\0'
+        ? requestArena.format("%s|%s|%s|%s", message, nonce, timestamp, serial)
+        : requestArena.format("%s|%s|%s", nonce, timestamp, serial);
+
+    char signature[129];
+    if (combinedMessage == nullptr ||
+        !crypto_signer_sign_hex(&signer, combinedMessage, strlen(combinedMessage), signature)) {
+        signature[0] = '\0';
+    }
+    json.member("message", combinedMessage);
+    json.member("sign", signature);
+    requestArena.rewind(mark);
+}
+
+void handleCryptoSign(const EndpointRequest& request, ResponseSink& response) {
     if (request.method != HttpMethod::POST) {
-        response.statusCode = 405;
-        response.data = "{\"status\":\"error\",\"message\":\"Method not allowed\"}";
-        return response;
+        response.sendError(405, "Method not allowed");
+        return;
     }
 
-    // Parse the incoming JSON request
-    StaticJsonDocument<512> requestDoc;
+    // Parse the incoming JSON request, with room for a full batch
+    ArenaJsonDocument requestDoc(arenaJsonCapacity(request.content.length(), CRYPTO_SIGN_MAX_BATCH + 8));
     DeserializationError error = deserializeJson(requestDoc, request.content);
     
+    if (error == DeserializationError::NoMemory) {
+        response.sendError(413, "Request too large");
+        return;
+    }
     if (error) {
-        response.statusCode = 400;
-        response.data = "{\"status\":\"error\",\"message\":\"Invalid JSON\"}";
-        return response;
+        response.sendError(400, "Invalid JSON");
+        return;
     }
     
-    // Get message to sign if provided, otherwise use an empty string
-    String message = "";
-    if (requestDoc.containsKey("message")) {
-        message = requestDoc["message"].as<String>();
-        
-        // Check for pipe characters which are not allowed
-        if (message.indexOf('|') != -1) {
-            response.statusCode = 400;
-            response.data = "{\"status\":\"error\",\"message\":\"Message cannot contain | characters\"}";
-            return response;
+    // Either "messages" (an array, answered with an array of envelopes) or a
+    // single optional "message". Strings point into the document, which
+    // lives in the request arena.
+    bool batch = requestDoc.containsKey("messages");
+    JsonArrayConst messages = requestDoc["messages"].as<JsonArrayConst>();
+    const char* message = requestDoc["message"] | "";
+    size_t longest = strlen(message);
+    
+    if (batch) {
+        if (messages.isNull()) {
+            response.sendError(400, "Messages must be an array");
+            return;
         }
+        if (messages.size() > CRYPTO_SIGN_MAX_BATCH) {
+            response.sendError(413, "Too many messages");
+            return;
+        }
+        for (JsonVariantConst item : messages) {
+            if (!item.is<const char*>()) {
+                response.sendError(400, "Messages must be strings");
+                return;
+            }
+            const char* text = item.as<const char*>();
+            if (strchr(text, '|') != nullptr) {
+                response.sendError(400, "Message cannot contain | characters");
+                return;
+            }
+            size_t length = strlen(text);
+            if (length > longest) {
+                longest = length;
+            }
+        }
+    } else if (strchr(message, '|') != nullptr) {
+        // Check for pipe characters which are not allowed
+        response.sendError(400, "Message cannot contain | characters");
+        return;
     }
     
-    // Generate nonce (random string)
-    String nonce = String(random(100000, 999999));
-    
-    // Get timestamp - use provided timestamp or generate one
-    String timestampStr;
-    if (requestDoc.containsKey("timestamp")) {
-        timestampStr = requestDoc["timestamp"].as<String>();
-        
+    // Get timestamp - use provided timestamp or generate one. A batch
+    // shares one timestamp; every envelope gets its own nonce.
+    const char* timestampStr = requestDoc["timestamp"];
+    char timestamp[24];
+    if (timestampStr != nullptr) {
         // Check for pipe characters which are not allowed
-        if (timestampStr.indexOf('|') != -1) {
-            response.statusCode = 400;
-            response.data = "{\"status\":\"error\",\"message\":\"Timestamp cannot contain | characters\"}";
-            return response;
+        if (strchr(timestampStr, '|') != nullptr) {
+            response.sendError(400, "Timestamp cannot contain | characters");
+            return;
         }
     } else {
         // Generate timestamp in UTC format (Y-m-dTH:M:SZ)
         time_t now;
         time(&now);
-        char timestamp[24];
         strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
-        timestampStr = String(timestamp);
+        timestampStr = timestamp;
     }
     
     // Get device serial number
     extern String getId();
     String serialNumber = getId();
     
-    // Create the combined message: message|nonce|timestamp|serial
-    // If message is empty, don't include the initial pipe character
-    String combinedMessage;
-    if (message.length() > 0) {
-        combinedMessage = message + "|" + nonce + "|" + timestampStr + "|" + serialNumber;
-    } else {
-        combinedMessage = nonce + "|" + timestampStr + "|" + serialNumber;
+    // The longest combined message must fit the arena, so nothing can fail
+    // once the response has started
+    if (longest + strlen(timestampStr) + serialNumber.length() + 16 > requestArena.available()) {
+        response.sendError(413, "Request too large");
+        return;
     }
     
-    // Sign the combined message
+    // One key decode and hash context for the whole request
     extern const char* PRIVATE_KEY_HEX;
-    String signature = crypto_create_signature_hex(combinedMessage.c_str(), PRIVATE_KEY_HEX);
+    crypto_signer_t signer;
+    if (!crypto_signer_begin(&signer, PRIVATE_KEY_HEX)) {
+        crypto_signer_end(&signer);
+        response.sendError(500, "Signing key unavailable");
+        return;
+    }
     
     // Create the response
-    StaticJsonDocument<1024> responseDoc;
-    responseDoc["message"] = combinedMessage;
-    responseDoc["sign"] = signature;
-    
-    response.statusCode = 200;
-    serializeJson(responseDoc, response.data);
-    return response;
-} 
\ No newline at end of file
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    if (batch) {
+        json.beginArray("signatures");
+        for (JsonVariantConst item : messages) {
+            json.beginObject();
+            writeSignedEnvelope(json, signer, item.as<const char*>(), timestampStr, serialNumber.c_str());
+            json.endObject();
+        }
+        json.endArray();
+    } else {
+        writeSignedEnvelope(json, signer, message, timestampStr, serialNumber.c_str());
+    }
+    json.endObject();
+    crypto_signer_end(&signer);
+}
+
+void handleBleStop(const EndpointRequest& request, ResponseSink& response) {
+    if (request.method != HttpMethod::POST) {
+        response.sendError(405, "Method not allowed");
+        return;
+    }
+
+    #if defined(USE_BLE_SETUP)
+        extern unsigned long bleShutdownTime;
+        // Schedule BLE shutdown in 10 seconds
+        bleShutdownTime = millis() + 10000;
+        response.sendSuccess("BLE shutdown scheduled");
+    #else
+        response.sendError(400, "BLE not enabled");
+    #endif
+}
+
+void handleMetrics(const EndpointRequest& request, ResponseSink& response) {
+    if (request.method != HttpMethod::GET) {
+        response.sendError(405, "Method not allowed");
+        return;
+    }
+
+    // Prometheus text for scrapers over HTTP, compact JSON for BLE clients
+    if (request.transport == RequestTransport::BLE) {
+        metricsWriteJson(response);
+    } else {
+        metricsWritePrometheus(response);
+    }
+}
+
+void handleStream(const EndpointRequest& request, ResponseSink& response) {
+    if (request.method != HttpMethod::GET) {
+        response.sendError(405, "Method not allowed");
+        return;
+    }
+
+    // On success the hub owns the connection and nothing is sent here
+    if (!eventStreamSubscribe(response)) {
+        response.addHeader("Retry-After", "10");
+        response.sendError(503, "Too many stream subscribers");
+    }
+}
+
+bool queryParam(const EndpointRequest& request, const char* name, String& value) {
+    size_t nameLength = strlen(name);
+    const char* query = request.query.c_str();
+    while (*query != '\0') {
+        const char* end = strchr(query, '&');
+        size_t length = end != nullptr ? end - query : strlen(query);
+        if (length > nameLength && query[nameLength] == '=' && strncmp(query, name, nameLength) == 0) {
+            value = String();
+            value.concat(query + nameLength + 1, length - nameLength - 1);
+            return true;
+        }
+        if (end == nullptr) {
+            break;
+        }
+        query = end + 1;
+    }
+    return false;
+}
+
+// Unsigned query parameter; false if present but not a number
+static bool queryUnsigned(const EndpointRequest& request, const char* name, uint32_t& value) {
+    String text;
+    if (!queryParam(request, name, text)) {
+        return true;  // Keep the default
+    }
+    char* end;
+    unsigned long parsed = strtoul(text.c_str(), &end, 10);
+    if (text.length() == 0 || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+static void writeReadingRow(const ReadingRecord& row, uint32_t samples, void* context) {
+    JsonWriter& json = *static_cast<JsonWriter*>(context);
+    json.beginArray();
+    json.value(row.time);
+    json.value(row.importKwh);
+    json.value(row.powerKw);
+    for (int i = 0; i < 3; i++) {
+        json.value(row.phasePowerKw[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        json.value(row.voltage[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        json.value(row.current[i]);
+    }
+    json.value(samples);
+    json.endArray();
+}
+
+void handleReadings(const EndpointRequest& request, ResponseSink& response) {
+    if (request.method != HttpMethod::GET) {
+        response.sendError(405, "Method not allowed");
+        return;
+    }
+
+    // Defaults: the last hour, every record. BLE responses are buffered
+    // whole, so they get a much smaller row limit.
+    uint32_t maxRows = request.transport == RequestTransport::BLE ? READINGS_MAX_ROWS_BLE : READINGS_MAX_ROWS;
+    uint32_t to = readingHistory.newestTime();
+    uint32_t from = to > 3600 ? to - 3600 : 0;
+    uint32_t step = 0;
+    uint32_t limit = maxRows;
+    if (!queryUnsigned(request, "from", from) || !queryUnsigned(request, "to", to) ||
+        !queryUnsigned(request, "step", step) || !queryUnsigned(request, "limit", limit)) {
+        response.sendError(400, "from, to, step and limit must be unsigned integers");
+        return;
+    }
+    if (from > to) {
+        response.sendError(400, "from must not be after to");
+        return;
+    }
+    if (limit == 0 || limit > maxRows) {
+        limit = maxRows;
+    }
+
+    // Rows are streamed as the query walks the ring
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+    json.member("from", from);
+    json.member("to", to);
+    json.member("step", step);
+    json.beginArray("fields");
+    static const char* const FIELDS[] = {
+        "t", "importKwh", "powerKw", "powerL1Kw", "powerL2Kw", "powerL3Kw",
+        "voltageL1", "voltageL2", "voltageL3", "currentL1", "currentL2", "currentL3", "n"
+    };
+    for (const char* field : FIELDS) {
+        json.value(field);
+    }
+    json.endArray();
+    json.beginArray("rows");
+    ReadingQueryStats stats = readingHistory.query(from, to, step, limit, writeReadingRow, &json);
+    json.endArray();
+    json.member("truncated", stats.truncated);
+    if (stats.truncated) {
+        json.member("next", stats.next);
+    }
+    json.endObject();
+}
+
+static void writeJob(JsonWriter& json, const JobInfo& job) {
+    json.beginObject();
+    json.member("id", job.id);
+    json.member("kind", job.kind);
+    json.member("state", jobStateName(job.state));
+    json.member("ageMs", job.ageMs);
+    json.member("runMs", job.runMs);
+    if (job.state == JobState::SUCCEEDED || job.state == JobState::FAILED) {
+        json.member("status", job.result.status);
+        json.member("message", job.result.message);
+    }
+    json.endObject();
+}
+
+void handleJobs(const EndpointRequest& request, ResponseSink& response) {
+    if (request.method != HttpMethod::GET) {
+        response.sendError(405, "Method not allowed");
+        return;
+    }
+
+    // /api/jobs/ lists the live jobs
+    if (request.pathParam.length() == 0) {
+        uint32_t ids[JOB_TABLE_SIZE];
+        size_t count = jobList(ids, JOB_TABLE_SIZE);
+        response.begin(200, "application/json");
+        JsonWriter json(response);
+        json.beginObject();
+        json.beginArray("jobs");
+        JobInfo job;
+        for (size_t i = 0; i < count; i++) {
+            if (jobGet(ids[i], job)) {
+                writeJob(json, job);
+            }
+        }
+        json.endArray();
+        json.endObject();
+        return;
+    }
+
+    char* end = nullptr;
+    unsigned long id = strtoul(request.pathParam.c_str(), &end, 10);
+    JobInfo job;
+    if (end == request.pathParam.c_str() || *end != '\0' || !jobGet((uint32_t)id, job)) {
+        response.sendError(404, "Job not found");
+        return;
+    }
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    writeJob(json, job);
+}
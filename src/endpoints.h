@@ -3,13 +3,22 @@
 #include <Arduino.h>
 #include "endpoint_types.h"
 #include <ArduinoJson.h>
+#include "response_sink.h"
 
-// Response structure that can be used by both BLE and HTTP handlers
-struct EndpointResponse {
-    int statusCode;      // HTTP-style status code (200, 400, etc.)
-    String contentType;  // Content type of the response
-    String data;        // Response data
-};
+// Rows per /api/readings response; page with `next`. The async server
+// renders a response whole before sending it, so a page must fit in
+// ASYNC_HTTP_MAX_RESPONSE_SIZE (500 rows is about 40 KB of JSON).
+#ifndef READINGS_MAX_ROWS
+#define READINGS_MAX_ROWS 500
+#endif
+
+#ifndef READINGS_MAX_ROWS_BLE
+#define READINGS_MAX_ROWS_BLE 60
+#endif
+
+#ifndef CRYPTO_SIGN_MAX_BATCH
+#define CRYPTO_SIGN_MAX_BATCH 32  // Messages per /api/crypto/sign request
+#endif
 
 // Request structure that normalizes input from both BLE and HTTP
 struct EndpointRequest {
@@ -17,14 +26,27 @@ struct EndpointRequest {
     Endpoint endpoint;
     String content;
     int offset;
+    String ifNoneMatch;  // If-None-Match header (HTTP only)
+    String query;        // Query string without the '?', e.g. "from=1&to=2"
+    String pathParam;    // Path below a ROUTE_PREFIX route, e.g. "7" for /api/jobs/7
+    RequestTransport transport = RequestTransport::HTTP;
+    uint32_t client = 0; // Rate limiting key: IPv4 address (HTTP) or connection (BLE); 0 = internal
 };
 
-// Endpoint handler functions
-EndpointResponse handleWiFiConfig(const EndpointRequest& request);
-EndpointResponse handleSystemInfo(const EndpointRequest& request);
-EndpointResponse handleWiFiReset(const EndpointRequest& request);
-EndpointResponse handleCryptoInfo(const EndpointRequest& request);
-EndpointResponse handleNameInfo(const EndpointRequest& request);
-EndpointResponse handleWiFiStatus(const EndpointRequest& request);
-EndpointResponse handleWiFiScan(const EndpointRequest& request);
-EndpointResponse handleCryptoSign(const EndpointRequest& request); 
\ No newline at end of file
+// Endpoint handler functions. Each writes its response into the sink.
+void handleWiFiConfig(const EndpointRequest& request, ResponseSink& response);
+void handleSystemInfo(const EndpointRequest& request, ResponseSink& response);
+void handleWiFiReset(const EndpointRequest& request, ResponseSink& response);
+void handleCryptoInfo(const EndpointRequest& request, ResponseSink& response);
+void handleNameInfo(const EndpointRequest& request, ResponseSink& response);
+void handleWiFiStatus(const EndpointRequest& request, ResponseSink& response);
+void handleWiFiScan(const EndpointRequest& request, ResponseSink& response);
+void handleCryptoSign(const EndpointRequest& request, ResponseSink& response);
+void handleBleStop(const EndpointRequest& request, ResponseSink& response);
+void handleMetrics(const EndpointRequest& request, ResponseSink& response);
+void handleStream(const EndpointRequest& request, ResponseSink& response);
+void handleReadings(const EndpointRequest& request, ResponseSink& response);
+void handleJobs(const EndpointRequest& request, ResponseSink& response);
+
+// Value of a query string parameter; false if it is absent
+bool queryParam(const EndpointRequest& request, const char* name, String& value); 
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "event_stream.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+
+#define SELECT_IDLE_MS 1000
+#define SELECT_BLOCKED_MS 50   // Retry interval while a subscriber's socket is full
+
+static_assert(EVENT_STREAM_BACKLOG >= 2 && EVENT_STREAM_BACKLOG <= 255, "EVENT_STREAM_BACKLOG out of range");
+
+// One serialized event, shared by every queue it is in. Reference counts
+// are only changed with hubLock held.
+struct StreamEvent {
+    uint32_t refs;
+    size_t length;
+    char data[1];
+};
+
+struct Subscriber {
+    DetachedSocket socket;    // fd < 0: slot free
+    StreamEvent* queue[EVENT_STREAM_BACKLOG];
+    uint8_t queued;
+    size_t offset;            // Bytes of queue[0] already sent
+};
+
+static Subscriber subscribers[EVENT_STREAM_MAX_SUBSCRIBERS];
+static SemaphoreHandle_t hubLock = nullptr;
+static TaskHandle_t senderTask = nullptr;
+static StreamEvent* latest = nullptr;      // Replayed to new subscribers
+static StreamEvent* headers = nullptr;     // Response head, queued first on subscribe
+static StreamEvent* keepalive = nullptr;
+static uint32_t sequence = 0;
+static EventStreamStats stats = {};
+
+static StreamEvent* createEvent(size_t length) {
+    StreamEvent* event = (StreamEvent*)malloc(sizeof(StreamEvent) + length);
+    if (event != nullptr) {
+        event->refs = 0;
+        event->length = length;
+    }
+    return event;
+}
+
+// Events owned by the hub for its whole lifetime
+static StreamEvent* createStaticEvent(const char* text) {
+    size_t length = strlen(text);
+    StreamEvent* event = createEvent(length);
+    if (event != nullptr) {
+        memcpy(event->data, text, length);
+        event->refs = 1;
+    }
+    return event;
+}
+
+static void releaseEvent(StreamEvent* event) {
+    if (--event->refs == 0) {
+        free(event);
+    }
+}
+
+static void enqueue(Subscriber& subscriber, StreamEvent* event) {
+    if (subscriber.queued == EVENT_STREAM_BACKLOG) {
+        // Drop the oldest event that hasn't started going out; a partly sent
+        // event or the response head must complete to keep the stream valid
+        size_t drop = (subscriber.offset > 0 || subscriber.queue[0] == headers) ? 1 : 0;
+        releaseEvent(subscriber.queue[drop]);
+        memmove(&subscriber.queue[drop], &subscriber.queue[drop + 1],
+                (subscriber.queued - drop - 1) * sizeof(StreamEvent*));
+        subscriber.queued--;
+        stats.dropped++;
+    }
+    event->refs++;
+    subscriber.queue[subscriber.queued++] = event;
+}
+
+static void closeSubscriber(Subscriber& subscriber) {
+    for (size_t i = 0; i < subscriber.queued; i++) {
+        releaseEvent(subscriber.queue[i]);
+    }
+    subscriber.queued = 0;
+    subscriber.offset = 0;
+    if (subscriber.socket.owner.fd() >= 0) {
+        subscriber.socket.owner = WiFiClient();  // Last copy closes the socket
+    } else {
+        close(subscriber.socket.fd);
+    }
+    subscriber.socket.fd = -1;
+    stats.subscribers--;
+}
+
+// Send as much of the queue as the socket takes without blocking.
+// Returns true if data is left over.
+static bool flushSubscriber(Subscriber& subscriber) {
+    while (subscriber.queued > 0) {
+        StreamEvent* event = subscriber.queue[0];
+        int sent = send(subscriber.socket.fd, event->data + subscriber.offset,
+                        event->length - subscriber.offset, MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            stats.disconnects++;
+            closeSubscriber(subscriber);
+            return false;
+        }
+        subscriber.offset += sent;
+        if (subscriber.offset < event->length) {
+            return true;
+        }
+        releaseEvent(event);
+        memmove(&subscriber.queue[0], &subscriber.queue[1], (subscriber.queued - 1) * sizeof(StreamEvent*));
+        subscriber.queued--;
+        subscriber.offset = 0;
+    }
+    return false;
+}
+
+// Call with hubLock held
+static bool flushAll() {
+    bool pending = false;
+    for (Subscriber& subscriber : subscribers) {
+        if (subscriber.socket.fd >= 0 && flushSubscriber(subscriber)) {
+            pending = true;
+        }
+    }
+    return pending;
+}
+
+static void senderLoop(void* param) {
+    unsigned long lastKeepalive = millis();
+    for (;;) {
+        fd_set readSet;
+        fd_set writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        int maxFd = -1;
+        bool pending = false;
+
+        xSemaphoreTake(hubLock, portMAX_DELAY);
+        for (Subscriber& subscriber : subscribers) {
+            if (subscriber.socket.fd < 0) {
+                continue;
+            }
+            FD_SET(subscriber.socket.fd, &readSet);
+            if (subscriber.queued > 0) {
+                FD_SET(subscriber.socket.fd, &writeSet);
+                pending = true;
+            }
+            if (subscriber.socket.fd > maxFd) {
+                maxFd = subscriber.socket.fd;
+            }
+        }
+        xSemaphoreGive(hubLock);
+
+        // A subscriber closed by a publisher meanwhile only causes a spurious wakeup
+        if (maxFd < 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // Woken by the first subscriber
+            continue;
+        }
+        uint32_t waitMs = pending ? SELECT_BLOCKED_MS : SELECT_IDLE_MS;
+        struct timeval timeout = { (long)(waitMs / 1000), (long)(waitMs % 1000) * 1000 };
+        int ready = select(maxFd + 1, &readSet, pending ? &writeSet : nullptr, nullptr, &timeout);
+
+        xSemaphoreTake(hubLock, portMAX_DELAY);
+        if (ready > 0) {
+            // Subscribers never send anything; readable means closed
+            for (Subscriber& subscriber : subscribers) {
+                if (subscriber.socket.fd >= 0 && FD_ISSET(subscriber.socket.fd, &readSet)) {
+                    char discard[32];
+                    int received = recv(subscriber.socket.fd, discard, sizeof(discard), MSG_DONTWAIT);
+                    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        closeSubscriber(subscriber);
+                    }
+                }
+            }
+        }
+        if (millis() - lastKeepalive >= EVENT_STREAM_KEEPALIVE_MS) {
+            lastKeepalive = millis();
+            for (Subscriber& subscriber : subscribers) {
+                if (subscriber.socket.fd >= 0 && subscriber.queued == 0) {
+                    enqueue(subscriber, keepalive);
+                }
+            }
+        }
+        flushAll();
+        xSemaphoreGive(hubLock);
+    }
+}
+
+void eventStreamInit() {
+    if (hubLock != nullptr) {
+        return;
+    }
+    for (Subscriber& subscriber : subscribers) {
+        subscriber.socket.fd = -1;
+    }
+    headers = createStaticEvent(
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "\r\n"
+        "retry: 3000\n\n");
+    keepalive = createStaticEvent(":\n\n");
+    hubLock = xSemaphoreCreateMutex();
+    if (xTaskCreate(senderLoop, "event_stream", EVENT_STREAM_TASK_STACK, nullptr, 1, &senderTask) != pdPASS) {
+        Serial.println("Event stream: failed to start task");
+    }
+}
+
+bool eventStreamSubscribe(ResponseSink& response) {
+    if (hubLock == nullptr || senderTask == nullptr) {
+        return false;
+    }
+    xSemaphoreTake(hubLock, portMAX_DELAY);
+    Subscriber* slot = nullptr;
+    for (Subscriber& subscriber : subscribers) {
+        if (subscriber.socket.fd < 0) {
+            slot = &subscriber;
+            break;
+        }
+    }
+    if (slot == nullptr || !response.detach(slot->socket)) {
+        if (slot == nullptr) {
+            stats.rejected++;
+        }
+        xSemaphoreGive(hubLock);
+        return false;
+    }
+
+    int noDelay = 1;
+    setsockopt(slot->socket.fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    stats.subscribers++;
+    stats.subscribed++;
+    enqueue(*slot, headers);
+    if (latest != nullptr) {
+        enqueue(*slot, latest);
+    }
+    flushSubscriber(*slot);
+    xSemaphoreGive(hubLock);
+
+    xTaskNotifyGive(senderTask);
+    return true;
+}
+
+void eventStreamPublish(const char* event, const char* data, size_t length) {
+    if (hubLock == nullptr) {
+        return;
+    }
+    char head[64];
+    xSemaphoreTake(hubLock, portMAX_DELAY);
+    uint32_t id = ++sequence;
+    xSemaphoreGive(hubLock);
+
+    // Serialized once; every subscriber queues the same buffer
+    int headLength = snprintf(head, sizeof(head), "id: %u\nevent: %s\ndata: ", id, event);
+    if (headLength <= 0 || (size_t)headLength >= sizeof(head)) {
+        return;
+    }
+    StreamEvent* serialized = createEvent(headLength + length + 2);
+    if (serialized == nullptr) {
+        return;
+    }
+    memcpy(serialized->data, head, headLength);
+    memcpy(serialized->data + headLength, data, length);
+    memcpy(serialized->data + headLength + length, "\n\n", 2);
+
+    xSemaphoreTake(hubLock, portMAX_DELAY);
+    serialized->refs = 1;  // Held as `latest`
+    if (latest != nullptr) {
+        releaseEvent(latest);
+    }
+    latest = serialized;
+    for (Subscriber& subscriber : subscribers) {
+        if (subscriber.socket.fd >= 0) {
+            enqueue(subscriber, serialized);
+        }
+    }
+    stats.published++;
+    // Healthy subscribers get the event right away; the sender task
+    // finishes whatever a full socket didn't take
+    flushAll();
+    xSemaphoreGive(hubLock);
+}
+
+EventStreamStats eventStreamStats() {
+    if (hubLock == nullptr) {
+        return {};
+    }
+    xSemaphoreTake(hubLock, portMAX_DELAY);
+    EventStreamStats snapshot = stats;
+    xSemaphoreGive(hubLock);
+    return snapshot;
+}
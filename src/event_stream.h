@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include "response_sink.h"
+
+// Server-Sent Events hub behind /api/stream.
+// Each published event is serialized once into a shared, reference-counted
+// buffer and queued to every subscriber. A sender task writes the queues
+// with non-blocking sends, so a slow client never stalls the publisher or
+// the other clients. A full queue drops its oldest event.
+
+#ifndef EVENT_STREAM_MAX_SUBSCRIBERS
+#define EVENT_STREAM_MAX_SUBSCRIBERS 4
+#endif
+
+#ifndef EVENT_STREAM_BACKLOG
+#define EVENT_STREAM_BACKLOG 8  // Events queued per subscriber before dropping
+#endif
+
+#ifndef EVENT_STREAM_KEEPALIVE_MS
+#define EVENT_STREAM_KEEPALIVE_MS 15000  // Comment line so proxies and dead peers are noticed
+#endif
+
+#ifndef EVENT_STREAM_TASK_STACK
+#define EVENT_STREAM_TASK_STACK 3072
+#endif
+
+struct EventStreamStats {
+    uint32_t subscribers;      // Currently connected
+    uint32_t subscribed;       // Total accepted since boot
+    uint32_t rejected;         // Turned away because all slots were in use
+    uint32_t published;
+    uint32_t dropped;          // Queued events discarded by backpressure
+    uint32_t disconnects;      // Subscribers closed after a failed send
+};
+
+// Create the hub and its sender task. Call once from setup().
+void eventStreamInit();
+
+// Take over the connection behind `response` and start streaming to it.
+// The latest event is replayed first. Returns false (without touching the
+// response) if the transport can't stream or every slot is taken.
+bool eventStreamSubscribe(ResponseSink& response);
+
+// Queue `data` as an event of type `event` to every subscriber. `data` must
+// be a single line (e.g. compact JSON). The event id is a sequence number.
+// Never blocks on the network.
+void eventStreamPublish(const char* event, const char* data, size_t length);
+
+EventStreamStats eventStreamStats();
@@ -1,80 +1,274 @@
 #include "graphql.h"
-#include "esp_heap_caps.h"  // Add this for heap functions
-
-// At the top of the file, outside any function
-static uint8_t* sslBuffer = nullptr;
-const size_t SSL_BUFFER_SIZE = 16 * 1024;  // 16KB buffer
+#include "tls_budget.h"
 
 // Define static SSL client
 WiFiClientSecure sslClient;
 
+// Plain client for http:// endpoints (e.g. a local stand-in server)
+static WiFiClient plainClient;
+
 // Add this function
 void initSSL() {
-    // Configure SSL client early to reserve memory
+    // Reserve the TLS record buffer pool before anything uses mbedtls
+    tlsBudgetInit();
     sslClient.setInsecure();
 }
 
-String prepareGraphQLQuery(const String& rawQuery) {
-    String prepared = rawQuery;
-    prepared.replace("\"", "\\\"");
-    prepared.replace("\n", "\\n");
-    return prepared;
+// True if the literal can be embedded in a JSON string without escaping.
+// Used to check the operation templates at compile time.
+static constexpr bool isJsonSafe(const char* s) {
+    return *s == '\0' ||
+           (*s != '"' && *s != '\\' && (unsigned char)*s >= 0x20 && isJsonSafe(s + 1));
 }
 
-bool makeGraphQLRequest(const String& query, String& responseData, const char* endpoint) {
+// Operation templates. Values are passed as GraphQL variables, never spliced
+// into the query text, so the text is constant and needs no runtime escaping.
+#define GATEWAY_NAME_QUERY \
+    "query GatewayName($id:String!){gatewayConfiguration{gatewayName(id:$id){name}}}"
+#define INITIALIZE_MUTATION \
+    "mutation Initialize($idAndWallet:String!,$signature:String!,$dryRun:Boolean!)" \
+    "{gatewayInception{initialize(gatewayInitialization:" \
+    "{idAndWallet:$idAndWallet,signature:$signature,dryRun:$dryRun}){initialized}}}"
+
+static_assert(isJsonSafe(GATEWAY_NAME_QUERY), "GatewayName query must not need JSON escaping");
+static_assert(isJsonSafe(INITIALIZE_MUTATION), "Initialize mutation must not need JSON escaping");
+
+#define GRAPHQL_BODY_PREFIX(query) "{\"query\":\"" query "\",\"variables\":{"
+static const char GRAPHQL_BODY_SUFFIX[] = "}}";
+
+static const char GATEWAY_NAME_BODY[] PROGMEM = GRAPHQL_BODY_PREFIX(GATEWAY_NAME_QUERY);
+static const GraphQLVariable GATEWAY_NAME_VARS[] = {
+    { "id", GraphQLVarType::STRING },
+};
+const GraphQLOperation GQL_GATEWAY_NAME = {
+    "GatewayName", GATEWAY_NAME_BODY, GATEWAY_NAME_VARS, 1
+};
+
+static const char INITIALIZE_BODY[] PROGMEM = GRAPHQL_BODY_PREFIX(INITIALIZE_MUTATION);
+static const GraphQLVariable INITIALIZE_VARS[] = {
+    { "idAndWallet", GraphQLVarType::STRING },
+    { "signature", GraphQLVarType::STRING },
+    { "dryRun", GraphQLVarType::BOOLEAN },
+};
+const GraphQLOperation GQL_INITIALIZE = {
+    "Initialize", INITIALIZE_BODY, INITIALIZE_VARS, 3
+};
+
+#define GRAPHQL_MAX_VARIABLES 4
+// prefix + suffix + per variable: separator, name, '":', and up to 3 value pieces
+#define GRAPHQL_MAX_PIECES (2 + GRAPHQL_MAX_VARIABLES * 6)
+
+// Number of bytes needed to encode one character inside a JSON string
+static size_t jsonEscapedCharLength(unsigned char c) {
+    if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') return 2;
+    if (c < 0x20) return 6;  // \u00XX
+    return 1;
+}
+
+// Stream that produces the request body piece by piece while HTTPClient
+// copies it to the socket, so the full body never exists in RAM
+class GraphQLBodyStream : public Stream {
+public:
+    GraphQLBodyStream() : _count(0), _index(0), _pos(0), _pendingLen(0), _pendingPos(0), _remaining(0) {}
+
+    bool build(const GraphQLOperation& op, const GraphQLValue* values) {
+        if (op.variableCount > GRAPHQL_MAX_VARIABLES) return false;
+
+        addLiteral(op.bodyPrefix);
+        for (size_t i = 0; i < op.variableCount; i++) {
+            const GraphQLVariable& var = op.variables[i];
+            const GraphQLValue& value = values[i];
+            if (value.type != var.type) {
+                Serial.printf("GraphQL: variable '%s' has wrong type\n", var.name);
+                return false;
+            }
+
+            addLiteral(i == 0 ? "\"" : ",\"");
+            addLiteral(var.name);
+            addLiteral("\":");
+            if (var.type == GraphQLVarType::STRING) {
+                if (value.str == nullptr) return false;
+                addLiteral("\"");
+                addEscaped(value.str);
+                addLiteral("\"");
+            } else {
+                addLiteral(value.flag ? "true" : "false");
+            }
+        }
+        addLiteral(GRAPHQL_BODY_SUFFIX);
+        return true;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < _count; i++) {
+            total += _pieces[i].encodedLength;
+        }
+        return total;
+    }
+
+    void rewind() {
+        _index = 0;
+        _pos = 0;
+        _pendingLen = 0;
+        _pendingPos = 0;
+        _remaining = size();
+    }
+
+    int available() override { return (int)_remaining; }
+
+    int read() override {
+        int c = peek();
+        if (c >= 0) {
+            advance();
+        }
+        return c;
+    }
+
+    int peek() override {
+        if (_pendingPos < _pendingLen) {
+            return (unsigned char)_pending[_pendingPos];
+        }
+        while (_index < _count && _pos >= _pieces[_index].length) {
+            _index++;
+            _pos = 0;
+        }
+        if (_index >= _count) {
+            return -1;
+        }
+
+        const Piece& piece = _pieces[_index];
+        unsigned char c = (unsigned char)piece.data[_pos];
+        if (!piece.escape || jsonEscapedCharLength(c) == 1) {
+            return c;
+        }
+
+        // Expand the escape sequence into the pending buffer
+        switch (c) {
+            case '"':  memcpy(_pending, "\\\"", 2); _pendingLen = 2; break;
+            case '\\': memcpy(_pending, "\\\\", 2); _pendingLen = 2; break;
+            case '\n': memcpy(_pending, "\\n", 2); _pendingLen = 2; break;
+            case '\r': memcpy(_pending, "\\r", 2); _pendingLen = 2; break;
+            case '\t': memcpy(_pending, "\\t", 2); _pendingLen = 2; break;
+            default:
+                snprintf(_pending, sizeof(_pending), "\\u%04x", c);
+                _pendingLen = 6;
+                break;
+        }
+        _pendingPos = 0;
+        _pos++;  // The source character is consumed by the pending sequence
+        return (unsigned char)_pending[0];
+    }
+
+    void flush() {}
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    struct Piece {
+        const char* data;
+        size_t length;
+        size_t encodedLength;
+        bool escape;
+    };
+
+    void addLiteral(const char* s) {
+        size_t len = strlen(s);
+        _pieces[_count++] = { s, len, len, false };
+    }
+
+    void addEscaped(const char* s) {
+        size_t len = strlen(s);
+        size_t encoded = 0;
+        for (size_t i = 0; i < len; i++) {
+            encoded += jsonEscapedCharLength((unsigned char)s[i]);
+        }
+        _pieces[_count++] = { s, len, encoded, true };
+    }
+
+    void advance() {
+        if (_remaining > 0) _remaining--;
+        if (_pendingPos < _pendingLen) {
+            if (++_pendingPos >= _pendingLen) {
+                _pendingLen = 0;
+                _pendingPos = 0;
+            }
+            return;
+        }
+        _pos++;
+    }
+
+    Piece _pieces[GRAPHQL_MAX_PIECES];
+    size_t _count;
+    size_t _index;
+    size_t _pos;
+    char _pending[7];
+    uint8_t _pendingLen;
+    uint8_t _pendingPos;
+    size_t _remaining;
+};
+
+bool makeGraphQLRequest(const GraphQLOperation& op, const GraphQLValue* values,
+                        String& responseData, const char* endpoint) {
     // Print memory info
     Serial.printf("Free heap before request: %d\n", ESP.getFreeHeap());
-    
+
+    GraphQLBodyStream body;
+    if (!body.build(op, values)) {
+        Serial.printf("GraphQL: invalid variables for %s\n", op.name);
+        return false;
+    }
+    body.rewind();
+
     HTTPClient http;
     http.setTimeout(10000);
-    
-    if (http.begin(sslClient, endpoint)) {
+
+    bool secure = strncmp(endpoint, "https://", 8) == 0;
+    WiFiClient& client = secure ? static_cast<WiFiClient&>(sslClient) : plainClient;
+
+    bool ok = false;
+    tlsBudgetBeginConnection();
+    if (http.begin(client, endpoint)) {
         http.addHeader("Content-Type", "application/json");
-        
-        // Construct JSON manually to avoid ArduinoJson memory overhead
-        String preparedQuery = prepareGraphQLQuery(query);
-        String requestBody = "{\"query\":\"" + preparedQuery + "\"}";
-        
-        Serial.println("Sending GraphQL request:");
-        Serial.println(requestBody);
-        
-        int httpResponseCode = http.POST(requestBody);
-        
+
+        Serial.printf("Sending GraphQL %s (%u bytes)\n", op.name, (unsigned)body.size());
+
+        int httpResponseCode = http.sendRequest("POST", &body, body.size());
+
         if (httpResponseCode == 200) {
             // Stream the response instead of loading it all at once
             WiFiClient* stream = http.getStreamPtr();
             responseData.reserve(512); // Pre-allocate space
-            
+
             while (stream->available()) {
                 responseData += (char)stream->read();
             }
-            
+
             Serial.println("Response received");
-            http.end();
-            return true;
+            ok = true;
         } else {
             Serial.printf("HTTP Error: %d\n", httpResponseCode);
         }
-        
+
         http.end();
     }
-    
-    Serial.printf("Free heap after request: %d\n", ESP.getFreeHeap());
-    return false;
+    // Every connection attempt is ended, or the budget's open count never
+    // returns to zero and its per-connection stats stop resetting
+    tlsBudgetEndConnection(op.name);
+
+    if (!ok) {
+        Serial.printf("Free heap after request: %d\n", ESP.getFreeHeap());
+    }
+    return ok;
 }
 
 String fetchGatewayName(const String& serialNumber) {
-    String query = R"({
-        gatewayConfiguration {
-          gatewayName(id:")" + serialNumber + R"(") {
-            name
-          }
-        }
-    })";
-    
+    GraphQLValue values[] = {
+        GraphQLValue::fromString(serialNumber.c_str()),
+    };
+
     String response;
     extern const char* API_URL;
-    if (makeGraphQLRequest(query, response, API_URL)) {
+    if (makeGraphQLRequest(GQL_GATEWAY_NAME, values, response, API_URL)) {
         // Parse JSON response manually to avoid ArduinoJson
         int dataPos = response.indexOf("\"data\":");
         if (dataPos >= 0) {
@@ -92,19 +286,12 @@ String fetchGatewayName(const String& serialNumber) {
 }
 
 bool initializeGateway(const String& idAndWallet, const String& signature, bool dryRun, String& responseData) {
-    String mutation = String(R"(
-      mutation {
-        gatewayInception {
-          initialize(gatewayInitialization:{)") + 
-          (dryRun ? "dryRun:true, " : "") +
-          "idAndWallet:\"" + idAndWallet + "\", " +
-          "signature:\"" + signature + "\"}) {" + R"(
-            initialized
-          }
-        }
-      }
-    )";
-    
+    GraphQLValue values[] = {
+        GraphQLValue::fromString(idAndWallet.c_str()),
+        GraphQLValue::fromString(signature.c_str()),
+        GraphQLValue::fromBool(dryRun),
+    };
+
     extern const char* API_URL;
-    return makeGraphQLRequest(mutation, responseData, API_URL);
-} 
\ No newline at end of file
+    return makeGraphQLRequest(GQL_INITIALIZE, values, responseData, API_URL);
+}
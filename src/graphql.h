@@ -8,5 +8,44 @@
 extern WiFiClientSecure sslClient;
 void initSSL();
 
+// Types a GraphQL operation variable can have
+enum class GraphQLVarType {
+    STRING,
+    BOOLEAN
+};
+
+struct GraphQLVariable {
+    const char* name;
+    GraphQLVarType type;
+};
+
+// Value bound to a variable when the operation is sent
+struct GraphQLValue {
+    GraphQLVarType type;
+    const char* str;
+    bool flag;
+
+    static GraphQLValue fromString(const char* value) { return { GraphQLVarType::STRING, value, false }; }
+    static GraphQLValue fromBool(bool value) { return { GraphQLVarType::BOOLEAN, nullptr, value }; }
+};
+
+// A GraphQL operation whose request body prefix is stored JSON-escaped in flash.
+// The body on the wire is: bodyPrefix, the variables as JSON members, "}}".
+struct GraphQLOperation {
+    const char* name;
+    const char* bodyPrefix;
+    const GraphQLVariable* variables;
+    size_t variableCount;
+};
+
+// Registered operations
+extern const GraphQLOperation GQL_GATEWAY_NAME;      // $id: String!
+extern const GraphQLOperation GQL_INITIALIZE;        // $idAndWallet: String!, $signature: String!, $dryRun: Boolean!
+
+// Send an operation; values must match op.variables in order and type.
+// The request body is streamed to the socket without building it in memory.
+bool makeGraphQLRequest(const GraphQLOperation& op, const GraphQLValue* values,
+                        String& responseData, const char* endpoint);
+
 String fetchGatewayName(const String& serialNumber);
-bool initializeGateway(const String& idAndWallet, const String& signature, bool dryRun, String& responseData); 
\ No newline at end of file
+bool initializeGateway(const String& idAndWallet, const String& signature, bool dryRun, String& responseData);
@@ -1,13 +0,0 @@
-#ifndef HTML_H
-#define HTML_H
-
-#include <WString.h>  // For __FlashStringHelper
-#include <pgmspace.h> // For PROGMEM
-
-// Declare the HTML strings
-extern const char WIFI_SETUP_HTML[] PROGMEM;
-extern const char JWT_CREATOR_HTML[] PROGMEM;
-extern const char SYSTEM_INFO_HTML[] PROGMEM;
-extern const char INITIALIZE_FORM_HTML[] PROGMEM;
-
-#endif 
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "job_table.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+struct Job {
+    uint32_t id;                     // 0 = free slot
+    const char* kind;
+    JobFunction function;
+    JobState state;
+    RequestTransport transport;
+    bool taken;                      // Returned by jobTakeFinished
+    unsigned long submittedAt;
+    unsigned long startedAt;
+    unsigned long finishedAt;
+    JobResult result;
+    size_t inputLength;
+    uint8_t input[JOB_INPUT_SIZE];
+};
+
+static Job jobs[JOB_TABLE_SIZE];
+static uint32_t nextId = 1;
+static portMUX_TYPE jobsMux = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t pending = nullptr;  // Slot indexes, in submission order
+
+static bool finished(const Job& job) {
+    return job.state == JobState::SUCCEEDED || job.state == JobState::FAILED;
+}
+
+// Call inside the critical section
+static bool expired(const Job& job, unsigned long now) {
+    return job.id == 0 || (finished(job) && now - job.finishedAt > JOB_RESULT_TTL_MS);
+}
+
+static void fillInfo(const Job& job, unsigned long now, JobInfo& info) {
+    info.id = job.id;
+    info.kind = job.kind;
+    info.state = job.state;
+    info.transport = job.transport;
+    info.ageMs = now - job.submittedAt;
+    info.runMs = job.state == JobState::QUEUED ? 0
+               : (finished(job) ? job.finishedAt : now) - job.startedAt;
+    info.result = job.result;
+}
+
+static Job* findJob(uint32_t id, unsigned long now) {
+    if (id == 0) {
+        return nullptr;
+    }
+    Job& job = jobs[(id - 1) % JOB_TABLE_SIZE];
+    return job.id == id && !expired(job, now) ? &job : nullptr;
+}
+
+static void workerLoop(void*) {
+    uint8_t slot;
+    uint8_t input[JOB_INPUT_SIZE];
+    for (;;) {
+        if (xQueueReceive(pending, &slot, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+
+        // Copy the job out so the table isn't locked while it runs
+        portENTER_CRITICAL(&jobsMux);
+        Job& job = jobs[slot];
+        uint32_t id = job.id;
+        JobFunction function = job.function;
+        size_t length = job.inputLength;
+        memcpy(input, job.input, length);
+        job.state = JobState::RUNNING;
+        job.startedAt = millis();
+        portEXIT_CRITICAL(&jobsMux);
+
+        JobResult result = { 500, "" };
+        function(input, length, result);
+
+        portENTER_CRITICAL(&jobsMux);
+        if (job.id == id) {
+            job.result = result;
+            job.state = result.status < 400 ? JobState::SUCCEEDED : JobState::FAILED;
+            job.finishedAt = millis();
+        }
+        portEXIT_CRITICAL(&jobsMux);
+        Serial.printf("Job %u (%s) finished: %d %s\n", id, job.kind, result.status, result.message);
+    }
+}
+
+void jobsInit() {
+    if (pending != nullptr) {
+        return;
+    }
+    pending = xQueueCreate(JOB_TABLE_SIZE, sizeof(uint8_t));
+    if (xTaskCreate(workerLoop, "jobs", JOB_TASK_STACK, nullptr, JOB_TASK_PRIORITY, nullptr) != pdPASS) {
+        Serial.println("Jobs: failed to start worker task");
+    }
+}
+
+uint32_t jobSubmit(const char* kind, JobFunction function, const void* input, size_t length,
+                   RequestTransport transport) {
+    if (pending == nullptr || length > JOB_INPUT_SIZE) {
+        return 0;
+    }
+
+    unsigned long now = millis();
+    uint32_t id = 0;
+    uint8_t slot = 0;
+    portENTER_CRITICAL(&jobsMux);
+    // Ids map to slots (id - 1) % size, so lookups are O(1); skip ids whose
+    // slot still holds a live job
+    for (size_t tries = 0; tries < JOB_TABLE_SIZE; tries++) {
+        uint32_t candidate = nextId++;
+        if (nextId == 0) {
+            nextId = 1;
+        }
+        Job& job = jobs[(candidate - 1) % JOB_TABLE_SIZE];
+        if (expired(job, now)) {
+            id = candidate;
+            slot = (candidate - 1) % JOB_TABLE_SIZE;
+            break;
+        }
+    }
+    if (id != 0) {
+        Job& job = jobs[slot];
+        job.id = id;
+        job.kind = kind;
+        job.function = function;
+        job.state = JobState::QUEUED;
+        job.transport = transport;
+        job.taken = false;
+        job.submittedAt = now;
+        job.startedAt = 0;
+        job.finishedAt = 0;
+        job.result.status = 0;
+        job.result.message[0] = '\0';
+        job.inputLength = length;
+        memcpy(job.input, input, length);
+    }
+    portEXIT_CRITICAL(&jobsMux);
+
+    if (id != 0 && xQueueSend(pending, &slot, 0) != pdPASS) {
+        // Can't happen while the queue is as long as the table
+        portENTER_CRITICAL(&jobsMux);
+        jobs[slot].id = 0;
+        portEXIT_CRITICAL(&jobsMux);
+        return 0;
+    }
+    return id;
+}
+
+bool jobGet(uint32_t id, JobInfo& info) {
+    unsigned long now = millis();
+    portENTER_CRITICAL(&jobsMux);
+    Job* job = findJob(id, now);
+    if (job != nullptr) {
+        fillInfo(*job, now, info);
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    return job != nullptr;
+}
+
+size_t jobList(uint32_t* ids, size_t max) {
+    unsigned long now = millis();
+    size_t count = 0;
+    portENTER_CRITICAL(&jobsMux);
+    for (size_t i = 0; i < JOB_TABLE_SIZE && count < max; i++) {
+        if (!expired(jobs[i], now)) {
+            ids[count++] = jobs[i].id;
+        }
+    }
+    portEXIT_CRITICAL(&jobsMux);
+
+    // Table order is slot order; sort by id (insertion sort, a handful of items)
+    for (size_t i = 1; i < count; i++) {
+        uint32_t id = ids[i];
+        size_t j = i;
+        while (j > 0 && ids[j - 1] > id) {
+            ids[j] = ids[j - 1];
+            j--;
+        }
+        ids[j] = id;
+    }
+    return count;
+}
+
+bool jobTakeFinished(RequestTransport transport, JobInfo& info) {
+    unsigned long now = millis();
+    bool found = false;
+    portENTER_CRITICAL(&jobsMux);
+    for (size_t i = 0; i < JOB_TABLE_SIZE; i++) {
+        Job& job = jobs[i];
+        if (!expired(job, now) && finished(job) && !job.taken && job.transport == transport) {
+            job.taken = true;
+            fillInfo(job, now, info);
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    return found;
+}
+
+const char* jobStateName(JobState state) {
+    switch (state) {
+        case JobState::QUEUED: return "queued";
+        case JobState::RUNNING: return "running";
+        case JobState::SUCCEEDED: return "succeeded";
+        case JobState::FAILED: return "failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include "endpoint_types.h"
+
+// Long-running endpoint actions (e.g. joining a WiFi network).
+// A handler submits a job and answers 202 with its id right away; a worker
+// task runs the jobs one at a time, in submission order, so neither
+// transport stalls. Finished jobs keep their result for JOB_RESULT_TTL_MS,
+// for clients polling /api/jobs/{id}, after which the slot is reused.
+
+#ifndef JOB_TABLE_SIZE
+#define JOB_TABLE_SIZE 8
+#endif
+
+#ifndef JOB_RESULT_TTL_MS
+#define JOB_RESULT_TTL_MS (5UL * 60UL * 1000UL)
+#endif
+
+#ifndef JOB_INPUT_SIZE
+#define JOB_INPUT_SIZE 128  // Argument bytes copied into a job at submit time
+#endif
+
+#ifndef JOB_MESSAGE_SIZE
+#define JOB_MESSAGE_SIZE 96
+#endif
+
+#ifndef JOB_TASK_STACK
+#define JOB_TASK_STACK 8192  // WiFi connect plus NTP setup
+#endif
+
+#ifndef JOB_TASK_PRIORITY
+#define JOB_TASK_PRIORITY 1
+#endif
+
+enum class JobState : uint8_t {
+    QUEUED,
+    RUNNING,
+    SUCCEEDED,
+    FAILED
+};
+
+struct JobResult {
+    int status;                      // HTTP-style, e.g. 200 or 500; >= 400 means failed
+    char message[JOB_MESSAGE_SIZE];
+};
+
+// Runs on the worker task without the route lock. `input` is the copy made
+// by jobSubmit. Set result.status and result.message.
+typedef void (*JobFunction)(const void* input, size_t length, JobResult& result);
+
+struct JobInfo {
+    uint32_t id;
+    const char* kind;                // Static name, e.g. "wifi_connect"
+    JobState state;
+    RequestTransport transport;      // Where the job was submitted
+    uint32_t ageMs;                  // Since submission
+    uint32_t runMs;                  // Running time, so far or in total
+    JobResult result;                // Valid once finished
+};
+
+// Create the worker task. Call once from setup().
+void jobsInit();
+
+// Queue a job with a copy of `input` (at most JOB_INPUT_SIZE bytes).
+// Returns the job id, or 0 if every slot holds a live job.
+uint32_t jobSubmit(const char* kind, JobFunction function, const void* input, size_t length,
+                   RequestTransport transport);
+
+// False if the id is unknown or its result has expired
+bool jobGet(uint32_t id, JobInfo& info);
+
+// Ids of the live jobs, oldest first. Returns the count.
+size_t jobList(uint32_t* ids, size_t max);
+
+// Next finished job submitted over `transport` that hasn't been taken yet.
+// Used to notify BLE clients; each job is returned once.
+bool jobTakeFinished(RequestTransport transport, JobInfo& info);
+
+const char* jobStateName(JobState state);
@@ -0,0 +1,192 @@
+#include "json_writer.h"
+#include <math.h>
+
+void JsonWriter::separator() {
+    if (_afterKey) {
+        _afterKey = false;
+        return;
+    }
+    if (_depth == 0) {
+        return;
+    }
+    uint32_t bit = 1u << (_depth - 1);
+    if (_hasItems & bit) {
+        raw(",", 1);
+    } else {
+        _hasItems |= bit;
+    }
+}
+
+void JsonWriter::open(char bracket) {
+    separator();
+    raw(&bracket, 1);
+    if (_depth < 32) {
+        _depth++;
+        _hasItems &= ~(1u << (_depth - 1));
+    }
+}
+
+void JsonWriter::close(char bracket) {
+    raw(&bracket, 1);
+    if (_depth > 0) {
+        _depth--;
+    }
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    open('{');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginObject(const char* name) {
+    key(name);
+    return beginObject();
+}
+
+JsonWriter& JsonWriter::endObject() {
+    close('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    open('[');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* name) {
+    key(name);
+    return beginArray();
+}
+
+JsonWriter& JsonWriter::endArray() {
+    close(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::resumeObject() {
+    if (_depth < 32) {
+        _depth++;
+        _hasItems |= 1u << (_depth - 1);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    separator();
+    raw("\"", 1);
+    writeEscaped(_sink, name, strlen(name));
+    raw("\":", 2);
+    _afterKey = true;
+    return *this;
+}
+
+void JsonWriter::writeEscaped(ResponseSink& sink, const char* text, size_t length) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // Flush the run of plain characters before the escape
+        if (i > start) {
+            sink.write(text + start, i - start);
+        }
+        start = i + 1;
+
+        switch (c) {
+            case '"': sink.write("\\\"", 2); break;
+            case '\\': sink.write("\\\\", 2); break;
+            case '\n': sink.write("\\n", 2); break;
+            case '\r': sink.write("\\r", 2); break;
+            case '\t': sink.write("\\t", 2); break;
+            default: {
+                char escape[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F] };
+                sink.write(escape, sizeof(escape));
+                break;
+            }
+        }
+    }
+    if (length > start) {
+        sink.write(text + start, length - start);
+    }
+}
+
+JsonWriter& JsonWriter::value(const char* text) {
+    if (text == nullptr) {
+        return value(nullptr);
+    }
+    separator();
+    raw("\"", 1);
+    writeEscaped(_sink, text, strlen(text));
+    raw("\"", 1);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const String& text) {
+    separator();
+    raw("\"", 1);
+    writeEscaped(_sink, text.c_str(), text.length());
+    raw("\"", 1);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separator();
+    if (flag) {
+        raw("true", 4);
+    } else {
+        raw("false", 5);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int number) {
+    return value((long long)number);
+}
+
+JsonWriter& JsonWriter::value(unsigned int number) {
+    return value((unsigned long long)number);
+}
+
+JsonWriter& JsonWriter::value(long number) {
+    return value((long long)number);
+}
+
+JsonWriter& JsonWriter::value(unsigned long number) {
+    return value((unsigned long long)number);
+}
+
+JsonWriter& JsonWriter::value(long long number) {
+    separator();
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", number);
+    raw(buffer, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned long long number) {
+    separator();
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%llu", number);
+    raw(buffer, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    if (isnan(number) || isinf(number)) {
+        return value(nullptr);
+    }
+    separator();
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.7g", number);
+    raw(buffer, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::nullptr_t) {
+    separator();
+    raw("null", 4);
+    return *this;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include "response_sink.h"
+
+// Streaming JSON writer that writes straight into a ResponseSink without
+// building a document in memory. Commas and key/value separators are
+// inserted automatically; nesting is limited to 32 levels.
+//
+//   JsonWriter json(response);
+//   json.beginObject();
+//   json.member("heap", ESP.getFreeHeap());
+//   json.beginArray("ssids");
+//   json.value(ssid);
+//   json.endArray();
+//   json.endObject();
+class JsonWriter {
+public:
+    explicit JsonWriter(ResponseSink& sink) : _sink(sink) {}
+
+    JsonWriter& beginObject();
+    JsonWriter& beginObject(const char* key);
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& beginArray(const char* key);
+    JsonWriter& endArray();
+
+    // Continue an object whose opening brace and first members were already
+    // written to the sink, e.g. a cached prefix
+    JsonWriter& resumeObject();
+
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(const char* text);  // nullptr is written as null
+    JsonWriter& value(const String& text);
+    JsonWriter& value(bool flag);
+    JsonWriter& value(int number);
+    JsonWriter& value(unsigned int number);
+    JsonWriter& value(long number);
+    JsonWriter& value(unsigned long number);
+    JsonWriter& value(long long number);
+    JsonWriter& value(unsigned long long number);
+    JsonWriter& value(double number);     // NaN and infinity are written as null
+    JsonWriter& value(std::nullptr_t);
+
+    template <typename T>
+    JsonWriter& member(const char* name, const T& v) {
+        key(name);
+        return value(v);
+    }
+
+    // Write the characters of a JSON string body with escaping, without quotes
+    static void writeEscaped(ResponseSink& sink, const char* text, size_t length);
+
+private:
+    void separator();
+    void open(char bracket);
+    void close(char bracket);
+    void raw(const char* text, size_t length) { _sink.write(text, length); }
+
+    ResponseSink& _sink;
+    uint32_t _hasItems = 0;   // Bit per nesting level: level already has an item
+    uint8_t _depth = 0;
+    bool _afterKey = false;
+};
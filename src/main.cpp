@@ -6,7 +6,7 @@
 #include <uECC.h>
 #include "mbedtls/md.h"
 #include <mbedtls/base64.h>
-#include "html.h"
+#include "web_assets.h"
 #include "crypto.h"
 #include <HTTPClient.h>
 #include <esp_system.h>
@@ -18,6 +18,18 @@
 #include <WiFiClientSecure.h>
 #include "esp_heap_caps.h"
 #include "graphql.h"
+#include "name_cache.h"
+#include "tls_budget.h"
+#include "wifi_manager.h"
+#include "wifi_scan.h"
+#include "time_sync.h"
+#include "response_cache.h"
+#include "metrics.h"
+#include "event_stream.h"
+#include "reading_history.h"
+#include "job_table.h"
+#include "esp_timer.h"
+#include <atomic>
 
 // Define LED pin - adjust based on your board
 #if defined(ARDUINO_HELTEC_WIFI_LORA_32) || defined(ARDUINO_HELTEC_WIFI_32)
@@ -30,8 +42,16 @@
 const char* AP_SSID = "ESP32_Setup_V2";  // Name of the WiFi network created by ESP32
 const char* AP_PASSWORD = "12345678";  // Password for the setup network
 const char* MDNS_NAME = "myesp32";     // mDNS name - device will be accessible as myesp32.local
-const char* API_URL = "https://api.srcful.dev/";
-const char* DATA_URL = "https://mainnet.srcful.dev/gw/data/";
+// Backend URLs can be overridden at build time, e.g. to point the device at a
+// local stand-in server: -DSRCFUL_API_URL=\"http://192.168.1.10:8080/\"
+#ifndef SRCFUL_API_URL
+#define SRCFUL_API_URL "https://api.srcful.dev/"
+#endif
+#ifndef SRCFUL_DATA_URL
+#define SRCFUL_DATA_URL "https://mainnet.srcful.dev/gw/data/"
+#endif
+const char* API_URL = SRCFUL_API_URL;
+const char* DATA_URL = SRCFUL_DATA_URL;
 
 // Cryptographic key configuration
 // This is a test private key - replace with your own secure key. In production keys are individial to each device and should be stored securely on the device.
@@ -44,16 +64,45 @@ const char* EXPECTED_PUBLIC_KEY_HEX = "3e70c4705ff5945bfea058aaa68128e6f7d54fd7e
 
 // Global variables
 WebServer server(80);
+#if defined(USE_ASYNC_HTTP_SERVER)
+    #include "async_http_server.h"
+    AsyncHttpServer asyncServer;
+#endif
 bool isProvisioned = false;
 String configuredSSID = "";
 String configuredPassword = "";
 unsigned long lastJWTTime = 0;
-const unsigned long JWT_INTERVAL = 10000; // 10 seconds in milliseconds
-std::vector<String> lastScanResults;
-unsigned long lastScanTime = 0;
-const unsigned long SCAN_CACHE_TIME = 10000; // Cache scan results for 10 seconds
+// Upload interval; shorten it to benchmark uploads (tools/upload_bench.py)
+#ifndef SRCFUL_UPLOAD_INTERVAL_MS
+#define SRCFUL_UPLOAD_INTERVAL_MS 10000
+#endif
+const unsigned long JWT_INTERVAL = SRCFUL_UPLOAD_INTERVAL_MS; // 10 seconds in milliseconds by default
 unsigned long bleShutdownTime = 0; // Time when BLE should be shut down (0 = no shutdown scheduled)
 
+// Upload statistics, logged after every upload
+struct UploadStats {
+    uint32_t attempts = 0;
+    uint32_t successes = 0;
+    uint32_t lastLatencyMs = 0;
+    uint32_t maxLatencyMs = 0;
+    uint64_t totalLatencyMs = 0;
+    uint64_t bytesSent = 0;
+};
+UploadStats uploadStats;
+
+// Readings taken on the provisional clock (restored from NVS at boot) wait
+// here until SNTP syncs, so the backend only sees corrected timestamps.
+// The oldest is dropped when it is full.
+#ifndef PROVISIONAL_UPLOAD_BACKLOG
+#define PROVISIONAL_UPLOAD_BACKLOG 30  // 5 minutes at the default interval
+#endif
+#ifndef PROVISIONAL_UPLOADS_PER_INTERVAL
+#define PROVISIONAL_UPLOADS_PER_INTERVAL 3  // Backlog readings sent with each new one
+#endif
+P1Values provisionalReadings[PROVISIONAL_UPLOAD_BACKLOG];
+size_t provisionalFirst = 0;
+size_t provisionalCount = 0;
+
 #if defined(USE_BLE_SETUP)
     #include "ble_handler.h"
     BLEHandler bleHandler(&server);
@@ -63,17 +112,22 @@ unsigned long bleShutdownTime = 0; // Time when BLE should be shut down (0 = no
 // Function declarations
 void setupAP();
 void setupEndpoints();
+void handleRoot(const EndpointRequest& request, ResponseSink& response);
 bool connectToWiFi(const String& ssid, const String& password, bool updateGlobals = true);
 void runSigningTest();
 String getId();
-void scanWiFiNetworks();
 void setupSSL();
 void sendJWT();  // Add JWT sending function declaration
+void uploadReading(const String& deviceId, const String& reading);
 
 // Add hardcoded WiFi credentials
 const char* WIFI_SSID = "may the source";
 const char* WIFI_PSK = "B3W1thY0u!";
 
+// Set by connectToWiFi, which may run on the job worker task; loop() starts
+// NTP so time sync is only driven from the loop task
+static std::atomic<bool> ntpStartPending{false};
+
 void setup() {
     Serial.begin(115200);
 
@@ -84,11 +138,34 @@ void setup() {
     
     // Initialize SSL early
     initSSL();
+
+    // Load the cached gateway name before any endpoint can ask for it
+    nameCacheInit();
+
+    // Reading history for /api/readings, in PSRAM when the board has it
+    if (readingHistory.begin(psramFound() ? READING_HISTORY_CAPACITY_PSRAM : READING_HISTORY_CAPACITY_INTERNAL)) {
+        Serial.printf("Reading history: %u records in %s\n", (unsigned)readingHistory.capacity(),
+                      readingHistory.inPsram() ? "PSRAM" : "internal RAM");
+    }
+
+    // Restore a provisional clock so early readings get usable timestamps
+    timeSyncInit();
     
     // Setup LED
     pinMode(LED_PIN, OUTPUT);
     digitalWrite(LED_PIN, HIGH);
     
+    // Start tracking WiFi events before the first connection attempt
+    wifiManager.begin();
+    
+    // Cached responses that include the connection state are rebuilt on change
+    WiFi.onEvent([](arduino_event_id_t event, arduino_event_info_t info) {
+        responseCacheInvalidate(CACHE_EVENT_WIFI);
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent([](arduino_event_id_t event, arduino_event_info_t info) {
+        responseCacheInvalidate(CACHE_EVENT_WIFI);
+    }, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    
     #if defined(DIRECT_CONNECT)
         // Connect to WiFi directly
         Serial.println("Connecting to WiFi...");
@@ -99,15 +176,20 @@ void setup() {
             Serial.println("WiFi connection failed");
             digitalWrite(LED_PIN, LOW);
         }
+        // Reconnects are driven by the WiFi manager from now on
+        wifiManager.setAutoReconnect(true);
     #endif
     
     // Setup SSL with optimized memory settings
     setupSSL();
     
-    // Perform initial WiFi scan
+    // Initial WiFi scan; results are collected in the background
     Serial.println("Starting WiFi scan...");
-    scanWiFiNetworks();
-    Serial.println("WiFi scan completed");
+    wifiScanInit();
+    wifiScanStart();
+    
+    // Worker for long-running endpoint actions (WiFi connects)
+    jobsInit();
     
     // Verify public key
     Serial.println("Verifying public key...");
@@ -156,11 +238,23 @@ void setup() {
         Serial.println("Error setting up MDNS responder!");
     }
     
-    Serial.println("Setting up HTTP endpoints...");
-    setupEndpoints();
-    Serial.println("Starting HTTP server...");
-    server.begin();
-    Serial.println("HTTP server started");
+    // Live readings for /api/stream subscribers
+    eventStreamInit();
+    
+    #if defined(USE_ASYNC_HTTP_SERVER)
+        // Runs on its own task, independent of loop() and the WiFi state
+        Serial.println("Starting async HTTP server...");
+        asyncServer.onRoot(handleRoot);
+        if (asyncServer.begin(80)) {
+            Serial.println("HTTP server started");
+        }
+    #else
+        Serial.println("Setting up HTTP endpoints...");
+        setupEndpoints();
+        Serial.println("Starting HTTP server...");
+        server.begin();
+        Serial.println("HTTP server started");
+    #endif
     Serial.println("Setup completed successfully!");
     Serial.print("Free heap after setup: ");
     Serial.println(ESP.getFreeHeap());
@@ -169,6 +263,14 @@ void setup() {
 void loop() {
     static unsigned long lastCheck = 0;
     static bool wasConnected = false;
+    static int64_t lastLoopStart = 0;
+    
+    // Time between loop() entries, i.e. the full iteration including everything run from it
+    int64_t loopStart = esp_timer_get_time();
+    if (lastLoopStart != 0) {
+        metricsRecordLoop((uint32_t)(loopStart - lastLoopStart));
+    }
+    lastLoopStart = loopStart;
     
     // Check WiFi status every 5 seconds
     if (millis() - lastCheck > 5000) {
@@ -179,16 +281,20 @@ void loop() {
                 Serial.print("IP address: ");
                 Serial.println(WiFi.localIP());
                 wasConnected = true;
+                nameCacheRefresh();
             }
 
-            // Send JWT if conditions are met
+            // Take a reading if conditions are met. Not before there is a
+            // time at all; readings on the provisional clock are uploaded
+            // once SNTP has corrected them (see sendJWT)
+            bool timeKnown = timeSyncState() != TimeSyncState::UNSYNCED;
             #if defined(USE_BLE_SETUP)
-            if (!isBleActive && (millis() - lastJWTTime >= JWT_INTERVAL)) {
+            if (!isBleActive && timeKnown && (millis() - lastJWTTime >= JWT_INTERVAL)) {
                 sendJWT();
                 lastJWTTime = millis();
             }
             #else
-            if (millis() - lastJWTTime >= JWT_INTERVAL) {
+            if (timeKnown && millis() - lastJWTTime >= JWT_INTERVAL) {
                 sendJWT();
                 lastJWTTime = millis();
             }
@@ -200,10 +306,8 @@ void loop() {
                 wasConnected = false;
             }
             #if defined(DIRECT_CONNECT)
-                // Only try to reconnect automatically in direct connect mode
+                // Reconnect attempts are made by wifiManager.loop()
                 digitalWrite(LED_PIN, millis() % 1000 < 500); // Blink LED when disconnected
-                WiFi.begin(WIFI_SSID, WIFI_PSK);
-                Serial.println("WiFi disconnected, attempting to reconnect...");
             #endif
         }
         
@@ -214,13 +318,17 @@ void loop() {
         Serial.println(WiFi.status());
     }
 
+    // Drive WiFi connects and reconnects and persist the fast-reconnect cache
+    wifiManager.loop();
+    if (ntpStartPending.exchange(false)) {
+        Serial.println("Initializing NTP...");
+        initNTP();
+    }
+    timeSyncLoop();
+
     // handle ble tasks
     #if defined(USE_BLE_SETUP)
-        static unsigned long lastBLECheck = 0;
-        if (millis() - lastBLECheck > 1000) {
-            lastBLECheck = millis();
-            bleHandler.handlePendingRequest();
-        }
+        // Requests are served by the BLE handler's own task
         if (bleShutdownTime > 0 && millis() >= bleShutdownTime) {
             Serial.println("Executing scheduled BLE shutdown");
             bleHandler.stop();
@@ -232,12 +340,63 @@ void loop() {
     // Handle incoming client requests if we're connected
     if (WiFi.status() == WL_CONNECTED) {
         digitalWrite(LED_PIN, HIGH); // Solid LED when connected
-        server.handleClient();
+        #if !defined(USE_ASYNC_HTTP_SERVER)
+            server.handleClient();
+        #endif
     }
     
     yield();
 }
 
+// Serves "/" for either HTTP server: the setup page until provisioned,
+// then a redirect to the system info
+void handleRoot(const EndpointRequest& request, ResponseSink& response) {
+    Serial.println("Handling root request");
+    if (!isProvisioned) {
+        #if defined(USE_SOFTAP_SETUP)
+            // Rescan in the background if the results are stale; the page
+            // picks them up from /api/wifi
+            wifiScanRefresh();
+
+            // The page is a fixed gzip blob in flash and loads the network
+            // list from /api/wifi itself, so nothing is built on the heap here
+            uint32_t heapBefore = ESP.getFreeHeap();
+            int64_t start = esp_timer_get_time();
+            serveWebAsset(request, response, WEB_ASSET_WIFI_SETUP);
+            Serial.printf("Setup page: %u us to first byte, free heap %u -> %u\n",
+                          (unsigned)(esp_timer_get_time() - start), heapBefore, ESP.getFreeHeap());
+        #elif defined(USE_BLE_SETUP)
+            // BLE setup page
+            response.send(200, "text/html", "Please use BLE to configure device");
+        #endif
+    } else {
+        // If already provisioned, redirect to system info
+        response.addHeader("Location", "/api/system/info");
+        response.begin(302, "text/plain", 0);
+    }
+}
+
+// WebServer has already split the query string into arguments; rebuild it
+// for the handlers, which parse EndpointRequest::query on every transport
+static String queryString() {
+    String query;
+    for (int i = 0; i < server.args(); i++) {
+        if (server.argName(i) == "plain") {
+            continue;  // The POST body
+        }
+        if (query.length() > 0) {
+            query += '&';
+        }
+        query += server.argName(i) + "=" + server.arg(i);
+    }
+    return query;
+}
+
+// Rate limiting key of the current WebServer client
+static uint32_t clientAddress() {
+    return (uint32_t)server.client().remoteIP();
+}
+
 void setupEndpoints() {
     Serial.println("Setting up endpoints...");
 
@@ -248,138 +407,64 @@ void setupEndpoints() {
     // Handle root path separately as it serves HTML
     Serial.println("Registering root (/) endpoint...");
     server.on("/", HTTP_GET, []() {
-        Serial.println("Handling root request");
-        if (!isProvisioned) {
-            #if defined(USE_SOFTAP_SETUP)
-                // Check if we need a fresh scan
-                if (millis() - lastScanTime >= SCAN_CACHE_TIME) {
-                    scanWiFiNetworks();
-                }
-                
-                // Create the network options HTML
-                String networkOptions = "";
-                for (const String& ssid : lastScanResults) {
-                    networkOptions += "          <option value=\"" + ssid + "\">" + ssid + "</option>\n";
-                }
-                
-                String html = String(WIFI_SETUP_HTML);
-                html.replace("MDNS_NAME", MDNS_NAME);
-                html.replace("NETWORK_OPTIONS", networkOptions);
-                server.send(200, "text/html", html);
-            #elif defined(USE_BLE_SETUP)
-                // BLE setup page
-                server.send(200, "text/html", "Please use BLE to configure device");
-            #endif
-        } else {
-            // If already provisioned, redirect to system info
-            server.sendHeader("Location", "/api/system/info", true);
-            server.send(302, "text/plain", "");
-        }
-    });
-
-    // Handle API endpoints using the endpoint mapper
-    server.on("/api/wifi", HTTP_POST, []() {
-        Serial.println("Handling POST /api/wifi request");
-        EndpointRequest request;
-        request.method = HttpMethod::POST;
-        request.endpoint = Endpoint::WIFI_CONFIG;
-        request.content = server.arg("plain");
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/system/info", HTTP_GET, []() {
-        EndpointRequest request;
-        request.method = HttpMethod::GET;
-        request.endpoint = Endpoint::SYSTEM_INFO;
-        request.content = "";
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/wifi/reset", HTTP_POST, []() {
-        EndpointRequest request;
-        request.method = HttpMethod::POST;
-        request.endpoint = Endpoint::WIFI_RESET;
-        request.content = "";
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/crypto", HTTP_GET, []() {
-        Serial.println("Handling GET /api/crypto request");
         EndpointRequest request;
         request.method = HttpMethod::GET;
-        request.endpoint = Endpoint::CRYPTO_INFO;
-        request.content = "";
+        request.endpoint = Endpoint::UNKNOWN;
         request.offset = 0;
+        request.ifNoneMatch = server.header("If-None-Match");
 
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
+        HttpResponseSink response(server);
+        handleRoot(request, response);
+        response.end();
     });
 
-    server.on("/api/name", HTTP_GET, []() {
-        EndpointRequest request;
-        request.method = HttpMethod::GET;
-        request.endpoint = Endpoint::NAME_INFO;
-        request.content = "";
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/wifi", HTTP_GET, []() {
-        EndpointRequest request;
-        request.method = HttpMethod::GET;
-        request.endpoint = Endpoint::WIFI_STATUS;
-        request.content = "";
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/wifi/scan", HTTP_GET, []() {
-        EndpointRequest request;
-        request.method = HttpMethod::GET;
-        request.endpoint = Endpoint::WIFI_SCAN;
-        request.content = "";
-        request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
-
-    server.on("/api/ble/stop", HTTP_POST, []() {
-        Serial.println("Handling POST /api/ble/stop request");
-        EndpointRequest request;
-        request.method = HttpMethod::POST;
-        request.endpoint = Endpoint::BLE_STOP;
-        request.content = "";
-        request.offset = 0;
+    // Register every HTTP route from the endpoint table
+    for (size_t i = 0; i < EndpointMapper::routeCount(); i++) {
+        const Route* route = &EndpointMapper::routes()[i];
+        if (!(route->flags & ROUTE_HTTP)) {
+            continue;
+        }
+        server.on(route->path, route->method == HttpMethod::POST ? HTTP_POST : HTTP_GET, [route]() {
+            EndpointRequest request;
+            request.method = route->method;
+            request.endpoint = route->endpoint;
+            request.content = route->method == HttpMethod::POST ? server.arg("plain") : "";
+            request.offset = 0;
+            request.ifNoneMatch = server.header("If-None-Match");
+            request.query = queryString();
+            request.client = clientAddress();
+
+            HttpResponseSink response(server);
+            EndpointMapper::route(request, response);
+            response.end();
+        });
+    }
+    EndpointMapper::printPaths();
 
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
-    });
+    // WebServer only keeps request headers it is told about
+    static const char* collectedHeaders[] = { "If-None-Match" };
+    server.collectHeaders(collectedHeaders, 1);
 
     // Handle not found
+    // Also serves paths below ROUTE_PREFIX routes (e.g. /api/jobs/7), which
+    // WebServer can't match by prefix
     server.onNotFound([]() {
-        Serial.println("404 - Not found: " + server.uri());
         EndpointRequest request;
         request.method = server.method() == HTTP_GET ? HttpMethod::GET : HttpMethod::POST;
-        request.endpoint = EndpointMapper::pathToEndpoint(server.uri());
+        request.endpoint = EndpointMapper::pathToEndpoint(server.uri(), request.method);
+        if (request.endpoint == Endpoint::UNKNOWN) {
+            Serial.println("404 - Not found: " + server.uri());
+        }
         request.content = server.arg("plain");
         request.offset = 0;
-
-        EndpointResponse response = EndpointMapper::route(request);
-        server.send(response.statusCode, response.contentType, response.data);
+        request.ifNoneMatch = server.header("If-None-Match");
+        request.query = queryString();
+        request.pathParam = EndpointMapper::pathParam(server.uri());
+        request.client = clientAddress();
+
+        HttpResponseSink response(server);
+        EndpointMapper::route(request, response);
+        response.end();
     });
 }
 
@@ -400,50 +485,34 @@ bool connectToWiFi(const String& ssid, const String& password, bool updateGlobal
         Serial.print("Password length: ");
         Serial.println(password.length());
         
-        // First disconnect and wait a bit
-        WiFi.disconnect(true);  // true = disconnect and clear settings
-        delay(1000);  // Give it time to complete
-        
-        // Set mode and wait
-        WiFi.mode(WIFI_STA);
-        delay(100);
-        
-        // Start connection
-        WiFi.begin(ssid.c_str(), password.c_str());
-        
-        // Wait for connection with longer timeout
-        int attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 30) {  // Increased timeout to 15 seconds
-            delay(500);
-            Serial.print(".");
-            attempts++;
-        }
-        Serial.println();
-        
-        if (WiFi.status() == WL_CONNECTED) {
+        // Waits on WiFi events; uses the cached BSSID/channel when available
+        if (wifiManager.connect(ssid, password, WIFI_CONNECT_TIMEOUT_MS)) {
             Serial.println("WiFi connected");
             Serial.print("IP address: ");
             Serial.println(WiFi.localIP());
             
-            // Initialize NTP time synchronization
-            Serial.println("Initializing NTP...");
-            initNTP();
-            Serial.println("NTP initialized");
+            // NTP time synchronization is started by loop()
+            ntpStartPending = true;
             
             // Configure low power WiFi
             WiFi.setSleep(true);  // Enable modem sleep
             
-            // Update global variables if requested
+            // Keep this network up if the link drops later
+            wifiManager.setAutoReconnect(true);
+            
+            // Update global variables if requested. This may run on the job
+            // worker task, so take the route lock that handlers read them under.
             if (updateGlobals) {
+                RouteLock lock;
                 configuredSSID = ssid;
                 configuredPassword = password;
                 isProvisioned = true;
+                responseCacheInvalidate(CACHE_EVENT_PROVISIONING);
             }
             
             return true;
         } else {
             Serial.println("WiFi connection failed");
-            WiFi.disconnect(true);  // Clean disconnect on failure
             return false;
         }
     } else {
@@ -512,49 +581,6 @@ String getId() {
   return id;
 }
 
-void scanWiFiNetworks() {
-  Serial.println("Scanning WiFi networks...");
-  
-  // Set WiFi to station mode to perform scan
-  WiFi.mode(WIFI_STA);
-  
-  int n = WiFi.scanNetworks();
-  Serial.println("Scan completed");
-  
-  lastScanResults.clear();
-  
-  if (n == 0) {
-    Serial.println("No networks found");
-  } else {
-    Serial.print(n);
-    Serial.println(" networks found");
-    
-    // Store unique SSIDs (some networks might broadcast on multiple channels)
-    std::vector<String> uniqueSSIDs;
-    for (int i = 0; i < n; ++i) {
-      String ssid = WiFi.SSID(i);
-      if (std::find(uniqueSSIDs.begin(), uniqueSSIDs.end(), ssid) == uniqueSSIDs.end()) {
-        uniqueSSIDs.push_back(ssid);
-      }
-    }
-    
-    // Sort alphabetically
-    std::sort(uniqueSSIDs.begin(), uniqueSSIDs.end());
-    
-    // Store in global vector
-    lastScanResults = uniqueSSIDs;
-  }
-  
-  lastScanTime = millis();
-  
-  // Return to original mode if we were in AP mode
-  if (isProvisioned) {
-    WiFi.mode(WIFI_STA);
-  } else {
-    setupAP();
-  }
-}
-
 void setupSSL() {
     // Nothing needed here - HTTPClient handles SSL internally
 }
@@ -563,8 +589,57 @@ void setupSSL() {
 void sendJWT() {
     String deviceId = getId();
     
+    // Capture the reading once; it is kept for /api/readings and local
+    // subscribers get it before the upload starts
+    P1Values values = captureP1Values();
+    bool provisional = values.timeState != TimeSyncState::SYNCED;
+    if (!provisional) {
+        // First reading since the sync: move the provisional ones in the
+        // history onto SNTP time before appending after them
+        size_t corrected = readingHistory.correctProvisional(timeSyncStatus().correctionMs / 1000);
+        if (corrected > 0) {
+            Serial.printf("Corrected the times of %u provisional readings\n", (unsigned)corrected);
+        }
+    }
+    ReadingRecord record;
+    record.time = (uint32_t)(values.timestampMs / 1000);
+    record.importKwh = values.importKwh;
+    record.powerKw = values.powerKw;
+    memcpy(record.phasePowerKw, values.phasePowerKw, sizeof(record.phasePowerKw));
+    memcpy(record.voltage, values.voltage, sizeof(record.voltage));
+    memcpy(record.current, values.current, sizeof(record.current));
+    readingHistory.append(record, provisional);
+
+    String reading = createP1Reading(values);
+    eventStreamPublish("reading", reading.c_str(), reading.length());
+
+    if (provisional) {
+        if (provisionalCount == PROVISIONAL_UPLOAD_BACKLOG) {
+            provisionalFirst = (provisionalFirst + 1) % PROVISIONAL_UPLOAD_BACKLOG;
+            provisionalCount--;
+        }
+        provisionalReadings[(provisionalFirst + provisionalCount) % PROVISIONAL_UPLOAD_BACKLOG] = values;
+        provisionalCount++;
+        Serial.printf("Provisional time; reading held for upload after SNTP sync (%u held)\n",
+                      (unsigned)provisionalCount);
+        return;
+    }
+    uploadReading(deviceId, reading);
+
+    // Catch up on readings held while the time was provisional
+    for (int i = 0; i < PROVISIONAL_UPLOADS_PER_INTERVAL && provisionalCount > 0; i++) {
+        P1Values held = provisionalReadings[provisionalFirst];
+        provisionalFirst = (provisionalFirst + 1) % PROVISIONAL_UPLOAD_BACKLOG;
+        provisionalCount--;
+        held.timestampMs = timeSyncCorrect(held.timestampMs, held.timeState);
+        held.timeState = TimeSyncState::SYNCED;
+        uploadReading(deviceId, createP1Reading(held));
+    }
+}
+
+void uploadReading(const String& deviceId, const String& reading) {
     // Create JWT using P1 data
-    String jwt = createP1JWT(PRIVATE_KEY_HEX, deviceId);
+    String jwt = createP1JWT(PRIVATE_KEY_HEX, deviceId, reading);
     if (jwt.length() > 0) {
         Serial.println("P1 JWT created successfully");
         Serial.println("JWT: " + jwt);  // Add JWT logging
@@ -577,6 +652,11 @@ void sendJWT() {
         Serial.println(DATA_URL);
         
         // Start the request
+        unsigned long startTime = millis();
+        int64_t startUs = esp_timer_get_time();
+        bool uploaded = false;
+        uploadStats.attempts++;
+        tlsBudgetBeginConnection();
         if (http.begin(DATA_URL)) {
             // Add headers
             http.addHeader("Content-Type", "text/plain");
@@ -584,6 +664,12 @@ void sendJWT() {
             // Send POST request with JWT as body
             int httpResponseCode = http.POST(jwt);
             
+            if (httpResponseCode >= 200 && httpResponseCode < 300) {
+                uploadStats.successes++;
+                uploadStats.bytesSent += jwt.length();
+                uploaded = true;
+            }
+            
             if (httpResponseCode > 0) {
                 Serial.print("HTTP Response code: ");
                 Serial.println(httpResponseCode);
@@ -599,6 +685,20 @@ void sendJWT() {
         } else {
             Serial.println("Failed to connect to server");
         }
+        tlsBudgetEndConnection("upload");
+        
+        uint32_t latency = millis() - startTime;
+        metricsRecordUpload(uploaded, (uint32_t)(esp_timer_get_time() - startUs));
+        uploadStats.lastLatencyMs = latency;
+        uploadStats.totalLatencyMs += latency;
+        if (latency > uploadStats.maxLatencyMs) {
+            uploadStats.maxLatencyMs = latency;
+        }
+        Serial.printf("Upload stats: %u/%u ok, latency %u ms (avg %u, max %u), %u bytes per reading\n",
+                      uploadStats.successes, uploadStats.attempts, latency,
+                      (uint32_t)(uploadStats.totalLatencyMs / uploadStats.attempts),
+                      uploadStats.maxLatencyMs,
+                      uploadStats.successes ? (uint32_t)(uploadStats.bytesSent / uploadStats.successes) : 0);
     } else {
         Serial.println("Failed to create P1 JWT");
     }
@@ -0,0 +1,494 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include "esp_heap_caps.h"
+#include "endpoint_mapper.h"
+#include "json_writer.h"
+#include "event_stream.h"
+#include "request_arena.h"
+#include "rate_limit.h"
+
+static constexpr size_t ENDPOINT_SLOTS = (size_t)Endpoint::UNKNOWN + 1;  // Last slot: unknown paths
+static constexpr size_t TRANSPORT_COUNT = (size_t)RequestTransport::COUNT;
+
+struct EndpointMetrics {
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> errors{0};  // Status >= 400
+    std::atomic<uint32_t> arenaPeak{0};  // Largest request arena use, bytes
+    LatencyHistogram latency;
+};
+
+static EndpointMetrics endpointMetrics[ENDPOINT_SLOTS][TRANSPORT_COUNT];
+
+static std::atomic<uint32_t> uploadAttempts{0};
+static std::atomic<uint32_t> uploadFailures{0};
+static LatencyHistogram uploadLatency;
+
+static LatencyHistogram loopLatency;
+static std::atomic<uint32_t> loopMaxUs{0};
+
+// Streamed BLE transfers, per negotiated MTU (clients usually settle on one
+// or two values). Only the BLE task records, so a slot's MTU is claimed
+// without contention; readers may see a slot mid-update, which is fine
+// for counters.
+static constexpr size_t BLE_STREAM_MTU_SLOTS = 4;
+
+struct BleStreamMetrics {
+    std::atomic<uint32_t> mtu{0};     // 0 = unused slot
+    std::atomic<uint32_t> transfers{0};
+    std::atomic<uint32_t> bytes{0};
+    std::atomic<uint32_t> durationUs{0};  // Wraps after ~71 min of total transfer time
+};
+
+static BleStreamMetrics bleStreamMetrics[BLE_STREAM_MTU_SLOTS];
+static std::atomic<uint32_t> bleStreamAborted{0};
+
+static LatencyHistogram bleRequestLatency;
+static std::atomic<uint32_t> bleSlotsExhausted{0};
+static std::atomic<uint32_t> bleReassembled{0};
+static std::atomic<uint32_t> bleReassemblyDropped{0};
+
+static const char* TRANSPORT_NAMES[TRANSPORT_COUNT] = { "http", "ble" };
+
+// --- LatencyHistogram ---
+
+void LatencyHistogram::record(uint32_t micros) {
+    // Bucket 0 holds <= 250 us, each following bucket doubles the bound
+    size_t index = 0;
+    uint32_t scaled = (micros + 249) / 250;
+    if (scaled > 1) {
+        index = 32 - __builtin_clz(scaled - 1);
+    }
+    if (index >= BUCKET_COUNT) {
+        index = BUCKET_COUNT - 1;
+    }
+    _buckets[index].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sumMs.fetch_add((micros + 500) / 1000, std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::bucketBound(size_t bucket) {
+    return bucket + 1 < BUCKET_COUNT ? 250u << bucket : 0;
+}
+
+// --- Recording ---
+
+static void atomicMax(std::atomic<uint32_t>& target, uint32_t value) {
+    uint32_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void metricsRecordRequest(Endpoint endpoint, RequestTransport transport, int statusCode, uint32_t latencyUs,
+                          uint32_t arenaBytes) {
+    size_t slot = (size_t)endpoint < ENDPOINT_SLOTS ? (size_t)endpoint : ENDPOINT_SLOTS - 1;
+    EndpointMetrics& metrics = endpointMetrics[slot][(size_t)transport];
+    metrics.requests.fetch_add(1, std::memory_order_relaxed);
+    if (statusCode >= 400) {
+        metrics.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    metrics.latency.record(latencyUs);
+    atomicMax(metrics.arenaPeak, arenaBytes);
+}
+
+void metricsRecordUpload(bool success, uint32_t latencyUs) {
+    uploadAttempts.fetch_add(1, std::memory_order_relaxed);
+    if (!success) {
+        uploadFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+    uploadLatency.record(latencyUs);
+}
+
+void metricsRecordLoop(uint32_t iterationUs) {
+    loopLatency.record(iterationUs);
+    atomicMax(loopMaxUs, iterationUs);
+}
+
+void metricsRecordBleStream(uint16_t mtu, uint32_t bytes, uint32_t durationUs, bool completed) {
+    if (!completed) {
+        bleStreamAborted.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    for (BleStreamMetrics& slot : bleStreamMetrics) {
+        uint32_t slotMtu = slot.mtu.load(std::memory_order_relaxed);
+        if (slotMtu == 0) {
+            slot.mtu.store(mtu, std::memory_order_relaxed);
+        } else if (slotMtu != mtu) {
+            continue;
+        }
+        slot.transfers.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        slot.durationUs.fetch_add(durationUs, std::memory_order_relaxed);
+        return;
+    }
+}
+
+void metricsRecordBleRequest(uint32_t latencyUs) {
+    bleRequestLatency.record(latencyUs);
+}
+
+void metricsRecordBleSlotsExhausted() {
+    bleSlotsExhausted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metricsRecordBleReassembled() {
+    bleReassembled.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metricsRecordBleReassemblyDropped() {
+    bleReassemblyDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Average throughput of a slot's transfers
+static uint32_t bleStreamBytesPerSecond(const BleStreamMetrics& slot) {
+    uint32_t durationUs = slot.durationUs.load(std::memory_order_relaxed);
+    if (durationUs == 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)slot.bytes.load(std::memory_order_relaxed) * 1000000 / durationUs);
+}
+
+// --- Endpoint labels ---
+
+// Path and method of an endpoint slot for labels
+static void endpointLabels(size_t slot, const char*& path, const char*& method) {
+    path = "unknown";
+    method = "";
+    for (size_t i = 0; i < EndpointMapper::routeCount(); i++) {
+        const Route& route = EndpointMapper::routes()[i];
+        if ((size_t)route.endpoint == slot) {
+            path = route.path;
+            method = route.method == HttpMethod::POST ? "POST" : "GET";
+            return;
+        }
+    }
+}
+
+// --- Prometheus ---
+
+static void writeLine(ResponseSink& response, const char* format, ...) {
+    char line[192];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        response.write(line, (size_t)length < sizeof(line) ? length : sizeof(line) - 1);
+    }
+}
+
+static void writeHistogram(ResponseSink& response, const char* name, const char* labels,
+                           const LatencyHistogram& histogram) {
+    const char* separator = labels[0] != '\0' ? "," : "";
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        cumulative += histogram.bucket(i);
+        uint32_t bound = LatencyHistogram::bucketBound(i);
+        if (bound != 0) {
+            writeLine(response, "%s_bucket{%s%sle=\"%u.%06u\"} %u\n", name, labels, separator,
+                      bound / 1000000, bound % 1000000, cumulative);
+        } else {
+            writeLine(response, "%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, separator, cumulative);
+        }
+    }
+    const char* open = labels[0] != '\0' ? "{" : "";
+    const char* close = labels[0] != '\0' ? "}" : "";
+    uint32_t sumMs = histogram.sumMs();
+    writeLine(response, "%s_sum%s%s%s %u.%03u\n", name, open, labels, close, sumMs / 1000, sumMs % 1000);
+    writeLine(response, "%s_count%s%s%s %u\n", name, open, labels, close, histogram.count());
+}
+
+void metricsWritePrometheus(ResponseSink& response) {
+    response.begin(200, "text/plain; version=0.0.4");
+
+    char labels[96];
+
+    response.write("# TYPE zap_requests_total counter\n");
+    for (size_t slot = 0; slot < ENDPOINT_SLOTS; slot++) {
+        for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+            const EndpointMetrics& metrics = endpointMetrics[slot][t];
+            uint32_t requests = metrics.requests.load(std::memory_order_relaxed);
+            if (requests == 0) {
+                continue;
+            }
+            const char* path;
+            const char* method;
+            endpointLabels(slot, path, method);
+            writeLine(response, "zap_requests_total{path=\"%s\",method=\"%s\",transport=\"%s\"} %u\n",
+                      path, method, TRANSPORT_NAMES[t], requests);
+        }
+    }
+
+    response.write("# TYPE zap_request_errors_total counter\n");
+    for (size_t slot = 0; slot < ENDPOINT_SLOTS; slot++) {
+        for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+            const EndpointMetrics& metrics = endpointMetrics[slot][t];
+            if (metrics.requests.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            const char* path;
+            const char* method;
+            endpointLabels(slot, path, method);
+            writeLine(response, "zap_request_errors_total{path=\"%s\",method=\"%s\",transport=\"%s\"} %u\n",
+                      path, method, TRANSPORT_NAMES[t], metrics.errors.load(std::memory_order_relaxed));
+        }
+    }
+
+    response.write("# TYPE zap_request_duration_seconds histogram\n");
+    for (size_t slot = 0; slot < ENDPOINT_SLOTS; slot++) {
+        for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+            const EndpointMetrics& metrics = endpointMetrics[slot][t];
+            if (metrics.requests.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            const char* path;
+            const char* method;
+            endpointLabels(slot, path, method);
+            snprintf(labels, sizeof(labels), "path=\"%s\",method=\"%s\",transport=\"%s\"",
+                     path, method, TRANSPORT_NAMES[t]);
+            writeHistogram(response, "zap_request_duration_seconds", labels, metrics.latency);
+        }
+    }
+
+    response.write("# TYPE zap_request_arena_peak_bytes gauge\n");
+    for (size_t slot = 0; slot < ENDPOINT_SLOTS; slot++) {
+        for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+            const EndpointMetrics& metrics = endpointMetrics[slot][t];
+            if (metrics.requests.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            const char* path;
+            const char* method;
+            endpointLabels(slot, path, method);
+            writeLine(response, "zap_request_arena_peak_bytes{path=\"%s\",method=\"%s\",transport=\"%s\"} %u\n",
+                      path, method, TRANSPORT_NAMES[t], metrics.arenaPeak.load(std::memory_order_relaxed));
+        }
+    }
+    response.write("# TYPE zap_request_arena_size_bytes gauge\n");
+    writeLine(response, "zap_request_arena_size_bytes %u\n", (unsigned)REQUEST_ARENA_SIZE);
+    response.write("# TYPE zap_request_arena_failures_total counter\n");
+    writeLine(response, "zap_request_arena_failures_total %u\n", requestArena.failures());
+
+    RateLimitStats limits = rateLimitStats();
+    response.write("# TYPE zap_ratelimit_admitted_total counter\n");
+    for (size_t c = 0; c < (size_t)CostClass::COUNT; c++) {
+        writeLine(response, "zap_ratelimit_admitted_total{class=\"%s\"} %u\n",
+                  costClassName((CostClass)c), limits.admitted[c]);
+    }
+    response.write("# TYPE zap_ratelimit_limited_total counter\n");
+    for (size_t c = 0; c < (size_t)CostClass::COUNT; c++) {
+        writeLine(response, "zap_ratelimit_limited_total{class=\"%s\"} %u\n",
+                  costClassName((CostClass)c), limits.limited[c]);
+    }
+    response.write("# TYPE zap_ratelimit_shed_total counter\n");
+    writeLine(response, "zap_ratelimit_shed_total %u\n", limits.shed);
+    response.write("# TYPE zap_ratelimit_clients gauge\n");
+    writeLine(response, "zap_ratelimit_clients %u\n", limits.clients);
+    response.write("# TYPE zap_ratelimit_evictions_total counter\n");
+    writeLine(response, "zap_ratelimit_evictions_total %u\n", limits.evictions);
+
+    response.write("# TYPE zap_upload_attempts_total counter\n");
+    writeLine(response, "zap_upload_attempts_total %u\n", uploadAttempts.load(std::memory_order_relaxed));
+    response.write("# TYPE zap_upload_failures_total counter\n");
+    writeLine(response, "zap_upload_failures_total %u\n", uploadFailures.load(std::memory_order_relaxed));
+    response.write("# TYPE zap_upload_duration_seconds histogram\n");
+    writeHistogram(response, "zap_upload_duration_seconds", "", uploadLatency);
+
+    response.write("# TYPE zap_loop_duration_seconds histogram\n");
+    writeHistogram(response, "zap_loop_duration_seconds", "", loopLatency);
+    response.write("# TYPE zap_loop_max_seconds gauge\n");
+    uint32_t loopMax = loopMaxUs.load(std::memory_order_relaxed);
+    writeLine(response, "zap_loop_max_seconds %u.%06u\n", loopMax / 1000000, loopMax % 1000000);
+
+    response.write("# TYPE zap_ble_request_duration_seconds histogram\n");
+    writeHistogram(response, "zap_ble_request_duration_seconds", "", bleRequestLatency);
+    response.write("# TYPE zap_ble_request_slots_exhausted_total counter\n");
+    writeLine(response, "zap_ble_request_slots_exhausted_total %u\n",
+              bleSlotsExhausted.load(std::memory_order_relaxed));
+    response.write("# TYPE zap_ble_requests_reassembled_total counter\n");
+    writeLine(response, "zap_ble_requests_reassembled_total %u\n", bleReassembled.load(std::memory_order_relaxed));
+    response.write("# TYPE zap_ble_reassembly_dropped_total counter\n");
+    writeLine(response, "zap_ble_reassembly_dropped_total %u\n",
+              bleReassemblyDropped.load(std::memory_order_relaxed));
+
+    response.write("# TYPE zap_ble_stream_transfers_total counter\n");
+    for (const BleStreamMetrics& slot : bleStreamMetrics) {
+        uint32_t mtu = slot.mtu.load(std::memory_order_relaxed);
+        if (mtu != 0) {
+            writeLine(response, "zap_ble_stream_transfers_total{mtu=\"%u\"} %u\n", mtu,
+                      slot.transfers.load(std::memory_order_relaxed));
+        }
+    }
+    response.write("# TYPE zap_ble_stream_bytes_total counter\n");
+    for (const BleStreamMetrics& slot : bleStreamMetrics) {
+        uint32_t mtu = slot.mtu.load(std::memory_order_relaxed);
+        if (mtu != 0) {
+            writeLine(response, "zap_ble_stream_bytes_total{mtu=\"%u\"} %u\n", mtu,
+                      slot.bytes.load(std::memory_order_relaxed));
+        }
+    }
+    response.write("# TYPE zap_ble_stream_seconds_total counter\n");
+    for (const BleStreamMetrics& slot : bleStreamMetrics) {
+        uint32_t mtu = slot.mtu.load(std::memory_order_relaxed);
+        if (mtu != 0) {
+            uint32_t durationUs = slot.durationUs.load(std::memory_order_relaxed);
+            writeLine(response, "zap_ble_stream_seconds_total{mtu=\"%u\"} %u.%06u\n", mtu,
+                      durationUs / 1000000, durationUs % 1000000);
+        }
+    }
+    response.write("# TYPE zap_ble_stream_aborted_total counter\n");
+    writeLine(response, "zap_ble_stream_aborted_total %u\n", bleStreamAborted.load(std::memory_order_relaxed));
+
+    EventStreamStats stream = eventStreamStats();
+    response.write("# TYPE zap_stream_subscribers gauge\n");
+    writeLine(response, "zap_stream_subscribers %u\n", stream.subscribers);
+    response.write("# TYPE zap_stream_rejected_total counter\n");
+    writeLine(response, "zap_stream_rejected_total %u\n", stream.rejected);
+    response.write("# TYPE zap_stream_events_total counter\n");
+    writeLine(response, "zap_stream_events_total %u\n", stream.published);
+    response.write("# TYPE zap_stream_dropped_total counter\n");
+    writeLine(response, "zap_stream_dropped_total %u\n", stream.dropped);
+    response.write("# TYPE zap_stream_disconnects_total counter\n");
+    writeLine(response, "zap_stream_disconnects_total %u\n", stream.disconnects);
+
+    response.write("# TYPE zap_heap_free_bytes gauge\n");
+    writeLine(response, "zap_heap_free_bytes %u\n", ESP.getFreeHeap());
+    response.write("# TYPE zap_heap_min_free_bytes gauge\n");
+    writeLine(response, "zap_heap_min_free_bytes %u\n", ESP.getMinFreeHeap());
+    response.write("# TYPE zap_heap_largest_block_bytes gauge\n");
+    writeLine(response, "zap_heap_largest_block_bytes %u\n",
+              (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    response.write("# TYPE zap_psram_size_bytes gauge\n");
+    writeLine(response, "zap_psram_size_bytes %u\n", ESP.getPsramSize());
+    response.write("# TYPE zap_psram_free_bytes gauge\n");
+    writeLine(response, "zap_psram_free_bytes %u\n", ESP.getFreePsram());
+}
+
+// --- JSON ---
+
+static void writeJsonHistogram(JsonWriter& json, const char* name, const LatencyHistogram& histogram) {
+    size_t used = LatencyHistogram::BUCKET_COUNT;
+    while (used > 0 && histogram.bucket(used - 1) == 0) {
+        used--;
+    }
+    json.beginObject(name);
+    json.member("n", histogram.count());
+    json.member("sumMs", histogram.sumMs());
+    json.beginArray("b");
+    for (size_t i = 0; i < used; i++) {
+        json.value(histogram.bucket(i));
+    }
+    json.endArray();
+    json.endObject();
+}
+
+void metricsWriteJson(ResponseSink& response) {
+    response.begin(200, "application/json");
+    JsonWriter json(response);
+    json.beginObject();
+
+    // Bucket upper bounds, shared by every histogram below
+    json.beginArray("boundsUs");
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKET_COUNT; i++) {
+        json.value(LatencyHistogram::bucketBound(i));
+    }
+    json.endArray();
+
+    json.beginArray("endpoints");
+    for (size_t slot = 0; slot < ENDPOINT_SLOTS; slot++) {
+        for (size_t t = 0; t < TRANSPORT_COUNT; t++) {
+            const EndpointMetrics& metrics = endpointMetrics[slot][t];
+            uint32_t requests = metrics.requests.load(std::memory_order_relaxed);
+            if (requests == 0) {
+                continue;
+            }
+            const char* path;
+            const char* method;
+            endpointLabels(slot, path, method);
+            json.beginObject();
+            json.member("path", path);
+            json.member("method", method);
+            json.member("transport", TRANSPORT_NAMES[t]);
+            json.member("requests", requests);
+            json.member("errors", metrics.errors.load(std::memory_order_relaxed));
+            json.member("arenaPeak", metrics.arenaPeak.load(std::memory_order_relaxed));
+            writeJsonHistogram(json, "latency", metrics.latency);
+            json.endObject();
+        }
+    }
+    json.endArray();
+
+    json.beginObject("arena");
+    json.member("size", (uint32_t)REQUEST_ARENA_SIZE);
+    json.member("failures", requestArena.failures());
+    json.endObject();
+
+    RateLimitStats limits = rateLimitStats();
+    json.beginObject("rateLimit");
+    for (size_t c = 0; c < (size_t)CostClass::COUNT; c++) {
+        json.beginObject(costClassName((CostClass)c));
+        json.member("admitted", limits.admitted[c]);
+        json.member("limited", limits.limited[c]);
+        json.endObject();
+    }
+    json.member("shed", limits.shed);
+    json.member("clients", limits.clients);
+    json.member("evictions", limits.evictions);
+    json.endObject();
+
+    json.beginObject("upload");
+    json.member("attempts", uploadAttempts.load(std::memory_order_relaxed));
+    json.member("failures", uploadFailures.load(std::memory_order_relaxed));
+    writeJsonHistogram(json, "latency", uploadLatency);
+    json.endObject();
+
+    json.beginObject("loop");
+    json.member("maxUs", loopMaxUs.load(std::memory_order_relaxed));
+    writeJsonHistogram(json, "latency", loopLatency);
+    json.endObject();
+
+    json.beginObject("bleRequest");
+    json.member("slotsExhausted", bleSlotsExhausted.load(std::memory_order_relaxed));
+    json.member("reassembled", bleReassembled.load(std::memory_order_relaxed));
+    json.member("reassemblyDropped", bleReassemblyDropped.load(std::memory_order_relaxed));
+    writeJsonHistogram(json, "latency", bleRequestLatency);
+    json.endObject();
+
+    json.beginObject("bleStream");
+    json.member("aborted", bleStreamAborted.load(std::memory_order_relaxed));
+    json.beginArray("mtus");
+    for (const BleStreamMetrics& slot : bleStreamMetrics) {
+        uint32_t mtu = slot.mtu.load(std::memory_order_relaxed);
+        if (mtu == 0) {
+            continue;
+        }
+        json.beginObject();
+        json.member("mtu", mtu);
+        json.member("transfers", slot.transfers.load(std::memory_order_relaxed));
+        json.member("bytes", slot.bytes.load(std::memory_order_relaxed));
+        json.member("us", slot.durationUs.load(std::memory_order_relaxed));
+        json.member("bytesPerSec", bleStreamBytesPerSecond(slot));
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+
+    EventStreamStats stream = eventStreamStats();
+    json.beginObject("stream");
+    json.member("subscribers", stream.subscribers);
+    json.member("subscribed", stream.subscribed);
+    json.member("rejected", stream.rejected);
+    json.member("events", stream.published);
+    json.member("dropped", stream.dropped);
+    json.member("disconnects", stream.disconnects);
+    json.endObject();
+
+    json.beginObject("heap");
+    json.member("free", ESP.getFreeHeap());
+    json.member("minFree", ESP.getMinFreeHeap());
+    json.member("largestBlock", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    json.member("psramSize", ESP.getPsramSize());
+    json.member("psramFree", ESP.getFreePsram());
+    json.endObject();
+
+    json.endObject();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "endpoint_types.h"
+#include "response_sink.h"
+
+// Runtime metrics registry. All recording functions only do relaxed atomic
+// increments on preallocated counters: no locks and no allocation, so they
+// are safe on hot paths and from any task. Formatting happens on scrape.
+
+// Latency histogram with log2 buckets from 250 us to ~4 s plus +Inf
+class LatencyHistogram {
+public:
+    static const size_t BUCKET_COUNT = 16;
+
+    void record(uint32_t micros);
+
+    // Upper bound of a bucket in microseconds, 0 for the +Inf bucket
+    static uint32_t bucketBound(size_t bucket);
+
+    uint32_t bucket(size_t index) const { return _buckets[index].load(std::memory_order_relaxed); }
+    uint32_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint32_t sumMs() const { return _sumMs.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _buckets[BUCKET_COUNT] = {};
+    std::atomic<uint32_t> _count{0};
+    std::atomic<uint32_t> _sumMs{0};  // Each sample rounded to ms; 32-bit keeps it lock-free on the ESP32
+};
+
+// `arenaBytes` is the request arena's high-water mark for this request
+void metricsRecordRequest(Endpoint endpoint, RequestTransport transport, int statusCode, uint32_t latencyUs,
+                          uint32_t arenaBytes);
+void metricsRecordUpload(bool success, uint32_t latencyUs);
+void metricsRecordLoop(uint32_t iterationUs);
+// A BLE response streamed as notifications at the peer's MTU. Abandoned
+// transfers are only counted.
+void metricsRecordBleStream(uint16_t mtu, uint32_t bytes, uint32_t durationUs, bool completed);
+// Time from a BLE request arriving to its response being notified,
+// queueing included
+void metricsRecordBleRequest(uint32_t latencyUs);
+// A BLE write dropped because every request slot was taken
+void metricsRecordBleSlotsExhausted();
+// A BLE request put together from several writes and queued
+void metricsRecordBleReassembled();
+// A BLE request split over several writes and dropped: too large, timed
+// out, or no large slot free
+void metricsRecordBleReassemblyDropped();
+
+// Prometheus text exposition format (HTTP)
+void metricsWritePrometheus(ResponseSink& response);
+// Compact JSON (BLE): histograms as bucket arrays with trailing zeros trimmed
+void metricsWriteJson(ResponseSink& response);
@@ -0,0 +1,157 @@
+#include "name_cache.h"
+#include <WiFi.h>
+#include <Preferences.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "graphql.h"
+
+#define NAME_CACHE_NAMESPACE "namecache"
+#define NAME_CACHE_TASK_STACK 8192
+#define NAME_CACHE_TASK_PRIORITY 1
+
+// Anything before this is "time not set yet" (same threshold as initNTP)
+static const time_t VALID_TIME_THRESHOLD = 8 * 3600 * 2;
+
+static SemaphoreHandle_t cacheMutex = nullptr;
+static String cachedName;
+static time_t fetchedEpoch = 0;           // Wall clock time of last successful fetch (0 = unknown)
+static unsigned long fetchedMillis = 0;   // millis() of last fetch in this boot
+static bool fetchedThisBoot = false;      // Values loaded from NVS are stale until refreshed
+static unsigned long lastAttemptMillis = 0;
+static bool attemptedThisBoot = false;
+static volatile bool refreshInFlight = false;
+static uint32_t hitCount = 0;
+static uint32_t missCount = 0;
+
+static void persistName(const String& name, time_t epoch) {
+    Preferences prefs;
+    if (!prefs.begin(NAME_CACHE_NAMESPACE, false)) {
+        Serial.println("Name cache: failed to open NVS");
+        return;
+    }
+    prefs.putString("name", name);
+    prefs.putLong64("at", (int64_t)epoch);
+    prefs.end();
+}
+
+static void refreshTask(void* param) {
+    extern String getId();
+    String name = fetchGatewayName(getId());
+
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    lastAttemptMillis = millis();
+    attemptedThisBoot = true;
+    bool changed = false;
+    if (name.length() > 0) {
+        changed = (name != cachedName);
+        cachedName = name;
+        fetchedMillis = millis();
+        fetchedThisBoot = true;
+        time_t now = time(nullptr);
+        fetchedEpoch = now > VALID_TIME_THRESHOLD ? now : 0;
+    }
+    time_t epoch = fetchedEpoch;
+    xSemaphoreGive(cacheMutex);
+
+    if (name.length() > 0) {
+        // Nothing new to persist if the name is unchanged and time is not set
+        if (changed || epoch != 0) {
+            persistName(name, epoch);
+        }
+        Serial.println("Name cache: refreshed gateway name: " + name);
+    } else {
+        Serial.println("Name cache: refresh failed");
+    }
+
+    refreshInFlight = false;
+    vTaskDelete(nullptr);
+}
+
+// Must be called with cacheMutex held
+static bool isStaleLocked() {
+    if (cachedName.length() == 0 || !fetchedThisBoot) {
+        return true;
+    }
+    return millis() - fetchedMillis >= NAME_CACHE_TTL_MS;
+}
+
+// Must be called with cacheMutex held
+static void startRefreshLocked() {
+    if (refreshInFlight || WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+    if (attemptedThisBoot && millis() - lastAttemptMillis < NAME_CACHE_RETRY_MS) {
+        return;
+    }
+
+    refreshInFlight = true;
+    if (xTaskCreate(refreshTask, "name_refresh", NAME_CACHE_TASK_STACK, nullptr,
+                    NAME_CACHE_TASK_PRIORITY, nullptr) != pdPASS) {
+        Serial.println("Name cache: failed to start refresh task");
+        refreshInFlight = false;
+    }
+}
+
+void nameCacheInit() {
+    if (cacheMutex == nullptr) {
+        cacheMutex = xSemaphoreCreateMutex();
+    }
+
+    Preferences prefs;
+    if (prefs.begin(NAME_CACHE_NAMESPACE, true)) {
+        xSemaphoreTake(cacheMutex, portMAX_DELAY);
+        cachedName = prefs.getString("name", "");
+        fetchedEpoch = (time_t)prefs.getLong64("at", 0);
+        xSemaphoreGive(cacheMutex);
+        prefs.end();
+    }
+
+    if (cachedName.length() > 0) {
+        Serial.println("Name cache: loaded gateway name from NVS: " + cachedName);
+    }
+}
+
+NameCacheStatus nameCacheGet() {
+    NameCacheStatus status;
+
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    status.name = cachedName;
+    status.cached = cachedName.length() > 0;
+    status.stale = isStaleLocked();
+
+    if (status.cached) {
+        hitCount++;
+    } else {
+        missCount++;
+    }
+
+    status.ageSeconds = -1;
+    if (fetchedThisBoot) {
+        status.ageSeconds = (millis() - fetchedMillis) / 1000;
+    } else if (fetchedEpoch != 0) {
+        time_t now = time(nullptr);
+        if (now > VALID_TIME_THRESHOLD && now >= fetchedEpoch) {
+            status.ageSeconds = now - fetchedEpoch;
+        }
+    }
+
+    if (status.stale) {
+        startRefreshLocked();
+    }
+    status.refreshing = refreshInFlight;
+    status.hits = hitCount;
+    status.misses = missCount;
+    xSemaphoreGive(cacheMutex);
+
+    return status;
+}
+
+void nameCacheRefresh() {
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    if (isStaleLocked()) {
+        startRefreshLocked();
+    }
+    xSemaphoreGive(cacheMutex);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cached gateway name served by /api/name.
+// The value is persisted in NVS and refreshed from the backend on a
+// background task (stale-while-revalidate), so readers never block on TLS.
+
+#ifndef NAME_CACHE_TTL_MS
+#define NAME_CACHE_TTL_MS (60UL * 60UL * 1000UL)  // Refresh after 1 hour
+#endif
+
+#ifndef NAME_CACHE_RETRY_MS
+#define NAME_CACHE_RETRY_MS (30UL * 1000UL)  // Minimum gap between failed fetches
+#endif
+
+struct NameCacheStatus {
+    String name;           // Cached name, empty if nothing cached yet
+    bool cached;           // True if a value was available (hit)
+    bool stale;            // True if the value is older than the TTL
+    bool refreshing;       // True while a background fetch is in flight
+    long ageSeconds;       // Age of the cached value, -1 if unknown
+    uint32_t hits;
+    uint32_t misses;
+};
+
+// Load the persisted name from NVS. Call once from setup().
+void nameCacheInit();
+
+// Return the cached name without blocking. Schedules a background refresh
+// when the value is missing or stale; concurrent callers share one fetch.
+NameCacheStatus nameCacheGet();
+
+// Start a background refresh if the value is missing or stale (e.g. after
+// WiFi connects). No-op if a fetch is already running or the last attempt
+// was less than NAME_CACHE_RETRY_MS ago.
+void nameCacheRefresh();
@@ -1,17 +1,10 @@
 #include "p1data.h"
 #include <ArduinoJson.h>
+#include "time_sync.h"
 
 void initNTP() {
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");  // 0, 0 = UTC, no daylight offset
-    
-    Serial.print("Waiting for NTP time sync: ");
-    time_t now = time(nullptr);
-    while (now < 8 * 3600 * 2) {
-        delay(500);
-        Serial.print(".");
-        now = time(nullptr);
-    }
-    Serial.println();
+    // Sync runs in the background; see time_sync.cpp
+    timeSyncStart();
 }
 
 unsigned long long getCurrentTimestamp() {
@@ -20,27 +13,17 @@ unsigned long long getCurrentTimestamp() {
     return (unsigned long long)tv.tv_sec * 1000LL + (unsigned long long)tv.tv_usec / 1000LL;
 }
 
-String createP1JWT(const char* privateKey, const String& deviceId) {
-    // Create the header
-    StaticJsonDocument<512> header;
-    header["alg"] = "ES256";
-    header["typ"] = "JWT";
-    header["device"] = deviceId;
-    header["opr"] = "production";
-    header["model"] = "p1homewizard";
-    header["dtype"] = "p1_telnet_json";
-    header["sn"] = "LGF5E360";
-
-    String headerStr;
-    serializeJson(header, headerStr);
+P1Values captureP1Values() {
+    P1Values values;
+    // Retake the time if SNTP stepped the clock in between, so the state
+    // matches the clock the time came from
+    values.timeState = timeSyncState();
+    values.timestampMs = getCurrentTimestamp();
+    if (timeSyncState() != values.timeState) {
+        values.timeState = timeSyncState();
+        values.timestampMs = getCurrentTimestamp();
+    }
 
-    // Create the payload
-    StaticJsonDocument<2048> payload;
-    String timestamp = String(getCurrentTimestamp());
-    
-    JsonObject data = payload.createNestedObject(timestamp);
-    data["serial_number"] = "LGF5E360";
-    
     // Calculate simulated values using sine waves
     float timeInSeconds = millis() / 1000.0;
     
@@ -83,12 +66,45 @@ String createP1JWT(const char* privateKey, const String& deviceId) {
     static float lastEnergy = 10968.132;
     lastEnergy += totalPower * (10.0 / 3600.0); // Add energy for 10-second interval in kWh
 
+    values.importKwh = lastEnergy;
+    values.powerKw = totalPower;
+    values.phasePowerKw[0] = powerL1;
+    values.phasePowerKw[1] = powerL2;
+    values.phasePowerKw[2] = powerL3;
+    values.voltage[0] = voltageL1;
+    values.voltage[1] = voltageL2;
+    values.voltage[2] = voltageL3;
+    values.current[0] = currentL1;
+    values.current[1] = currentL2;
+    values.current[2] = currentL3;
+    return values;
+}
+
+String createP1Reading(const P1Values& values) {
+    // Create the payload
+    StaticJsonDocument<2048> payload;
+    String timestamp = String(values.timestampMs);
+    
+    JsonObject data = payload.createNestedObject(timestamp);
+    data["serial_number"] = "LGF5E360";
+
+    float lastEnergy = values.importKwh;
+    float totalPower = values.powerKw;
+    float powerL1 = values.phasePowerKw[0];
+    float powerL2 = values.phasePowerKw[1];
+    float powerL3 = values.phasePowerKw[2];
+    float voltageL1 = values.voltage[0];
+    float voltageL2 = values.voltage[1];
+    float voltageL3 = values.voltage[2];
+    float currentL1 = values.current[0];
+    float currentL2 = values.current[1];
+    float currentL3 = values.current[2];
+
     char buffer[64];
     JsonArray rows = data.createNestedArray("rows");
 
-    // Format timestamp
-    time_t now;
-    time(&now);
+    // Format timestamp (the capture time, so the rows match the key)
+    time_t now = (time_t)(values.timestampMs / 1000);
     struct tm timeinfo;
     gmtime_r(&now, &timeinfo);
     snprintf(buffer, sizeof(buffer), "0-0:1.0.0(%02d%02d%02d%02d%02d%02dW)",
@@ -157,7 +173,23 @@ String createP1JWT(const char* privateKey, const String& deviceId) {
 
     String payloadStr;
     serializeJson(payload, payloadStr);
+    return payloadStr;
+}
+
+String createP1JWT(const char* privateKey, const String& deviceId, const String& reading) {
+    // Create the header
+    StaticJsonDocument<512> header;
+    header["alg"] = "ES256";
+    header["typ"] = "JWT";
+    header["device"] = deviceId;
+    header["opr"] = "production";
+    header["model"] = "p1homewizard";
+    header["dtype"] = "p1_telnet_json";
+    header["sn"] = "LGF5E360";
+
+    String headerStr;
+    serializeJson(header, headerStr);
 
     // Create and return the JWT
-    return crypto_create_jwt(headerStr.c_str(), payloadStr.c_str(), privateKey);
+    return crypto_create_jwt(headerStr.c_str(), reading.c_str(), privateKey);
 } 
\ No newline at end of file
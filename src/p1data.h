@@ -4,14 +4,32 @@
 #include <Arduino.h>
 #include "crypto.h"
 #include <time.h>
+#include "time_sync.h"
 
-// Function to create the P1 meter JWT
-String createP1JWT(const char* privateKey, const String& deviceId);
+// One P1 meter reading
+struct P1Values {
+    unsigned long long timestampMs;  // Capture time, epoch ms
+    TimeSyncState timeState;         // Clock the time was read from; see timeSyncCorrect()
+    float importKwh;                 // Cumulative imported energy
+    float powerKw;                   // Total active power
+    float phasePowerKw[3];
+    float voltage[3];
+    float current[3];
+};
+
+// Take a reading from the meter
+P1Values captureP1Values();
+
+// Format a reading as the compact JSON JWT payload
+String createP1Reading(const P1Values& values);
+
+// Function to create the P1 meter JWT around a reading from createP1Reading()
+String createP1JWT(const char* privateKey, const String& deviceId, const String& reading);
 
 // Function to get current timestamp in milliseconds
 unsigned long long getCurrentTimestamp();
 
-// Function to initialize NTP
+// Function to start NTP time synchronization (non-blocking)
 void initNTP();
 
 #endif 
\ No newline at end of file
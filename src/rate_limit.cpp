@@ -0,0 +1,151 @@
+#include "rate_limit.h"
+#include <freertos/FreeRTOS.h>
+
+static constexpr size_t CLASS_COUNT = (size_t)CostClass::COUNT;
+
+// Tokens are kept in thousandths, so a rate of R tokens per second refills
+// R milli-tokens per millisecond and integer math is exact
+static constexpr uint32_t TOKEN = 1000;
+
+struct BucketConfig {
+    uint32_t rate;    // Tokens per second
+    uint32_t burst;   // Tokens
+};
+
+static constexpr BucketConfig CLASS_CONFIG[CLASS_COUNT] = {
+    { RATE_LIMIT_CHEAP_RATE, RATE_LIMIT_CHEAP_BURST },
+    { RATE_LIMIT_EXPENSIVE_RATE, RATE_LIMIT_EXPENSIVE_BURST },
+};
+
+static constexpr BucketConfig GLOBAL_EXPENSIVE_CONFIG = {
+    RATE_LIMIT_GLOBAL_EXPENSIVE_RATE, RATE_LIMIT_GLOBAL_EXPENSIVE_BURST
+};
+
+static_assert(RATE_LIMIT_CHEAP_RATE > 0 && RATE_LIMIT_EXPENSIVE_RATE > 0 && RATE_LIMIT_GLOBAL_EXPENSIVE_RATE > 0,
+              "Rate limits need a refill rate");
+
+struct Bucket {
+    uint32_t tokens;         // Milli-tokens
+    unsigned long refilledAt;
+};
+
+struct Client {
+    uint32_t id;             // 0 = free slot
+    RequestTransport transport;
+    unsigned long lastSeen;
+    Bucket buckets[CLASS_COUNT];
+};
+
+static Client clients[RATE_LIMIT_CLIENTS];
+static Bucket globalExpensive = { GLOBAL_EXPENSIVE_CONFIG.burst * TOKEN, 0 };
+static RateLimitStats stats = {};
+static portMUX_TYPE limiterMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void refill(Bucket& bucket, const BucketConfig& config, unsigned long now) {
+    uint32_t capacity = config.burst * TOKEN;
+    uint32_t elapsed = now - bucket.refilledAt;
+    bucket.refilledAt = now;
+    // Anything past a full refill is clamped, which also keeps the product in range
+    if (elapsed >= capacity / config.rate) {
+        bucket.tokens = capacity;
+        return;
+    }
+    bucket.tokens += elapsed * config.rate;
+    if (bucket.tokens > capacity) {
+        bucket.tokens = capacity;
+    }
+}
+
+// Milliseconds until the bucket holds a whole token
+static uint32_t waitMs(const Bucket& bucket, const BucketConfig& config) {
+    return bucket.tokens >= TOKEN ? 0 : (TOKEN - bucket.tokens + config.rate - 1) / config.rate;
+}
+
+// Call inside the critical section
+static Client& findClient(RequestTransport transport, uint32_t id, unsigned long now) {
+    Client* oldest = &clients[0];
+    for (size_t i = 0; i < RATE_LIMIT_CLIENTS; i++) {
+        Client& client = clients[i];
+        if (client.id == id && client.transport == transport) {
+            return client;
+        }
+        if (client.id == 0) {
+            // Free slots win over evicting anyone
+            if (oldest->id != 0) {
+                oldest = &client;
+            }
+        } else if (oldest->id != 0 && now - client.lastSeen > now - oldest->lastSeen) {
+            oldest = &client;
+        }
+    }
+
+    if (oldest->id != 0) {
+        stats.evictions++;
+    } else {
+        stats.clients++;
+    }
+    // New clients start with full buckets
+    oldest->id = id;
+    oldest->transport = transport;
+    for (size_t c = 0; c < CLASS_COUNT; c++) {
+        oldest->buckets[c].tokens = CLASS_CONFIG[c].burst * TOKEN;
+        oldest->buckets[c].refilledAt = now;
+    }
+    return *oldest;
+}
+
+uint32_t rateLimitAdmit(RequestTransport transport, uint32_t id, CostClass cost) {
+    if (id == 0) {
+        return 0;
+    }
+
+    size_t index = (size_t)cost < CLASS_COUNT ? (size_t)cost : 0;
+    const BucketConfig& config = CLASS_CONFIG[index];
+    bool expensive = cost == CostClass::EXPENSIVE;
+    unsigned long now = millis();
+    uint32_t wait = 0;
+
+    portENTER_CRITICAL(&limiterMux);
+    Client& client = findClient(transport, id, now);
+    client.lastSeen = now;
+    Bucket& bucket = client.buckets[index];
+    refill(bucket, config, now);
+    if (expensive) {
+        refill(globalExpensive, GLOBAL_EXPENSIVE_CONFIG, now);
+    }
+
+    // Take from both buckets or neither, so a shed request doesn't cost
+    // the client its own budget
+    if (bucket.tokens < TOKEN) {
+        wait = waitMs(bucket, config);
+        stats.limited[index]++;
+    } else if (expensive && globalExpensive.tokens < TOKEN) {
+        wait = waitMs(globalExpensive, GLOBAL_EXPENSIVE_CONFIG);
+        stats.shed++;
+    } else {
+        bucket.tokens -= TOKEN;
+        if (expensive) {
+            globalExpensive.tokens -= TOKEN;
+        }
+        stats.admitted[index]++;
+    }
+    portEXIT_CRITICAL(&limiterMux);
+
+    // Whole seconds for Retry-After, rounded up
+    return wait == 0 ? 0 : (wait + 999) / 1000;
+}
+
+RateLimitStats rateLimitStats() {
+    portENTER_CRITICAL(&limiterMux);
+    RateLimitStats copy = stats;
+    portEXIT_CRITICAL(&limiterMux);
+    return copy;
+}
+
+const char* costClassName(CostClass cost) {
+    switch (cost) {
+        case CostClass::CHEAP: return "cheap";
+        case CostClass::EXPENSIVE: return "expensive";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include "endpoint_types.h"
+
+// Admission control for the local API.
+// Each client (IPv4 address over HTTP, connection over BLE) has a token
+// bucket per CostClass; every request takes one token from the bucket of
+// its route's class. Expensive requests also take one from a bucket shared
+// by all clients, so many clients together can't keep the device busy with
+// ECC math either. Cheap requests never wait behind that shared budget.
+// Rejected requests get 429 with Retry-After from EndpointMapper::route,
+// before the route lock is taken.
+
+#ifndef RATE_LIMIT_CLIENTS
+#define RATE_LIMIT_CLIENTS 8  // Tracked clients; the least recently seen is evicted
+#endif
+
+// Refill rates are tokens per second, bursts are the bucket sizes
+#ifndef RATE_LIMIT_CHEAP_RATE
+#define RATE_LIMIT_CHEAP_RATE 10
+#endif
+
+#ifndef RATE_LIMIT_CHEAP_BURST
+#define RATE_LIMIT_CHEAP_BURST 20
+#endif
+
+#ifndef RATE_LIMIT_EXPENSIVE_RATE
+#define RATE_LIMIT_EXPENSIVE_RATE 1
+#endif
+
+#ifndef RATE_LIMIT_EXPENSIVE_BURST
+#define RATE_LIMIT_EXPENSIVE_BURST 4
+#endif
+
+// Device-wide budget for expensive requests
+#ifndef RATE_LIMIT_GLOBAL_EXPENSIVE_RATE
+#define RATE_LIMIT_GLOBAL_EXPENSIVE_RATE 2
+#endif
+
+#ifndef RATE_LIMIT_GLOBAL_EXPENSIVE_BURST
+#define RATE_LIMIT_GLOBAL_EXPENSIVE_BURST 6
+#endif
+
+struct RateLimitStats {
+    uint32_t admitted[(size_t)CostClass::COUNT];
+    uint32_t limited[(size_t)CostClass::COUNT];   // Client bucket empty
+    uint32_t shed;          // Expensive requests rejected by the device-wide budget
+    uint32_t clients;       // Clients currently tracked
+    uint32_t evictions;
+};
+
+// Take a token for a request from `client` (0 = internal, never limited).
+// Returns 0 if the request may run, otherwise the seconds until it would
+// be admitted, for Retry-After. Safe from any task.
+uint32_t rateLimitAdmit(RequestTransport transport, uint32_t client, CostClass cost);
+
+RateLimitStats rateLimitStats();
+
+const char* costClassName(CostClass cost);
@@ -0,0 +1,309 @@
+#include "reading_history.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <mutex>
+#endif
+
+// begin() rounds the capacity up with a mask
+static_assert(READING_HISTORY_BLOCK > 0 && (READING_HISTORY_BLOCK & (READING_HISTORY_BLOCK - 1)) == 0,
+              "READING_HISTORY_BLOCK must be a power of two");
+
+ReadingHistory readingHistory;
+
+ReadingHistory::ReadingHistory() {}
+
+// FreeRTOS mutex on the device, std::mutex on the host
+void ReadingHistory::lock() {
+#if defined(ARDUINO)
+    xSemaphoreTake((SemaphoreHandle_t)_lock, portMAX_DELAY);
+#else
+    static_cast<std::mutex*>(_lock)->lock();
+#endif
+}
+
+void ReadingHistory::unlock() {
+#if defined(ARDUINO)
+    xSemaphoreGive((SemaphoreHandle_t)_lock);
+#else
+    static_cast<std::mutex*>(_lock)->unlock();
+#endif
+}
+
+bool ReadingHistory::begin(size_t capacity, bool preferPsram) {
+#if !defined(ARDUINO)
+    (void)preferPsram;  // No PSRAM on the host
+#endif
+    if (_records != nullptr || capacity == 0) {
+        return false;
+    }
+    capacity = (capacity + READING_HISTORY_BLOCK - 1) & ~(size_t)(READING_HISTORY_BLOCK - 1);
+    size_t blocks = capacity / READING_HISTORY_BLOCK;
+
+#if defined(ARDUINO)
+    if (preferPsram) {
+        _records = (ReadingRecord*)heap_caps_malloc(capacity * sizeof(ReadingRecord), MALLOC_CAP_SPIRAM);
+        _inPsram = _records != nullptr;
+    }
+    if (_records == nullptr) {
+        _records = (ReadingRecord*)heap_caps_malloc(capacity * sizeof(ReadingRecord), MALLOC_CAP_8BIT);
+    }
+    // The index is searched on every query; keep it in internal RAM
+    _blockFirst = (uint32_t*)heap_caps_malloc(blocks * sizeof(uint32_t), MALLOC_CAP_8BIT);
+    _lock = xSemaphoreCreateMutex();
+#else
+    _records = (ReadingRecord*)malloc(capacity * sizeof(ReadingRecord));
+    _blockFirst = (uint32_t*)malloc(blocks * sizeof(uint32_t));
+    _lock = new std::mutex();
+#endif
+    if (_records == nullptr || _blockFirst == nullptr || _lock == nullptr) {
+        free(_records);
+        free(_blockFirst);
+        _records = nullptr;
+        _blockFirst = nullptr;
+        return false;
+    }
+    _capacity = capacity;
+    return true;
+}
+
+bool ReadingHistory::append(const ReadingRecord& record, bool provisional) {
+    if (_records == nullptr) {
+        return false;
+    }
+    lock();
+    if (_appended > 0 && record.time < _records[(_appended - 1) % _capacity].time) {
+        unlock();
+        return false;  // Clock went backwards; the index needs ordered times
+    }
+    size_t slot = _appended % _capacity;
+    _records[slot] = record;
+    if (slot % READING_HISTORY_BLOCK == 0) {
+        _blockFirst[slot / READING_HISTORY_BLOCK] = record.time;
+    }
+    if (provisional) {
+        if (_provisionalStart == _provisionalEnd) {
+            _provisionalStart = _appended;
+        }
+        _provisionalEnd = _appended + 1;
+    }
+    _appended++;
+    unlock();
+    return true;
+}
+
+size_t ReadingHistory::correctProvisional(int64_t deltaSeconds) {
+    if (_records == nullptr) {
+        return 0;
+    }
+    lock();
+    uint64_t oldest = oldestSeq();
+    uint64_t seq = _provisionalStart > oldest ? _provisionalStart : oldest;
+    size_t changed = 0;
+    for (; seq < _provisionalEnd; seq++) {
+        // A uniform shift keeps the run in order, and the sync happened
+        // after all of it, so it stays before later records
+        ReadingRecord& record = _records[seq % _capacity];
+        int64_t time = (int64_t)record.time + deltaSeconds;
+        record.time = time < 0 ? 0 : time > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)time;
+        size_t slot = seq % _capacity;
+        if (slot % READING_HISTORY_BLOCK == 0) {
+            _blockFirst[slot / READING_HISTORY_BLOCK] = record.time;
+        }
+        changed++;
+    }
+    _provisionalStart = _provisionalEnd;
+    unlock();
+    return changed;
+}
+
+size_t ReadingHistory::provisionalCount() {
+    lock();
+    uint64_t oldest = oldestSeq();
+    uint64_t start = _provisionalStart > oldest ? _provisionalStart : oldest;
+    size_t count = _provisionalEnd > start ? (size_t)(_provisionalEnd - start) : 0;
+    unlock();
+    return count;
+}
+
+uint64_t ReadingHistory::oldestSeq() const {
+    return _appended > _capacity ? _appended - _capacity : 0;
+}
+
+// First sequence number whose record is at or after `time`
+uint64_t ReadingHistory::findSeq(uint32_t time, uint32_t& probes) const {
+    uint64_t oldest = oldestSeq();
+    if (_appended == oldest) {
+        return oldest;
+    }
+
+    // Blocks fully inside the ring start at multiples of the block size
+    // (the capacity is one too, so slot and sequence number agree)
+    uint64_t firstBlock = (oldest + READING_HISTORY_BLOCK - 1) & ~(uint64_t)(READING_HISTORY_BLOCK - 1);
+    uint64_t blockCount = firstBlock < _appended ? (_appended - firstBlock + READING_HISTORY_BLOCK - 1) / READING_HISTORY_BLOCK : 0;
+
+    // Last block starting before `time`; equal times may continue from
+    // the previous block, so that one is searched from its start
+    uint64_t low = 0;
+    uint64_t high = blockCount;
+    while (low < high) {
+        uint64_t middle = (low + high) / 2;
+        uint64_t seq = firstBlock + middle * READING_HISTORY_BLOCK;
+        probes++;
+        if (_blockFirst[(seq % _capacity) / READING_HISTORY_BLOCK] < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    uint64_t seq = low == 0 ? oldest : firstBlock + (low - 1) * READING_HISTORY_BLOCK;
+
+    // Within one block (or the partial block before the first one)
+    while (seq < _appended && _records[seq % _capacity].time < time) {
+        seq++;
+    }
+    return seq;
+}
+
+size_t ReadingHistory::copyRecords(uint64_t& seq, ReadingRecord* out, size_t max) {
+    uint64_t oldest = oldestSeq();
+    if (seq < oldest) {
+        seq = oldest;  // Overwritten while the query was running
+    }
+    size_t count = 0;
+    while (count < max && seq < _appended) {
+        out[count++] = _records[seq % _capacity];
+        seq++;
+    }
+    return count;
+}
+
+size_t ReadingHistory::size() {
+    lock();
+    size_t count = (size_t)(_appended - oldestSeq());
+    unlock();
+    return count;
+}
+
+uint32_t ReadingHistory::oldestTime() {
+    lock();
+    uint32_t time = _appended > 0 ? _records[oldestSeq() % _capacity].time : 0;
+    unlock();
+    return time;
+}
+
+uint32_t ReadingHistory::newestTime() {
+    lock();
+    uint32_t time = _appended > 0 ? _records[(_appended - 1) % _capacity].time : 0;
+    unlock();
+    return time;
+}
+
+namespace {
+
+// Merges the records of one bucket into a row
+struct Bucket {
+    ReadingRecord sum;
+    uint32_t samples = 0;
+
+    void add(const ReadingRecord& record) {
+        if (samples == 0) {
+            sum = record;
+        } else {
+            sum.importKwh = record.importKwh;
+            sum.powerKw += record.powerKw;
+            for (int i = 0; i < 3; i++) {
+                sum.phasePowerKw[i] += record.phasePowerKw[i];
+                sum.voltage[i] += record.voltage[i];
+                sum.current[i] += record.current[i];
+            }
+        }
+        samples++;
+    }
+
+    ReadingRecord average(uint32_t time) const {
+        ReadingRecord row = sum;
+        row.time = time;
+        float scale = 1.0f / samples;
+        row.powerKw *= scale;
+        for (int i = 0; i < 3; i++) {
+            row.phasePowerKw[i] *= scale;
+            row.voltage[i] *= scale;
+            row.current[i] *= scale;
+        }
+        return row;
+    }
+};
+
+}  // namespace
+
+ReadingQueryStats ReadingHistory::query(uint32_t from, uint32_t to, uint32_t step, size_t maxRows,
+                                        ReadingRowCallback callback, void* context) {
+    ReadingQueryStats stats = {};
+    if (_records == nullptr || from > to) {
+        return stats;
+    }
+
+    lock();
+    uint64_t seq = findSeq(from, stats.indexProbes);
+    unlock();
+
+    ReadingRecord chunk[COPY_CHUNK];
+    Bucket bucket;
+    uint32_t bucketTime = 0;
+    bool done = false;
+
+    while (!done) {
+        lock();
+        size_t count = copyRecords(seq, chunk, COPY_CHUNK);
+        unlock();
+        if (count == 0) {
+            break;
+        }
+        stats.recordsRead += count;
+
+        for (size_t i = 0; i < count; i++) {
+            const ReadingRecord& record = chunk[i];
+            if (record.time < from) {
+                continue;
+            }
+            if (record.time > to) {
+                done = true;
+                break;
+            }
+            uint32_t time = step > 0 ? from + (record.time - from) / step * step : record.time;
+            if (step == 0 || (bucket.samples > 0 && time != bucketTime)) {
+                // This record starts a new row; flush the previous bucket first
+                if (bucket.samples > 0) {
+                    callback(bucket.average(bucketTime), bucket.samples, context);
+                    stats.rows++;
+                    bucket.samples = 0;
+                }
+                if (stats.rows == maxRows) {
+                    stats.truncated = true;
+                    stats.next = time;
+                    done = true;
+                    break;
+                }
+            }
+            bucketTime = time;
+            bucket.add(record);
+        }
+    }
+
+    if (!stats.truncated && bucket.samples > 0) {
+        if (stats.rows < maxRows) {
+            callback(bucket.average(bucketTime), bucket.samples, context);
+            stats.rows++;
+        } else {
+            stats.truncated = true;
+            stats.next = bucketTime;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-memory history of meter readings, served by /api/readings.
+// Records live in a ring (in PSRAM when the board has it) that is split
+// into blocks of READING_HISTORY_BLOCK records. A sparse index keeps the
+// time of the first record in each block, so a range query binary-searches
+// the index and then only reads the blocks inside the range.
+// No Arduino dependencies, so it also builds on the host (see
+// tools/history_bench.cpp).
+
+#ifndef READING_HISTORY_BLOCK
+#define READING_HISTORY_BLOCK 64  // Records per index entry
+#endif
+
+#ifndef READING_HISTORY_CAPACITY_PSRAM
+#define READING_HISTORY_CAPACITY_PSRAM 65536  // 3 MB; a week at 10 s, 18 h at 1 s
+#endif
+
+#ifndef READING_HISTORY_CAPACITY_INTERNAL
+#define READING_HISTORY_CAPACITY_INTERNAL 384  // 18 KB; about an hour at 10 s
+#endif
+
+struct ReadingRecord {
+    uint32_t time;           // Epoch seconds
+    float importKwh;         // Cumulative; downsampled rows keep the last value
+    float powerKw;           // Others are averaged when downsampling
+    float phasePowerKw[3];
+    float voltage[3];
+    float current[3];
+};
+static_assert(sizeof(ReadingRecord) == 48, "ReadingRecord layout changed");
+
+struct ReadingQueryStats {
+    uint32_t indexProbes;    // Index entries compared to find the start
+    uint32_t recordsRead;    // Records copied out of the ring
+    uint32_t rows;           // Rows passed to the callback
+    bool truncated;          // Stopped at maxRows; continue from `next`
+    uint32_t next;
+};
+
+// Receives each output row; `samples` is the number of records merged into it
+typedef void (*ReadingRowCallback)(const ReadingRecord& row, uint32_t samples, void* context);
+
+class ReadingHistory {
+public:
+    ReadingHistory();
+
+    // Allocate `capacity` records, rounded up to whole blocks. Tries PSRAM
+    // first when `preferPsram` is set. May be called once.
+    bool begin(size_t capacity, bool preferPsram = true);
+
+    // Store a record. Times must not go backwards; such records are dropped.
+    // `provisional` marks a record timed by the clock restored at boot,
+    // before SNTP. Those are all taken before the first sync, so they are
+    // kept as one run of sequence numbers rather than a flag per record.
+    bool append(const ReadingRecord& record, bool provisional = false);
+
+    // Move the provisional records onto SNTP time by adding `deltaSeconds`
+    // (the step applied at the sync) and mark them final. Call before
+    // appending records taken after the sync. Returns the records changed.
+    size_t correctProvisional(int64_t deltaSeconds);
+    size_t provisionalCount();
+
+    // Rows with from <= time <= to. With step > 0, records are merged into
+    // buckets of `step` seconds starting at `from`; with step 0 every record
+    // is a row. The callback runs without the history locked, so it may
+    // write to the network.
+    ReadingQueryStats query(uint32_t from, uint32_t to, uint32_t step, size_t maxRows,
+                            ReadingRowCallback callback, void* context);
+
+    size_t capacity() const { return _capacity; }
+    size_t size();
+    uint32_t oldestTime();
+    uint32_t newestTime();
+    bool inPsram() const { return _inPsram; }
+
+private:
+    static const size_t COPY_CHUNK = 16;  // Records copied per lock
+
+    // Call with the lock held
+    uint64_t oldestSeq() const;
+    uint64_t findSeq(uint32_t time, uint32_t& probes) const;
+    size_t copyRecords(uint64_t& seq, ReadingRecord* out, size_t max);
+
+    void lock();
+    void unlock();
+
+    ReadingRecord* _records = nullptr;
+    uint32_t* _blockFirst = nullptr;  // Time of the record at each block's first slot
+    size_t _capacity = 0;
+    uint64_t _appended = 0;           // Sequence number of the next record
+    uint64_t _provisionalStart = 0;   // Uncorrected provisional records are
+    uint64_t _provisionalEnd = 0;     // [_provisionalStart, _provisionalEnd)
+    bool _inPsram = false;
+    void* _lock = nullptr;
+};
+
+extern ReadingHistory readingHistory;
@@ -0,0 +1,88 @@
+#include "request_arena.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+RequestArena requestArena;
+
+static size_t alignUp(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+void* RequestArena::allocate(size_t size) {
+    size_t aligned = alignUp(size);
+    if (aligned < size || aligned > REQUEST_ARENA_SIZE - _used) {
+        _failures++;
+        return nullptr;
+    }
+    _last = _used;
+    _used += aligned;
+    if (_used > _peak) {
+        _peak = _used;
+    }
+    return _buffer + _last;
+}
+
+void* RequestArena::reallocate(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+        return allocate(size);
+    }
+    size_t offset = (uint8_t*)ptr - _buffer;
+    if (offset == _last) {
+        // Most recent block: move the top instead of copying
+        size_t aligned = alignUp(size);
+        if (aligned < size || aligned > REQUEST_ARENA_SIZE - _last) {
+            _failures++;
+            return nullptr;
+        }
+        _used = _last + aligned;
+        if (_used > _peak) {
+            _peak = _used;
+        }
+        return ptr;
+    }
+    // The old block's size isn't stored; everything up to the top is readable
+    size_t readable = _used - offset;
+    void* block = allocate(size);
+    if (block != nullptr) {
+        memcpy(block, ptr, readable < size ? readable : size);
+    }
+    return block;
+}
+
+char* RequestArena::copy(const char* text, size_t length) {
+    char* out = (char*)allocate(length + 1);
+    if (out != nullptr) {
+        memcpy(out, text, length);
+        out[length] = '\0';
+    }
+    return out;
+}
+
+char* RequestArena::format(const char* fmt, ...) {
+    // Write straight into the free space, then keep only what was used
+    char* out = (char*)_buffer + _used;
+    size_t space = available();
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(out, space, fmt, args);
+    va_end(args);
+    if (length < 0 || (size_t)length >= space) {
+        _failures++;
+        return nullptr;
+    }
+    return (char*)allocate(length + 1);
+}
+
+void RequestArena::rewind(size_t mark) {
+    if (mark < _used) {
+        _used = mark;
+        _last = mark;
+    }
+}
+
+void RequestArena::reset() {
+    _used = 0;
+    _last = 0;
+    _peak = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// Per-request bump allocator for endpoint handlers.
+// Handlers' JSON documents and intermediate strings are carved out of
+// one static buffer instead of the loop stack or the heap. EndpointMapper::route
+// rewinds it after every response, so nothing is ever freed piecemeal and
+// the heap isn't fragmented by per-request allocations. The peak use of
+// each endpoint is exported through /api/metrics to size the buffer.
+
+#ifndef REQUEST_ARENA_SIZE
+#define REQUEST_ARENA_SIZE 4096  // Fits a full /api/crypto/sign batch
+#endif
+
+class RequestArena {
+public:
+    // 4-byte aligned block, or nullptr (counted as a failure) when the
+    // arena is full. Never falls back to the heap.
+    void* allocate(size_t size);
+
+    // Grows or shrinks the most recent allocation in place; anything else
+    // is copied into a new block
+    void* reallocate(void* ptr, size_t size);
+
+    // Copy of `length` bytes of `text`, NUL-terminated
+    char* copy(const char* text, size_t length);
+
+    // printf into the arena; nullptr if it doesn't fit
+    char* format(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    // Free everything allocated after `mark()`, for scratch space that is
+    // reused per item in a loop
+    size_t mark() const { return _used; }
+    void rewind(size_t mark);
+
+    // Drop everything. O(1); called by EndpointMapper::route with the route
+    // lock held, so handlers must not keep pointers past their response.
+    void reset();
+
+    size_t used() const { return _used; }
+    size_t available() const { return REQUEST_ARENA_SIZE - _used; }
+    size_t peak() const { return _peak; }  // Since the last reset
+    uint32_t failures() const { return _failures; }  // Since boot
+
+private:
+    alignas(8) uint8_t _buffer[REQUEST_ARENA_SIZE];
+    size_t _used = 0;
+    size_t _last = 0;   // Offset of the most recent allocation
+    size_t _peak = 0;
+    uint32_t _failures = 0;
+};
+
+extern RequestArena requestArena;
+
+// ArduinoJson allocator backed by the request arena. Deallocation is a no-op;
+// the memory comes back when the request ends.
+struct RequestArenaAllocator {
+    void* allocate(size_t size) { return requestArena.allocate(size); }
+    void deallocate(void*) {}
+    void* reallocate(void* ptr, size_t size) { return requestArena.reallocate(ptr, size); }
+};
+
+typedef BasicJsonDocument<RequestArenaAllocator> ArenaJsonDocument;
+
+// Capacity for parsing a request body of `length` bytes: strings are copied
+// out of the (read-only) body, plus room for `members` object/array slots
+inline size_t arenaJsonCapacity(size_t length, size_t members = 8) {
+    return JSON_OBJECT_SIZE(members) + length + 1;
+}
@@ -0,0 +1,99 @@
+#include "response_cache.h"
+#include <atomic>
+#include "esp_timer.h"
+
+static constexpr size_t SLOT_COUNT = (size_t)CacheSlot::COUNT;
+
+// Events each slot depends on
+static constexpr uint32_t SLOT_DEPENDENCIES[SLOT_COUNT] = {
+    0,                                             // CRYPTO_INFO: device id and key only
+    CACHE_EVENT_WIFI | CACHE_EVENT_PROVISIONING,   // SYSTEM_INFO_STATIC: wifiStatus, localIP, ssid
+};
+
+static CachedResponse entries[SLOT_COUNT];
+
+// Bit per slot; set = needs rebuild. Starts with everything stale.
+static std::atomic<uint32_t> staleSlots((1u << SLOT_COUNT) - 1);
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+static uint64_t savedUs = 0;
+
+static uint32_t fnv1a(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void responseCacheInvalidate(uint32_t events) {
+    uint32_t slots = 0;
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        if (events == CACHE_EVENT_ALL || (SLOT_DEPENDENCIES[i] & events)) {
+            slots |= 1u << i;
+        }
+    }
+    staleSlots.fetch_or(slots);
+}
+
+const CachedResponse& responseCacheFetch(CacheSlot slot, CacheBuilder build) {
+    size_t index = (size_t)slot;
+    CachedResponse& entry = entries[index];
+    uint32_t bit = 1u << index;
+
+    // Clear the stale bit before rebuilding so an event arriving during the
+    // build marks the entry stale again
+    if ((staleSlots.fetch_and(~bit) & bit) == 0) {
+        portENTER_CRITICAL(&statsMux);
+        hits++;
+        savedUs += entry.buildUs;
+        portEXIT_CRITICAL(&statsMux);
+        return entry;
+    }
+
+    portENTER_CRITICAL(&statsMux);
+    misses++;
+    portEXIT_CRITICAL(&statsMux);
+    int64_t start = esp_timer_get_time();
+    BufferResponseSink sink;
+    build(sink);
+    entry.body = sink.body();
+    entry.buildUs = (uint32_t)(esp_timer_get_time() - start);
+    snprintf(entry.etag, sizeof(entry.etag), "\"%08x\"",
+             (unsigned)fnv1a(entry.body.c_str(), entry.body.length()));
+    return entry;
+}
+
+static bool etagMatches(const String& ifNoneMatch, const char* etag) {
+    if (ifNoneMatch.length() == 0) {
+        return false;
+    }
+    // "*", a single tag, a list of tags, or weak (W/) tags all contain the quoted value
+    return ifNoneMatch == "*" || strstr(ifNoneMatch.c_str(), etag) != nullptr;
+}
+
+void responseCacheServe(const EndpointRequest& request, ResponseSink& response,
+                        CacheSlot slot, CacheBuilder build) {
+    const CachedResponse& entry = responseCacheFetch(slot, build);
+    response.addHeader("ETag", entry.etag);
+    response.addHeader("Cache-Control", "no-cache");  // Always revalidate
+
+    if (etagMatches(request.ifNoneMatch, entry.etag)) {
+        response.begin(304, "application/json", 0);
+        return;
+    }
+    response.begin(200, "application/json", entry.body.length());
+    response.write(entry.body);
+}
+
+ResponseCacheStats responseCacheStats() {
+    ResponseCacheStats stats;
+    portENTER_CRITICAL(&statsMux);
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.savedUs = savedUs;
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
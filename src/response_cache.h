@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include "endpoints.h"
+#include "response_sink.h"
+
+// Cache of serialized responses for endpoints whose data almost never
+// changes. Entries are rebuilt lazily after one of the state-change events
+// they depend on has been signalled.
+
+// Invalidation events, combinable as a bitmask
+enum CacheEvent : uint32_t {
+    CACHE_EVENT_WIFI = 1u << 0,          // Station connected or disconnected
+    CACHE_EVENT_PROVISIONING = 1u << 1,  // Credentials configured or reset
+    CACHE_EVENT_ALL = 0xFFFFFFFFu
+};
+
+enum class CacheSlot : uint8_t {
+    CRYPTO_INFO,         // Complete /api/crypto body
+    SYSTEM_INFO_STATIC,  // Unterminated object prefix of /api/system/info
+    COUNT
+};
+
+struct CachedResponse {
+    String body;
+    char etag[11];     // Quoted hex hash of the body, e.g. "\"1a2b3c4d\""
+    uint32_t buildUs;  // Time the last rebuild took
+};
+
+struct ResponseCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint64_t savedUs;  // Build time skipped thanks to hits
+};
+
+// Writes the cacheable part of a response into the sink
+typedef void (*CacheBuilder)(ResponseSink& sink);
+
+// Mark every entry depending on one of the events as stale. Safe to call
+// from any task, including WiFi event callbacks.
+void responseCacheInvalidate(uint32_t events);
+
+// Return the cached entry, rebuilding it first if it is missing or stale
+const CachedResponse& responseCacheFetch(CacheSlot slot, CacheBuilder build);
+
+// Serve a complete cached body with an ETag, answering 304 when the
+// request's If-None-Match already names it
+void responseCacheServe(const EndpointRequest& request, ResponseSink& response,
+                        CacheSlot slot, CacheBuilder build);
+
+ResponseCacheStats responseCacheStats();
@@ -0,0 +1,162 @@
+#include "response_sink.h"
+
+void ResponseSink::send(int statusCode, const char* contentType, const char* body) {
+    size_t length = strlen(body);
+    begin(statusCode, contentType, length);
+    write(body, length);
+}
+
+// Messages are literals and never need JSON escaping
+void ResponseSink::sendError(int statusCode, const char* message) {
+    begin(statusCode, "application/json");
+    write("{\"status\":\"error\",\"message\":\"");
+    write(message);
+    write("\"}");
+}
+
+void ResponseSink::sendSuccess(const char* message) {
+    begin(200, "application/json");
+    write("{\"status\":\"success\",\"message\":\"");
+    write(message);
+    write("\"}");
+}
+
+// --- HttpResponseSink ---
+
+void HttpResponseSink::addHeader(const char* name, const char* value) {
+    if (!_headersSent) {
+        _server.sendHeader(name, value);
+    }
+}
+
+void HttpResponseSink::begin(int statusCode, const char* contentType, size_t length) {
+    if (_begun) {
+        return;
+    }
+    _begun = true;
+    _statusCode = statusCode;
+    _contentType = contentType;
+    _declaredLength = length;
+}
+
+// Headers are sent lazily so that a body that fits the buffer can still be
+// sent with an exact Content-Length instead of chunked encoding
+void HttpResponseSink::sendHeaders(size_t length) {
+    if (length == UNKNOWN_LENGTH) {
+        _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        _chunked = true;
+    } else {
+        _server.setContentLength(length);
+    }
+    _server.send(_statusCode, _contentType, "");
+    _headersSent = true;
+}
+
+void HttpResponseSink::flush() {
+    if (_used == 0) {
+        return;
+    }
+    if (!_headersSent) {
+        sendHeaders(_declaredLength);
+    }
+    _server.sendContent(_buffer, _used);
+    _used = 0;
+}
+
+size_t HttpResponseSink::write(const char* data, size_t length) {
+    if (!_begun) {
+        begin(200, "application/json");
+    }
+
+    // Large writes of a known-length body go straight to the client
+    if (length >= BUFFER_SIZE && (_headersSent || _declaredLength != UNKNOWN_LENGTH)) {
+        flush();
+        if (!_headersSent) {
+            sendHeaders(_declaredLength);
+        }
+        _server.sendContent(data, length);
+        return length;
+    }
+
+    size_t written = 0;
+    while (written < length) {
+        size_t space = BUFFER_SIZE - _used;
+        size_t chunk = length - written < space ? length - written : space;
+        memcpy(_buffer + _used, data + written, chunk);
+        _used += chunk;
+        written += chunk;
+        if (_used == BUFFER_SIZE) {
+            flush();
+        }
+    }
+    return written;
+}
+
+void HttpResponseSink::end() {
+    if (_detached) {
+        return;
+    }
+    if (!_begun) {
+        sendError(500, "No response");
+    }
+    if (!_headersSent) {
+        // Everything is still buffered, so the exact length is known
+        sendHeaders(_used);
+    }
+    if (_used > 0) {
+        _server.sendContent(_buffer, _used);
+        _used = 0;
+    }
+    if (_chunked) {
+        _server.sendContent("", 0);  // Terminating chunk
+        _chunked = false;
+    }
+}
+
+bool HttpResponseSink::detach(DetachedSocket& socket) {
+    if (_begun) {
+        return false;
+    }
+    // The WebServer drops its own copy of the client once it gives up
+    // waiting for the next request; ours keeps the socket open
+    socket.owner = _server.client();
+    socket.fd = socket.owner.fd();
+    if (socket.fd < 0) {
+        socket.owner = WiFiClient();
+        return false;
+    }
+    _begun = true;
+    _statusCode = 200;
+    _detached = true;
+    return true;
+}
+
+// --- BufferResponseSink ---
+
+void BufferResponseSink::begin(int statusCode, const char* contentType, size_t length) {
+    if (_begun) {
+        return;
+    }
+    _begun = true;
+    _statusCode = statusCode;
+    _contentType = contentType;
+    if (length != UNKNOWN_LENGTH) {
+        _body.reserve(length);
+    }
+}
+
+size_t BufferResponseSink::write(const char* data, size_t length) {
+    if (!_begun) {
+        begin(200, "application/json");
+    }
+    if (!_body.concat(data, length)) {
+        return 0;
+    }
+    return length;
+}
+
+void BufferResponseSink::end() {
+    if (!_begun) {
+        sendError(500, "No response");
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+// Connection handed over by a sink for a long-lived stream. `owner` keeps a
+// WebServer client's socket open (its last copy closes it); it is empty for
+// raw sockets, which the new holder closes itself.
+struct DetachedSocket {
+    int fd = -1;
+    WiFiClient owner;
+};
+
+// Destination for an endpoint response. Handlers write their body straight
+// into the sink instead of returning it by value, so the transport decides
+// how it is buffered: streamed to the WebServer client, or collected for
+// the BLE characteristic.
+class ResponseSink {
+public:
+    static const size_t UNKNOWN_LENGTH = (size_t)-1;
+
+    virtual ~ResponseSink() {}
+
+    // Extra response header; only valid before begin()
+    virtual void addHeader(const char* name, const char* value) {}
+
+    // Start the response. Pass the body length if known.
+    virtual void begin(int statusCode, const char* contentType, size_t length = UNKNOWN_LENGTH) = 0;
+
+    virtual size_t write(const char* data, size_t length) = 0;
+    size_t write(const char* text) { return write(text, strlen(text)); }
+    size_t write(const String& text) { return write(text.c_str(), text.length()); }
+
+    // Finish the response. Called by the transport after the handler returns.
+    virtual void end() = 0;
+
+    // Hand the connection to a long-lived stream (see event_stream.h) instead
+    // of sending a response. The holder writes the status line and headers
+    // itself. False if a response was already begun or the transport has no
+    // socket (BLE).
+    virtual bool detach(DetachedSocket& socket) { return false; }
+
+    // Send a complete response in one call
+    void send(int statusCode, const char* contentType, const char* body);
+    // {"status":"error","message":"..."} / {"status":"success","message":"..."}
+    void sendError(int statusCode, const char* message);
+    void sendSuccess(const char* message);
+
+    bool begun() const { return _begun; }
+    int statusCode() const { return _statusCode; }
+
+protected:
+    bool _begun = false;
+    int _statusCode = 0;
+};
+
+// Streams the response to the current WebServer client. Small bodies are
+// sent with a Content-Length; once the buffer fills up the rest is sent
+// with chunked encoding.
+class HttpResponseSink : public ResponseSink {
+public:
+    explicit HttpResponseSink(WebServer& server) : _server(server) {}
+
+    void addHeader(const char* name, const char* value) override;
+    void begin(int statusCode, const char* contentType, size_t length = UNKNOWN_LENGTH) override;
+    size_t write(const char* data, size_t length) override;
+    using ResponseSink::write;
+    void end() override;
+    bool detach(DetachedSocket& socket) override;
+
+private:
+    static const size_t BUFFER_SIZE = 512;
+
+    void sendHeaders(size_t length);
+    void flush();
+
+    WebServer& _server;
+    const char* _contentType = nullptr;
+    size_t _declaredLength = UNKNOWN_LENGTH;
+    bool _headersSent = false;
+    bool _chunked = false;
+    bool _detached = false;
+    char _buffer[BUFFER_SIZE];
+    size_t _used = 0;
+};
+
+// Collects the body in memory, e.g. for the BLE transport which needs the
+// complete body to frame and page it
+class BufferResponseSink : public ResponseSink {
+public:
+    void begin(int statusCode, const char* contentType, size_t length = UNKNOWN_LENGTH) override;
+    size_t write(const char* data, size_t length) override;
+    using ResponseSink::write;
+    void end() override;
+
+    const String& body() const { return _body; }
+    const char* contentType() const { return _contentType; }
+
+private:
+    String _body;
+    const char* _contentType = "";
+};
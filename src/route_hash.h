@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Compile-time perfect hash over (method, path), used for the route table
+// in endpoint_mapper.cpp. Entries are any struct with `path` (const char*)
+// and `method` (an enum) members. No Arduino dependencies, so it also
+// builds on the host (see tools/route_bench.cpp).
+
+static constexpr uint32_t ROUTE_FNV_OFFSET = 2166136261u;
+static constexpr uint32_t ROUTE_FNV_PRIME = 16777619u;
+
+// FNV-1a over the method and the path
+static constexpr uint32_t routeHash(uint32_t method, const char* path, size_t length) {
+    uint32_t hash = ROUTE_FNV_OFFSET;
+    hash = (hash ^ method) * ROUTE_FNV_PRIME;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)path[i]) * ROUTE_FNV_PRIME;
+    }
+    return hash;
+}
+
+static constexpr size_t constLength(const char* s) {
+    size_t length = 0;
+    while (s[length] != '\0') {
+        length++;
+    }
+    return length;
+}
+
+// Final mix (murmur3 fmix32); FNV's low bits alone pick slots poorly
+static constexpr uint32_t routeMix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Slot of a key with hash `hash` in a bucket with displacement `displacement`
+static constexpr uint32_t routeSlot(uint32_t hash, uint16_t displacement) {
+    return routeMix(hash ^ (0x9e3779b9u * (displacement + 1u)));
+}
+
+// Power of two with at least 4 slots per route
+static constexpr size_t hashTableSize(size_t routes) {
+    size_t size = 16;
+    while (size < routes * 4) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Power of two with about 2 routes per bucket
+static constexpr size_t hashBucketCount(size_t routes) {
+    size_t count = 4;
+    while (count * 2 < routes) {
+        count *= 2;
+    }
+    return count;
+}
+
+// Hash and displace: keys are split into buckets by hash, and each bucket
+// gets the first displacement that puts all its keys in free slots. A
+// single seed for the whole table would need ever more slots per route as
+// the table grows (the birthday bound); per-bucket displacements don't.
+template <size_t Buckets, size_t Slots>
+struct RouteHashTable {
+    bool ok;                         // False if some bucket found no displacement
+    uint16_t displacement[Buckets];
+    uint8_t slots[Slots];            // Entry index + 1, 0 = empty
+};
+
+template <size_t Buckets, size_t Slots, typename Entry, size_t Count>
+constexpr RouteHashTable<Buckets, Slots> buildRouteHashTable(const Entry (&entries)[Count]) {
+    static_assert(Count < 255, "Entry indexes are stored in uint8_t");
+    RouteHashTable<Buckets, Slots> table = {};
+    uint32_t hashes[Count] = {};
+    size_t sizes[Buckets] = {};
+    for (size_t i = 0; i < Count; i++) {
+        hashes[i] = routeHash((uint32_t)entries[i].method, entries[i].path, constLength(entries[i].path));
+        sizes[routeMix(hashes[i]) & (Buckets - 1)]++;
+    }
+
+    // Largest buckets first, while the table is emptiest
+    for (size_t size = Count; size > 0; size--) {
+        for (size_t bucket = 0; bucket < Buckets; bucket++) {
+            if (sizes[bucket] != size) {
+                continue;
+            }
+            bool placed = false;
+            for (uint32_t displacement = 0; displacement < 65536 && !placed; displacement++) {
+                // Claim the slots of the bucket's keys; release them on a clash
+                placed = true;
+                for (size_t i = 0; i < Count && placed; i++) {
+                    if ((routeMix(hashes[i]) & (Buckets - 1)) != bucket) {
+                        continue;
+                    }
+                    size_t slot = routeSlot(hashes[i], (uint16_t)displacement) & (Slots - 1);
+                    if (table.slots[slot] != 0) {
+                        placed = false;
+                        for (size_t j = 0; j < i; j++) {
+                            if ((routeMix(hashes[j]) & (Buckets - 1)) == bucket) {
+                                table.slots[routeSlot(hashes[j], (uint16_t)displacement) & (Slots - 1)] = 0;
+                            }
+                        }
+                    } else {
+                        table.slots[slot] = (uint8_t)(i + 1);
+                    }
+                }
+                if (placed) {
+                    table.displacement[bucket] = (uint16_t)displacement;
+                }
+            }
+            if (!placed) {
+                return table;  // ok stays false
+            }
+        }
+    }
+    table.ok = true;
+    return table;
+}
+
+// The entry for exactly (method, path[0..length)), or nullptr
+template <size_t Buckets, size_t Slots, typename Entry>
+const Entry* routeHashFind(const RouteHashTable<Buckets, Slots>& table, const Entry* entries, uint32_t method,
+                           const char* path, size_t length) {
+    uint32_t hash = routeHash(method, path, length);
+    uint16_t displacement = table.displacement[routeMix(hash) & (Buckets - 1)];
+    uint8_t index = table.slots[routeSlot(hash, displacement) & (Slots - 1)];
+    if (index == 0) {
+        return nullptr;
+    }
+    // The hash is only perfect for known keys; confirm the match
+    const Entry* entry = &entries[index - 1];
+    if ((uint32_t)entry->method == method && strncmp(entry->path, path, length) == 0 && entry->path[length] == '\0') {
+        return entry;
+    }
+    return nullptr;
+}
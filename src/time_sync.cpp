@@ -0,0 +1,187 @@
+#include "time_sync.h"
+#include <Preferences.h>
+#include <sys/time.h>
+#include <time.h>
+#include "esp_sntp.h"
+#include "esp_timer.h"
+
+#define TIME_SYNC_NAMESPACE "timesync"
+
+// Drift is only estimated from syncs at least this far apart
+#define MIN_DRIFT_INTERVAL_MS (10LL * 60LL * 1000LL)
+// Assumed crystal tolerance until a drift estimate exists
+#define DEFAULT_DRIFT_PPM 50.0f
+// Error of a single SNTP sample over WiFi
+#define SNTP_SAMPLE_ERROR_MS 50
+
+static portMUX_TYPE syncMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile TimeSyncState currentState = TimeSyncState::UNSYNCED;
+
+// The local clock is expected to read baseEpochMs at baseMonotonicUs. Any
+// difference seen at an SNTP sync is the step (first sync) or drift (later).
+static long long baseEpochMs = 0;
+static int64_t baseMonotonicUs = 0;
+
+static time_t lastSyncEpoch = 0;
+static int64_t lastSyncMonotonicUs = 0;
+static float driftPpm = 0.0f;
+static bool driftKnown = false;
+static long long correctionMs = 0;
+static uint32_t syncCount = 0;
+static volatile bool persistDue = false;
+static unsigned long lastCheckpoint = 0;
+
+static void persistCheckpoint() {
+    time_t now = time(nullptr);
+    Preferences prefs;
+    if (!prefs.begin(TIME_SYNC_NAMESPACE, false)) {
+        return;
+    }
+    prefs.putLong64("checkpoint", (int64_t)now);
+    portENTER_CRITICAL(&syncMux);
+    float drift = driftPpm;
+    bool known = driftKnown;
+    portEXIT_CRITICAL(&syncMux);
+    if (known) {
+        prefs.putFloat("drift", drift);
+    }
+    prefs.end();
+}
+
+// Called from the SNTP (lwIP) task after the clock has been set
+static void onTimeSync(struct timeval* tv) {
+    long long actualMs = (long long)tv->tv_sec * 1000LL + tv->tv_usec / 1000;
+    int64_t nowUs = esp_timer_get_time();
+
+    portENTER_CRITICAL(&syncMux);
+    long long predictedMs = baseEpochMs + (nowUs - baseMonotonicUs) / 1000;
+    long long stepMs = actualMs - predictedMs;
+
+    if (currentState != TimeSyncState::SYNCED) {
+        // First sync of this boot: remember the step for correcting earlier timestamps
+        correctionMs = stepMs;
+    } else {
+        long long elapsedMs = (nowUs - lastSyncMonotonicUs) / 1000;
+        if (elapsedMs >= MIN_DRIFT_INTERVAL_MS) {
+            float sample = (float)stepMs * 1e6f / (float)elapsedMs;
+            driftPpm = driftKnown ? driftPpm * 0.7f + sample * 0.3f : sample;
+            driftKnown = true;
+        }
+    }
+
+    baseEpochMs = actualMs;
+    baseMonotonicUs = nowUs;
+    lastSyncEpoch = tv->tv_sec;
+    lastSyncMonotonicUs = nowUs;
+    syncCount++;
+    currentState = TimeSyncState::SYNCED;
+    portEXIT_CRITICAL(&syncMux);
+
+    persistDue = true;
+}
+
+void timeSyncInit() {
+    Preferences prefs;
+    time_t checkpoint = 0;
+    if (prefs.begin(TIME_SYNC_NAMESPACE, true)) {
+        checkpoint = (time_t)prefs.getLong64("checkpoint", 0);
+        if (prefs.isKey("drift")) {
+            driftPpm = prefs.getFloat("drift", 0.0f);
+            driftKnown = true;
+        }
+        prefs.end();
+    }
+
+    int64_t nowUs = esp_timer_get_time();
+    if (checkpoint > 0 && time(nullptr) < checkpoint) {
+        struct timeval tv = { checkpoint, 0 };
+        settimeofday(&tv, nullptr);
+        portENTER_CRITICAL(&syncMux);
+        baseEpochMs = (long long)checkpoint * 1000LL;
+        baseMonotonicUs = nowUs;
+        currentState = TimeSyncState::PROVISIONAL;
+        portEXIT_CRITICAL(&syncMux);
+        Serial.printf("Time: provisional clock from checkpoint %ld\n", (long)checkpoint);
+    } else {
+        // The clock starts at 0 together with the monotonic timer
+        portENTER_CRITICAL(&syncMux);
+        baseEpochMs = 0;
+        baseMonotonicUs = 0;
+        portEXIT_CRITICAL(&syncMux);
+    }
+
+    sntp_set_time_sync_notification_cb(onTimeSync);
+}
+
+void timeSyncStart() {
+    // configTime only starts the SNTP client; the result arrives in onTimeSync
+    configTime(0, 0, NTP_SERVER_1, NTP_SERVER_2);  // 0, 0 = UTC, no daylight offset
+}
+
+void timeSyncLoop() {
+    if (persistDue) {
+        persistDue = false;
+        lastCheckpoint = millis();
+        persistCheckpoint();
+        TimeSyncStatus status = timeSyncStatus();
+        Serial.printf("Time: SNTP sync #%u, step %lld ms, drift %.1f ppm\n",
+                      status.syncCount, status.correctionMs, status.driftPpm);
+        return;
+    }
+
+    if (currentState != TimeSyncState::UNSYNCED &&
+        millis() - lastCheckpoint >= TIME_CHECKPOINT_INTERVAL_MS) {
+        lastCheckpoint = millis();
+        persistCheckpoint();
+    }
+}
+
+TimeSyncState timeSyncState() {
+    return currentState;
+}
+
+TimeSyncStatus timeSyncStatus() {
+    TimeSyncStatus status;
+    int64_t nowUs = esp_timer_get_time();
+
+    portENTER_CRITICAL(&syncMux);
+    status.state = currentState;
+    status.lastSyncEpoch = lastSyncEpoch;
+    status.driftPpm = driftPpm;
+    status.correctionMs = correctionMs;
+    status.syncCount = syncCount;
+    float drift = driftKnown ? fabsf(driftPpm) : DEFAULT_DRIFT_PPM;
+    int64_t sinceSyncMs = (nowUs - lastSyncMonotonicUs) / 1000;
+    portEXIT_CRITICAL(&syncMux);
+
+    if (status.state == TimeSyncState::SYNCED) {
+        status.estimatedErrorMs = SNTP_SAMPLE_ERROR_MS + (long)((float)sinceSyncMs * drift / 1e6f);
+    } else {
+        status.estimatedErrorMs = -1;  // Unknown time spent powered off
+    }
+    return status;
+}
+
+const char* timeSyncStateName(TimeSyncState state) {
+    switch (state) {
+        case TimeSyncState::PROVISIONAL: return "provisional";
+        case TimeSyncState::SYNCED: return "synced";
+        default: return "unsynced";
+    }
+}
+
+unsigned long long timeSyncCorrect(unsigned long long timestampMs, TimeSyncState takenIn) {
+    if (takenIn == TimeSyncState::SYNCED) {
+        return timestampMs;
+    }
+    portENTER_CRITICAL(&syncMux);
+    bool synced = currentState == TimeSyncState::SYNCED;
+    long long correction = correctionMs;
+    portEXIT_CRITICAL(&syncMux);
+
+    if (!synced) {
+        return timestampMs;
+    }
+    long long corrected = (long long)timestampMs + correction;
+    return corrected > 0 ? (unsigned long long)corrected : 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Background SNTP time synchronization.
+// The last known time and the estimated oscillator drift are persisted in
+// NVS. After a reboot the clock is set provisionally from the last
+// checkpoint so readings get plausible timestamps right away; once SNTP
+// converges, timestamps taken before the sync can be corrected with
+// timeSyncCorrect().
+
+#ifndef NTP_SERVER_1
+#define NTP_SERVER_1 "pool.ntp.org"
+#endif
+
+#ifndef NTP_SERVER_2
+#define NTP_SERVER_2 "time.nist.gov"
+#endif
+
+#ifndef TIME_CHECKPOINT_INTERVAL_MS
+#define TIME_CHECKPOINT_INTERVAL_MS (15UL * 60UL * 1000UL)
+#endif
+
+enum class TimeSyncState {
+    UNSYNCED,     // No time source yet, clock counts from 1970
+    PROVISIONAL,  // Clock restored from the last NVS checkpoint
+    SYNCED        // Clock set by SNTP during this boot
+};
+
+struct TimeSyncStatus {
+    TimeSyncState state;
+    time_t lastSyncEpoch;       // Wall clock of the last SNTP sync, 0 if none
+    float driftPpm;             // Estimated oscillator drift, positive = local clock slow
+    long estimatedErrorMs;      // Estimated clock error, -1 if unbounded
+    long long correctionMs;     // Step applied at the first sync of this boot
+    uint32_t syncCount;
+};
+
+// Restore the provisional clock from NVS. Call once from setup().
+void timeSyncInit();
+
+// Start SNTP in the background. Returns immediately.
+void timeSyncStart();
+
+// Periodic NVS checkpoint of the current time. Call from loop().
+void timeSyncLoop();
+
+TimeSyncStatus timeSyncStatus();
+const char* timeSyncStateName(TimeSyncState state);
+
+// Current state, cheap enough to call per reading
+TimeSyncState timeSyncState();
+
+// Map a millisecond timestamp taken while the clock was provisional or
+// unsynced onto the SNTP time base. Timestamps taken after the sync are
+// returned unchanged.
+unsigned long long timeSyncCorrect(unsigned long long timestampMs, TimeSyncState takenIn);
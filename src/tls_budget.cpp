@@ -0,0 +1,251 @@
+#include "tls_budget.h"
+#include "esp_heap_caps.h"
+#include "mbedtls/platform.h"
+#include <freertos/FreeRTOS.h>
+
+// Each heap allocation carries a small header with its size so frees can be
+// accounted without asking the heap. 8 bytes keeps the payload 8-byte aligned.
+#define TLS_ALLOC_HEADER 8
+
+// Fixed-size slots for one kind of record buffer
+struct TlsPool {
+    uint8_t* base;
+    size_t slotSize;
+    size_t slots;
+    uint32_t inUse;  // Bitmap of used slots
+};
+
+// Outgoing first: allocations take the smallest slot they fit in
+static TlsPool pools[] = {
+    { nullptr, TLS_POOL_OUT_SLOT_SIZE, 0, 0 },
+    { nullptr, TLS_POOL_IN_SLOT_SIZE, 0, 0 },
+};
+static_assert(TLS_POOL_OUT_SLOT_SIZE <= TLS_POOL_IN_SLOT_SIZE, "pools must be ordered by slot size");
+static_assert(TLS_POOL_SLOTS_PSRAM <= 32 && TLS_POOL_IN_SLOTS_INTERNAL <= 32 && TLS_POOL_OUT_SLOTS_INTERNAL <= 32,
+              "slot use is a 32-bit bitmap");
+static bool poolInPsram = false;
+
+static portMUX_TYPE budgetMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t bytesHeld = 0;
+static uint32_t internalBytesHeld = 0;
+static int openConnections = 0;
+static TlsConnectionStats current = {};
+static TlsConnectionStats last = {};
+
+static uint32_t internalFree() {
+    return heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+// Must be called with budgetMux held
+static void noteUsageLocked() {
+    if (openConnections == 0) return;
+    if (bytesHeld > current.peakBytes) current.peakBytes = bytesHeld;
+    if (internalBytesHeld > current.peakInternalBytes) current.peakInternalBytes = internalBytesHeld;
+}
+
+static void* poolTake(TlsPool& pool) {
+    void* slot = nullptr;
+    portENTER_CRITICAL(&budgetMux);
+    for (size_t i = 0; i < pool.slots; i++) {
+        if ((pool.inUse & (1UL << i)) == 0) {
+            pool.inUse |= (1UL << i);
+            slot = pool.base + i * pool.slotSize;
+            bytesHeld += pool.slotSize;
+            noteUsageLocked();
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&budgetMux);
+    return slot;
+}
+
+static bool poolRelease(void* ptr) {
+    uint8_t* p = (uint8_t*)ptr;
+    for (TlsPool& pool : pools) {
+        if (pool.base == nullptr || p < pool.base || p >= pool.base + pool.slots * pool.slotSize) {
+            continue;
+        }
+        size_t index = (p - pool.base) / pool.slotSize;
+        portENTER_CRITICAL(&budgetMux);
+        pool.inUse &= ~(1UL << index);
+        bytesHeld -= pool.slotSize;
+        portEXIT_CRITICAL(&budgetMux);
+        return true;
+    }
+    return false;
+}
+
+// The pool with the smallest slots `size` fits in, or nullptr
+static TlsPool* poolFor(size_t size) {
+    if (size < TLS_POOL_MIN_ALLOC) {
+        return nullptr;
+    }
+    for (TlsPool& pool : pools) {
+        if (size <= pool.slotSize && pool.slots > 0) {
+            return &pool;
+        }
+    }
+    return nullptr;
+}
+
+static void* tlsCalloc(size_t count, size_t size) {
+    size_t total = count * size;
+    if (size != 0 && total / size != count) {
+        return nullptr;  // Overflow
+    }
+
+    TlsPool* pool = poolFor(total);
+    if (pool != nullptr) {
+        void* slot = poolTake(*pool);
+        if (slot != nullptr) {
+            memset(slot, 0, total);
+            return slot;
+        }
+        portENTER_CRITICAL(&budgetMux);
+        if (openConnections > 0) current.poolMisses++;
+        portEXIT_CRITICAL(&budgetMux);
+    }
+
+    // Large buffers that missed the pool still prefer PSRAM over internal heap
+    uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    if (total >= TLS_POOL_MIN_ALLOC && poolInPsram) {
+        caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    }
+    uint8_t* raw = (uint8_t*)heap_caps_calloc(1, total + TLS_ALLOC_HEADER, caps);
+    if (raw == nullptr && caps != (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) {
+        caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        raw = (uint8_t*)heap_caps_calloc(1, total + TLS_ALLOC_HEADER, caps);
+    }
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    *(uint32_t*)raw = (uint32_t)total;
+    *(uint32_t*)(raw + 4) = caps;
+
+    portENTER_CRITICAL(&budgetMux);
+    bytesHeld += total;
+    if (caps & MALLOC_CAP_INTERNAL) internalBytesHeld += total;
+    noteUsageLocked();
+    portEXIT_CRITICAL(&budgetMux);
+
+    if (caps & MALLOC_CAP_INTERNAL) {
+        uint32_t freeNow = internalFree();
+        portENTER_CRITICAL(&budgetMux);
+        if (openConnections > 0 && freeNow < current.internalFreeMin) current.internalFreeMin = freeNow;
+        portEXIT_CRITICAL(&budgetMux);
+    }
+    return raw + TLS_ALLOC_HEADER;
+}
+
+static void tlsFree(void* ptr) {
+    if (ptr == nullptr || poolRelease(ptr)) {
+        return;
+    }
+    uint8_t* raw = (uint8_t*)ptr - TLS_ALLOC_HEADER;
+    uint32_t total = *(uint32_t*)raw;
+    uint32_t caps = *(uint32_t*)(raw + 4);
+
+    portENTER_CRITICAL(&budgetMux);
+    bytesHeld -= total;
+    if (caps & MALLOC_CAP_INTERNAL) internalBytesHeld -= total;
+    portEXIT_CRITICAL(&budgetMux);
+
+    heap_caps_free(raw);
+}
+
+// Must run before the first mbedtls allocation: blocks allocated by the
+// default allocator carry no header and cannot be released through tlsFree.
+void tlsBudgetInit() {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
+    // PSRAM if the board has it, otherwise internal RAM, only if configured
+    size_t slots[] = { TLS_POOL_OUT_SLOTS_INTERNAL, TLS_POOL_IN_SLOTS_INTERNAL };
+    uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    if (psramFound()) {
+        slots[0] = slots[1] = TLS_POOL_SLOTS_PSRAM;
+        caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        poolInPsram = true;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        if (slots[i] == 0) {
+            continue;
+        }
+        pools[i].base = (uint8_t*)heap_caps_malloc(slots[i] * pools[i].slotSize, caps);
+        if (pools[i].base == nullptr) {
+            Serial.printf("TLS budget: failed to reserve %u byte slots, using heap\n", (unsigned)pools[i].slotSize);
+            continue;
+        }
+        pools[i].slots = slots[i];
+    }
+    if (pools[0].slots == 0 && pools[1].slots == 0) {
+        poolInPsram = false;
+    }
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+    mbedtls_platform_set_calloc_free(tlsCalloc, tlsFree);
+    if (pools[0].slots == 0 && pools[1].slots == 0) {
+        Serial.println("TLS budget: no pools, record buffers come from the heap");
+    } else {
+        Serial.printf("TLS budget: %u x %u + %u x %u byte pools in %s\n", (unsigned)pools[0].slots,
+                      (unsigned)pools[0].slotSize, (unsigned)pools[1].slots, (unsigned)pools[1].slotSize,
+                      poolInPsram ? "PSRAM" : "internal RAM");
+    }
+#else
+    Serial.println("TLS budget: mbedtls allocator is fixed at build time, pools released");
+    for (TlsPool& pool : pools) {
+        heap_caps_free(pool.base);
+        pool = { nullptr, pool.slotSize, 0, 0 };
+    }
+    poolInPsram = false;
+#endif
+}
+
+void tlsBudgetBeginConnection() {
+    uint32_t freeNow = internalFree();
+    portENTER_CRITICAL(&budgetMux);
+    if (openConnections++ == 0) {
+        current = {};
+        current.internalFreeBefore = freeNow;
+        current.internalFreeMin = freeNow;
+        current.peakBytes = bytesHeld;
+        current.peakInternalBytes = internalBytesHeld;
+    }
+    portEXIT_CRITICAL(&budgetMux);
+}
+
+void tlsBudgetEndConnection(const char* label) {
+    uint32_t freeNow = internalFree();
+    bool report = false;
+    TlsConnectionStats stats;
+
+    portENTER_CRITICAL(&budgetMux);
+    if (openConnections > 0 && --openConnections == 0) {
+        current.internalFreeAfter = freeNow;
+        if (freeNow < current.internalFreeMin) current.internalFreeMin = freeNow;
+        last = current;
+        stats = current;
+        report = true;
+    }
+    portEXIT_CRITICAL(&budgetMux);
+
+    if (report) {
+        Serial.printf("TLS %s: internal free before %u, min %u, after %u; peak TLS %u bytes (%u internal), pool misses %u\n",
+                      label, stats.internalFreeBefore, stats.internalFreeMin, stats.internalFreeAfter,
+                      stats.peakBytes, stats.peakInternalBytes, stats.poolMisses);
+    }
+}
+
+TlsConnectionStats tlsBudgetLastStats() {
+    portENTER_CRITICAL(&budgetMux);
+    TlsConnectionStats stats = last;
+    portEXIT_CRITICAL(&budgetMux);
+    return stats;
+}
+
+bool tlsBudgetUsesPsram() {
+    return poolInPsram;
+}
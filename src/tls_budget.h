@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+// TLS memory budget.
+// mbedtls allocations are routed through a custom allocator that accounts
+// for every byte, so each connection window can report internal heap usage
+// and changes to the budget can be measured. On boards with PSRAM the record
+// buffers come from pools reserved there once at boot, one pool per buffer
+// kind so a 4.5 KB outgoing buffer doesn't take a 16.5 KB incoming slot;
+// everything else comes from the internal heap.
+//
+// Boards without PSRAM reserve no pool by default: the slots would hold
+// about 21 KB of internal RAM per connection from boot on, even with no
+// connection open, on boards that also run Bluedroid. The record buffers
+// are then allocated per connection, as without the budget. Set the
+// TLS_POOL_*_SLOTS_INTERNAL options to trade that memory for a guaranteed
+// buffer.
+
+// Record buffers: content length plus header, IV, MAC and padding overhead
+#ifndef TLS_POOL_IN_SLOT_SIZE
+#ifdef CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN
+#define TLS_POOL_IN_SLOT_SIZE (CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN + 512)
+#else
+#define TLS_POOL_IN_SLOT_SIZE (16 * 1024 + 512)
+#endif
+#endif
+
+#ifndef TLS_POOL_OUT_SLOT_SIZE
+#ifdef CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN
+#define TLS_POOL_OUT_SLOT_SIZE (CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN + 512)
+#else
+#define TLS_POOL_OUT_SLOT_SIZE (4 * 1024 + 512)
+#endif
+#endif
+
+#ifndef TLS_POOL_MIN_ALLOC
+#define TLS_POOL_MIN_ALLOC 4096  // Allocations at least this big are served from a pool
+#endif
+
+#ifndef TLS_POOL_SLOTS_PSRAM
+#define TLS_POOL_SLOTS_PSRAM 2   // Per buffer kind: two concurrent connections
+#endif
+
+#ifndef TLS_POOL_IN_SLOTS_INTERNAL
+#define TLS_POOL_IN_SLOTS_INTERNAL 0
+#endif
+
+#ifndef TLS_POOL_OUT_SLOTS_INTERNAL
+#define TLS_POOL_OUT_SLOTS_INTERNAL 0
+#endif
+
+struct TlsConnectionStats {
+    uint32_t internalFreeBefore;  // Internal heap free when the connection started
+    uint32_t internalFreeMin;     // Lowest internal heap free seen while it was open
+    uint32_t internalFreeAfter;   // Internal heap free after it was closed
+    uint32_t peakBytes;           // Peak bytes held by mbedtls (pool + heap)
+    uint32_t peakInternalBytes;   // Peak bytes mbedtls held on the internal heap
+    uint32_t poolMisses;          // Large allocations that did not fit in the pool
+};
+
+// Reserve the buffer pools, if any, and install the allocator. Call once,
+// before any TLS use.
+void tlsBudgetInit();
+
+// Bracket a TLS connection to collect TlsConnectionStats for it.
+void tlsBudgetBeginConnection();
+void tlsBudgetEndConnection(const char* label);
+
+// Stats of the most recently finished connection
+TlsConnectionStats tlsBudgetLastStats();
+
+// True if the pools live in PSRAM
+bool tlsBudgetUsesPsram();
@@ -0,0 +1,23 @@
+#include "web_assets.h"
+
+#if __has_include("web_assets_data.h")
+#include "web_assets_data.h"
+#else
+#error "web_assets_data.h missing: run scripts/embed_web_assets.py (PlatformIO does this before every build)"
+#endif
+
+void serveWebAsset(const EndpointRequest& request, ResponseSink& response, const WebAsset& asset) {
+    response.addHeader("ETag", asset.etag);
+    response.addHeader("Cache-Control", "no-cache");  // Always revalidate
+
+    if (request.ifNoneMatch.length() > 0 &&
+        (request.ifNoneMatch == "*" || strstr(request.ifNoneMatch.c_str(), asset.etag) != nullptr)) {
+        response.begin(304, asset.contentType, 0);
+        return;
+    }
+
+    // Every browser accepts gzip, so there is no uncompressed fallback
+    response.addHeader("Content-Encoding", "gzip");
+    response.begin(200, asset.contentType, asset.length);
+    response.write((const char*)asset.data, asset.length);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include <pgmspace.h> // For PROGMEM
+#include "endpoints.h"
+#include "response_sink.h"
+
+// Static pages from web/, gzip-compressed at build time by
+// scripts/embed_web_assets.py and stored in flash
+struct WebAsset {
+    const char* contentType;
+    const uint8_t* data;     // gzip stream
+    size_t length;
+    size_t rawLength;        // Uncompressed size
+    const char* etag;        // Quoted, derived from the compressed bytes
+};
+
+extern const WebAsset WEB_ASSET_WIFI_SETUP;
+extern const WebAsset WEB_ASSET_JWT_CREATOR;
+extern const WebAsset WEB_ASSET_SYSTEM_INFO;
+extern const WebAsset WEB_ASSET_INITIALIZE;
+
+// Send an asset straight from flash with Content-Encoding: gzip and its
+// ETag, or 304 if the request's If-None-Match already names it
+void serveWebAsset(const EndpointRequest& request, ResponseSink& response, const WebAsset& asset);
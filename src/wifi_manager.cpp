@@ -0,0 +1,350 @@
+#include "wifi_manager.h"
+#include <Preferences.h>
+#include <esp_wifi.h>
+
+#define WIFI_CACHE_NAMESPACE "wificache"
+
+#define WIFI_GOT_IP_BIT BIT0
+#define WIFI_FAIL_BIT BIT1
+#define WIFI_REQUEST_DONE_BIT BIT2  // loop() finished a connect() request
+#define WIFI_REQUEST_OK_BIT BIT3    // ... and it connected
+
+WiFiManager wifiManager;
+
+void WiFiManager::begin() {
+    if (events != nullptr) {
+        return;
+    }
+    events = xEventGroupCreate();
+    requestLock = xSemaphoreCreateMutex();
+    loopTask = xTaskGetCurrentTaskHandle();
+
+    // Credentials are kept by us; don't let the driver write them to flash or
+    // restart association behind our back.
+    WiFi.persistent(false);
+    WiFi.setAutoReconnect(false);
+
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+        onEvent(event, info);
+    });
+
+    loadCache();
+}
+
+void WiFiManager::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_CONNECTED: {
+            stats.lastAssociateMs = millis() - attemptStart;
+            const wifi_event_sta_connected_t& connected = info.wifi_sta_connected;
+            size_t len = connected.ssid_len < sizeof(pending.ssid) - 1 ? connected.ssid_len : sizeof(pending.ssid) - 1;
+            memcpy(pending.ssid, connected.ssid, len);
+            pending.ssid[len] = '\0';
+            memcpy(pending.bssid, connected.bssid, sizeof(pending.bssid));
+            pending.channel = connected.channel;
+            break;
+        }
+
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
+            unsigned long now = millis();
+            stats.lastConnectMs = now - attemptStart;
+            stats.lastWasFast = attemptIsFast;
+            if (linkLostAt != 0) {
+                stats.lastReconnectMs = now - linkLostAt;
+                linkLostAt = 0;
+                connectReport = true;
+            }
+            if (stats.bootToConnectMs == 0) {
+                stats.bootToConnectMs = now;
+            }
+            pending.ip = info.got_ip.ip_info.ip.addr;
+            pending.gateway = info.got_ip.ip_info.gw.addr;
+            pending.netmask = info.got_ip.ip_info.netmask.addr;
+            pending.dns = (uint32_t)WiFi.dnsIP();
+            pending.valid = true;
+            cacheDirty = true;
+            backoffMs = 0;
+            fastFailed = false;
+            currentState = WiFiState::CONNECTED;
+            xEventGroupSetBits(events, WIFI_GOT_IP_BIT);
+            break;
+        }
+
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: {
+            // Our own disconnect() before a new attempt; not a failure of that attempt
+            if (info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE &&
+                currentState == WiFiState::CONNECTING) {
+                break;
+            }
+            if (currentState == WiFiState::CONNECTED) {
+                linkLostAt = millis();
+                nextRetryAt = linkLostAt;  // Try the cached AP right away
+            }
+            if (currentState == WiFiState::CONNECTING) {
+                stats.failures++;
+                if (attemptIsFast) {
+                    fastFailed = true;  // Next retry does a full scan
+                }
+            }
+            currentState = WiFiState::DISCONNECTED;
+            xEventGroupSetBits(events, WIFI_FAIL_BIT);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void WiFiManager::startAttempt(bool useCache) {
+    bool fast = useCache && cache.valid && ssid == cache.ssid &&
+                cache.channel > 0 && cache.channel <= 14;
+
+    xEventGroupClearBits(events, WIFI_GOT_IP_BIT | WIFI_FAIL_BIT);
+
+    if (WiFi.getMode() != WIFI_STA) {
+        WiFi.mode(WIFI_STA);
+    }
+    currentState = WiFiState::CONNECTING;
+    if (WiFi.isConnected()) {
+        WiFi.disconnect(false, false);
+    }
+
+    attemptIsFast = fast;
+    attemptStart = millis();
+    stats.attempts++;
+
+#if defined(WIFI_REUSE_IP_LEASE)
+    if (fast && cache.ip != 0) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.netmask), IPAddress(cache.dns));
+    } else {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+#endif
+
+    if (fast) {
+        stats.fastAttempts++;
+        Serial.printf("WiFi: fast connect to %s on channel %u\n", ssid.c_str(), cache.channel);
+        WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid, true);
+    } else {
+        Serial.printf("WiFi: connecting to %s\n", ssid.c_str());
+        WiFi.begin(ssid.c_str(), password.c_str());
+    }
+}
+
+bool WiFiManager::connect(const String& newSsid, const String& newPassword, uint32_t timeoutMs) {
+    if (events == nullptr) {
+        begin();
+    }
+
+    xSemaphoreTake(requestLock, portMAX_DELAY);
+    requestSsid = newSsid;
+    requestPassword = newPassword;
+    requestedTimeoutMs = timeoutMs;
+    connectRequested = true;
+    xEventGroupClearBits(events, WIFI_REQUEST_DONE_BIT | WIFI_REQUEST_OK_BIT);
+    xSemaphoreGive(requestLock);
+
+    EventBits_t bits = 0;
+    if (xTaskGetCurrentTaskHandle() == loopTask) {
+        // From setup() (or loop()): drive the attempt from here
+        while ((bits & WIFI_REQUEST_DONE_BIT) == 0) {
+            loop();
+            bits = xEventGroupWaitBits(events, WIFI_REQUEST_DONE_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(20));
+        }
+    } else {
+        // loop() may be busy for a while before it takes the request
+        bits = xEventGroupWaitBits(events, WIFI_REQUEST_DONE_BIT, pdFALSE, pdFALSE,
+                                   pdMS_TO_TICKS(timeoutMs + WIFI_FAST_CONNECT_TIMEOUT_MS));
+    }
+    return (bits & WIFI_REQUEST_OK_BIT) != 0;
+}
+
+// Apply what connect() and reset() asked for, reset first: a reset drops
+// any connect requested before it
+void WiFiManager::takeRequests(unsigned long now) {
+    xSemaphoreTake(requestLock, portMAX_DELAY);
+    bool doReset = resetRequested;
+    bool doConnect = connectRequested;
+    resetRequested = false;
+    connectRequested = false;
+    if (doConnect) {
+        ssid = requestSsid;
+        password = requestPassword;
+        requestSsid = "";
+        requestPassword = "";
+    }
+    uint32_t timeoutMs = requestedTimeoutMs;
+    xSemaphoreGive(requestLock);
+
+    if (doReset) {
+        if (requestActive) {
+            finishRequest(false);
+        }
+        autoReconnect = false;
+        fastFailed = false;
+        ssid = "";
+        password = "";
+        currentState = WiFiState::IDLE;
+        clearCache();
+    }
+    if (doConnect) {
+        if (requestActive) {
+            finishRequest(false);  // Superseded
+        }
+        requestActive = true;
+        requestStart = now;
+        requestTimeoutMs = timeoutMs;
+        startAttempt(true);
+    }
+}
+
+// One step of the connect() attempt: the cached BSSID/channel first, then a
+// full scan in the time left
+void WiFiManager::stepRequest(unsigned long now) {
+    if (currentState == WiFiState::CONNECTED) {
+        finishRequest(true);
+        return;
+    }
+    bool attemptOver = currentState == WiFiState::DISCONNECTED ||
+                       (attemptIsFast && now - attemptStart >= WIFI_FAST_CONNECT_TIMEOUT_MS);
+    if (now - requestStart >= requestTimeoutMs) {
+        finishRequest(false);
+    } else if (attemptOver && attemptIsFast) {
+        // The AP may have moved channel or been replaced; fall back to a full scan
+        Serial.println("WiFi: fast connect failed, falling back to full scan");
+        clearCache();
+        startAttempt(false);
+    } else if (attemptOver) {
+        finishRequest(false);
+    }
+}
+
+void WiFiManager::finishRequest(bool connected) {
+    requestActive = false;
+    if (connected) {
+        if (cacheDirty) {
+            saveCache();
+        }
+        connectReport = false;
+        Serial.printf("WiFi: associated in %u ms, got IP in %u ms (%s)\n",
+                      stats.lastAssociateMs, stats.lastConnectMs, stats.lastWasFast ? "fast" : "full scan");
+    } else {
+        if (currentState == WiFiState::CONNECTING) {
+            stats.failures++;
+        }
+        currentState = WiFiState::DISCONNECTED;
+        WiFi.disconnect(false, false);
+    }
+    xEventGroupSetBits(events, WIFI_REQUEST_DONE_BIT | (connected ? WIFI_REQUEST_OK_BIT : 0));
+}
+
+void WiFiManager::loop() {
+    if (events == nullptr) {
+        return;
+    }
+
+    unsigned long now = millis();
+    takeRequests(now);
+    if (requestActive) {
+        stepRequest(now);
+        return;  // The connect() attempt owns the connection until it finishes
+    }
+
+    if (cacheDirty) {
+        saveCache();
+    }
+    if (connectReport) {
+        connectReport = false;
+        Serial.printf("WiFi: got IP in %u ms (%s), %u ms after link loss\n",
+                      stats.lastConnectMs, stats.lastWasFast ? "fast" : "full scan", stats.lastReconnectMs);
+    }
+
+    if (!autoReconnect || ssid.length() == 0) {
+        return;
+    }
+
+    if (currentState == WiFiState::CONNECTING) {
+        uint32_t limit = attemptIsFast ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS;
+        if (now - attemptStart < limit) {
+            return;  // Let the association in progress finish
+        }
+        stats.failures++;
+        if (attemptIsFast) {
+            fastFailed = true;
+        }
+        currentState = WiFiState::DISCONNECTED;
+        WiFi.disconnect(false, false);
+        nextRetryAt = now;
+    }
+
+    if (currentState == WiFiState::DISCONNECTED && (long)(now - nextRetryAt) >= 0) {
+        // After a failed fast attempt the retry does a full scan
+        startAttempt(!fastFailed);
+        backoffMs = backoffMs == 0 ? 1000 : backoffMs * 2;
+        if (backoffMs > WIFI_RECONNECT_MAX_BACKOFF_MS) {
+            backoffMs = WIFI_RECONNECT_MAX_BACKOFF_MS;
+        }
+        nextRetryAt = now + backoffMs;
+    }
+}
+
+void WiFiManager::reset() {
+    autoReconnect = false;
+    if (requestLock == nullptr) {
+        return;
+    }
+    xSemaphoreTake(requestLock, portMAX_DELAY);
+    resetRequested = true;
+    connectRequested = false;
+    requestSsid = "";
+    requestPassword = "";
+    xSemaphoreGive(requestLock);
+}
+
+void WiFiManager::loadCache() {
+    Preferences prefs;
+    if (!prefs.begin(WIFI_CACHE_NAMESPACE, true)) {
+        return;
+    }
+    cache = {};
+    if (prefs.getBytes("entry", &cache, sizeof(cache)) != sizeof(cache)) {
+        cache = {};
+    }
+    prefs.end();
+
+    if (cache.valid) {
+        Serial.printf("WiFi: cached AP for %s on channel %u\n", cache.ssid, cache.channel);
+    }
+}
+
+void WiFiManager::saveCache() {
+    cacheDirty = false;
+    FastConnectCache fresh = pending;
+    if (!fresh.valid) {
+        return;
+    }
+    // Skip the flash write when nothing changed (the usual case on reconnect)
+    if (cache.valid && strcmp(fresh.ssid, cache.ssid) == 0 &&
+        memcmp(fresh.bssid, cache.bssid, sizeof(cache.bssid)) == 0 &&
+        fresh.channel == cache.channel && fresh.ip == cache.ip &&
+        fresh.gateway == cache.gateway && fresh.netmask == cache.netmask && fresh.dns == cache.dns) {
+        return;
+    }
+    cache = fresh;
+
+    Preferences prefs;
+    if (prefs.begin(WIFI_CACHE_NAMESPACE, false)) {
+        prefs.putBytes("entry", &cache, sizeof(cache));
+        prefs.end();
+    }
+}
+
+void WiFiManager::clearCache() {
+    cache = {};
+    pending.valid = false;
+    Preferences prefs;
+    if (prefs.begin(WIFI_CACHE_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+
+// Event-driven WiFi station manager.
+// Connection progress is tracked from WiFi events instead of polling, and the
+// BSSID/channel (and IP lease) of the last good connection are cached in NVS
+// so reconnects can skip the full channel scan.
+// All connection state is owned by the task that calls begin() and loop().
+// connect() and reset() from other tasks only hand a request to loop().
+
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#endif
+
+#ifndef WIFI_FAST_CONNECT_TIMEOUT_MS
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  // Give up on the cached BSSID after this
+#endif
+
+#ifndef WIFI_RECONNECT_MAX_BACKOFF_MS
+#define WIFI_RECONNECT_MAX_BACKOFF_MS 30000
+#endif
+
+// Define WIFI_REUSE_IP_LEASE to configure the cached IP lease statically on
+// fast reconnects, skipping DHCP. Only safe on networks with long leases.
+
+enum class WiFiState {
+    IDLE,
+    CONNECTING,
+    CONNECTED,
+    DISCONNECTED
+};
+
+struct WiFiConnectMetrics {
+    uint32_t attempts;
+    uint32_t fastAttempts;       // Attempts that used the cached BSSID/channel
+    uint32_t failures;
+    uint32_t lastAssociateMs;    // Attempt start -> associated with the AP
+    uint32_t lastConnectMs;      // Attempt start -> got IP
+    uint32_t lastReconnectMs;    // Link loss -> got IP (0 if never lost)
+    uint32_t bootToConnectMs;    // Boot -> first IP
+    bool lastWasFast;
+};
+
+class WiFiManager {
+public:
+    // Call from setup(), on the task that will call loop()
+    void begin();
+
+    // Connect and wait for the result on the event group (no polling).
+    // Tries the cached BSSID/channel first and falls back to a full scan.
+    // From another task the attempt is run by loop(), which must keep
+    // being called; reconnects pause meanwhile.
+    bool connect(const String& ssid, const String& password, uint32_t timeoutMs = WIFI_CONNECT_TIMEOUT_MS);
+
+    // Keep reconnecting with backoff after the link is lost
+    void setAutoReconnect(bool enabled) { autoReconnect = enabled; }
+
+    // Drive reconnects and deferred NVS writes. Call from loop().
+    void loop();
+
+    // Forget the current credentials and the NVS cache. Reconnects stop at
+    // once; the rest is done by the next loop().
+    void reset();
+
+    WiFiState state() const { return currentState; }
+    WiFiConnectMetrics metrics() const { return stats; }
+
+private:
+    struct FastConnectCache {
+        bool valid;
+        char ssid[33];
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t netmask;
+        uint32_t dns;
+    };
+
+    void startAttempt(bool useCache);
+    void takeRequests(unsigned long now);
+    void stepRequest(unsigned long now);
+    void finishRequest(bool connected);
+    void loadCache();
+    void saveCache();
+    void clearCache();
+    void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+
+    EventGroupHandle_t events = nullptr;
+    volatile WiFiState currentState = WiFiState::IDLE;
+    String ssid;
+    String password;
+    volatile bool autoReconnect = false;
+    bool attemptIsFast = false;
+    volatile bool fastFailed = false;
+    unsigned long attemptStart = 0;
+    unsigned long linkLostAt = 0;
+    unsigned long nextRetryAt = 0;
+    uint32_t backoffMs = 0;
+    volatile bool cacheDirty = false;
+    volatile bool connectReport = false;  // Log metrics of a reconnect from loop()
+
+    // Requests from connect() and reset(), taken by loop()
+    TaskHandle_t loopTask = nullptr;
+    SemaphoreHandle_t requestLock = nullptr;  // Guards the five fields below
+    String requestSsid;
+    String requestPassword;
+    uint32_t requestedTimeoutMs = 0;
+    bool connectRequested = false;
+    bool resetRequested = false;
+    // The connect() attempt loop() is running
+    bool requestActive = false;
+    unsigned long requestStart = 0;
+    uint32_t requestTimeoutMs = 0;
+    FastConnectCache cache = {};
+    FastConnectCache pending = {};  // Filled from events, persisted from loop()
+    WiFiConnectMetrics stats = {};
+};
+
+extern WiFiManager wifiManager;
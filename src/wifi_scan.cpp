@@ -0,0 +1,201 @@
+#include "wifi_scan.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <atomic>
+#include <algorithm>
+
+// Open-addressing set over SSIDs, twice the result capacity
+static constexpr size_t SSID_SET_SIZE = 64;
+static_assert(SSID_SET_SIZE >= 2 * WIFI_SCAN_MAX_RESULTS, "SSID set too small for WIFI_SCAN_MAX_RESULTS");
+static_assert((SSID_SET_SIZE & (SSID_SET_SIZE - 1)) == 0, "SSID set size must be a power of two");
+static constexpr uint8_t SLOT_EMPTY = 0;
+static constexpr uint8_t SLOT_DELETED = 0xFF;  // Entry was replaced by a stronger SSID
+
+static WiFiScanResult results[WIFI_SCAN_MAX_RESULTS];
+static size_t resultCount = 0;
+static unsigned long completedAt = 0;
+static bool completed = false;
+static portMUX_TYPE resultsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Only touched from the WiFi event task while a scan completes
+static WiFiScanResult staging[WIFI_SCAN_MAX_RESULTS];
+
+static std::atomic<bool> scanning{false};
+static volatile unsigned long scanStartedAt = 0;
+
+static uint32_t ssidHash(const char* ssid) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    while (*ssid) {
+        hash = (hash ^ (uint8_t)*ssid++) * 16777619u;
+    }
+    return hash;
+}
+
+// Collapse the driver's records to one entry per SSID (strongest BSSID wins)
+static size_t collectResults(int count) {
+    uint8_t set[SSID_SET_SIZE] = {};  // Staging index + 1
+    size_t used = 0;
+
+    for (int i = 0; i < count; i++) {
+        const wifi_ap_record_t* record = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+        if (record == nullptr || record->ssid[0] == '\0') {
+            continue;  // Hidden networks can't be selected by name
+        }
+        const char* ssid = (const char*)record->ssid;
+
+        // Find the SSID, remembering the first reusable slot on the way
+        size_t slot = ssidHash(ssid) & (SSID_SET_SIZE - 1);
+        size_t freeSlot = SSID_SET_SIZE;
+        WiFiScanResult* entry = nullptr;
+        for (size_t probe = 0; probe < SSID_SET_SIZE; probe++) {
+            uint8_t value = set[slot];
+            if (value == SLOT_EMPTY) {
+                if (freeSlot == SSID_SET_SIZE) {
+                    freeSlot = slot;
+                }
+                break;
+            }
+            if (value == SLOT_DELETED) {
+                if (freeSlot == SSID_SET_SIZE) {
+                    freeSlot = slot;
+                }
+            } else if (strcmp(staging[value - 1].ssid, ssid) == 0) {
+                entry = &staging[value - 1];
+                break;
+            }
+            slot = (slot + 1) & (SSID_SET_SIZE - 1);
+        }
+
+        if (entry != nullptr) {
+            if (record->rssi <= entry->rssi) {
+                continue;
+            }
+        } else {
+            size_t index = used;
+            if (used == WIFI_SCAN_MAX_RESULTS) {
+                // Full: only a stronger network may evict the weakest one
+                index = 0;
+                for (size_t j = 1; j < used; j++) {
+                    if (staging[j].rssi < staging[index].rssi) {
+                        index = j;
+                    }
+                }
+                if (record->rssi <= staging[index].rssi) {
+                    continue;
+                }
+                size_t old = ssidHash(staging[index].ssid) & (SSID_SET_SIZE - 1);
+                while (set[old] != index + 1) {
+                    old = (old + 1) & (SSID_SET_SIZE - 1);
+                }
+                set[old] = SLOT_DELETED;
+                if (freeSlot == SSID_SET_SIZE) {
+                    freeSlot = old;
+                }
+            } else {
+                used++;
+            }
+            set[freeSlot] = index + 1;
+            entry = &staging[index];
+            strlcpy(entry->ssid, ssid, sizeof(entry->ssid));
+        }
+
+        memcpy(entry->bssid, record->bssid, sizeof(entry->bssid));
+        entry->rssi = record->rssi;
+        entry->channel = record->primary;
+        entry->authMode = (uint8_t)record->authmode;
+    }
+
+    std::sort(staging, staging + used, [](const WiFiScanResult& a, const WiFiScanResult& b) {
+        return a.rssi > b.rssi;
+    });
+    return used;
+}
+
+static void onScanDone(arduino_event_id_t event, arduino_event_info_t info) {
+    if (info.wifi_scan_done.status == 0) {
+        int count = WiFi.scanComplete();
+        size_t used = count > 0 ? collectResults(count) : 0;
+
+        portENTER_CRITICAL(&resultsMux);
+        memcpy(results, staging, used * sizeof(WiFiScanResult));
+        resultCount = used;
+        completedAt = millis();
+        completed = true;
+        portEXIT_CRITICAL(&resultsMux);
+
+        Serial.printf("WiFi scan: %d records, %u networks in %lu ms\n",
+                      count, (unsigned)used, millis() - scanStartedAt);
+    } else {
+        Serial.println("WiFi scan failed");
+    }
+    WiFi.scanDelete();  // Results are copied; free the driver's list
+    scanning = false;
+}
+
+void wifiScanInit() {
+    WiFi.onEvent(onScanDone, ARDUINO_EVENT_WIFI_SCAN_DONE);
+}
+
+bool wifiScanStart() {
+    if (scanning && millis() - scanStartedAt < WIFI_SCAN_TIMEOUT_MS) {
+        return false;
+    }
+    scanStartedAt = millis();
+    scanning = true;
+    // Enables STA alongside the soft AP if needed, so the setup AP stays up
+    if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED) {
+        scanning = false;
+        return false;
+    }
+    return true;
+}
+
+void wifiScanRefresh() {
+    long age = wifiScanAgeMs();
+    if (age < 0 || age >= WIFI_SCAN_CACHE_MS) {
+        wifiScanStart();
+    }
+}
+
+bool wifiScanRunning() {
+    return scanning;
+}
+
+size_t wifiScanCount() {
+    portENTER_CRITICAL(&resultsMux);
+    size_t count = resultCount;
+    portEXIT_CRITICAL(&resultsMux);
+    return count;
+}
+
+long wifiScanAgeMs() {
+    portENTER_CRITICAL(&resultsMux);
+    long age = completed ? (long)(millis() - completedAt) : -1;
+    portEXIT_CRITICAL(&resultsMux);
+    return age;
+}
+
+bool wifiScanResult(size_t index, WiFiScanResult& result) {
+    bool found = false;
+    portENTER_CRITICAL(&resultsMux);
+    if (index < resultCount) {
+        result = results[index];
+        found = true;
+    }
+    portEXIT_CRITICAL(&resultsMux);
+    return found;
+}
+
+const char* wifiScanAuthName(uint8_t authMode) {
+    switch ((wifi_auth_mode_t)authMode) {
+        case WIFI_AUTH_OPEN:            return "open";
+        case WIFI_AUTH_WEP:             return "wep";
+        case WIFI_AUTH_WPA_PSK:         return "wpa";
+        case WIFI_AUTH_WPA2_PSK:        return "wpa2";
+        case WIFI_AUTH_WPA_WPA2_PSK:    return "wpa/wpa2";
+        case WIFI_AUTH_WPA2_ENTERPRISE: return "wpa2-enterprise";
+        case WIFI_AUTH_WPA3_PSK:        return "wpa3";
+        case WIFI_AUTH_WPA2_WPA3_PSK:   return "wpa2/wpa3";
+        default:                        return "other";
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Non-blocking WiFi scan manager.
+// Scans run asynchronously in the driver. Results are collected on the
+// SCAN_DONE event into a fixed-capacity table: one entry per SSID, keeping
+// the strongest BSSID, sorted by RSSI. Readers never wait for a scan.
+
+#ifndef WIFI_SCAN_MAX_RESULTS
+#define WIFI_SCAN_MAX_RESULTS 32  // Distinct SSIDs kept, strongest first
+#endif
+
+#ifndef WIFI_SCAN_CACHE_MS
+#define WIFI_SCAN_CACHE_MS 10000  // wifiScanRefresh() rescans after this
+#endif
+
+#ifndef WIFI_SCAN_TIMEOUT_MS
+#define WIFI_SCAN_TIMEOUT_MS 15000  // Assume a scan was lost if SCAN_DONE never came
+#endif
+
+struct WiFiScanResult {
+    char ssid[33];
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authMode;  // wifi_auth_mode_t
+};
+
+// Register for scan events. Call once from setup().
+void wifiScanInit();
+
+// Start an asynchronous scan. Returns false if one is already running or
+// the driver refused to start it.
+bool wifiScanStart();
+
+// Start a scan if the results are older than WIFI_SCAN_CACHE_MS
+void wifiScanRefresh();
+
+bool wifiScanRunning();
+
+// Number of cached results and the age of the last completed scan
+// (-1 if no scan has completed yet)
+size_t wifiScanCount();
+long wifiScanAgeMs();
+
+// Copy result `index` (0 = strongest). Returns false past the end.
+bool wifiScanResult(size_t index, WiFiScanResult& result);
+
+// Short name of an auth mode for API output ("open", "wpa2", ...)
+const char* wifiScanAuthName(uint8_t authMode);
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+"""Local stand-in for the ingestion and GraphQL backends.
+
+Serves the two endpoints the firmware talks to, so uploads (sendJWT),
+gateway name lookups and initialization can be exercised without the live
+services:
+
+    POST /gw/data/   ES256 JWT upload; the signature is checked against the
+                     device public key and the payload decoded
+    POST /           GraphQL: GatewayName and Initialize
+
+Build the firmware against it with
+    -DSRCFUL_API_URL=\\"http://<host>:8080/\\" -DSRCFUL_DATA_URL=\\"http://<host>:8080/gw/data/\\"
+
+and run
+
+    python3 tools/backend_standin.py --latency-ms 50 --jitter-ms 20 --error-rate 0.05 --slow-chunks 4
+
+Faults apply to both endpoints: added latency, a fraction of requests
+answered 500, and responses sent chunked with a pause before each chunk.
+GET /stats returns the counters as JSON; tools/upload_bench.py reads them.
+Only the standard library is needed (P-256 is done in pure Python).
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import random
+import secrets
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# The test key pair in src/main.cpp
+DEVICE_PUBLIC_KEY = ("3e70c4705ff5945bfea058aaa68128e6f7d54fd7e08c640f4791668f8267a6e8"
+                     "c36ee19214698f1956e948bf339492fb11e0dc5a79a76dd0c235b431ee5aa782")
+DEVICE_PRIVATE_KEY = "4cc43b88635b9eaf81655ed51e062fab4a46296d72f01fc6fd853b08f0c2383a"
+
+# --- P-256 (secp256r1, the curve the firmware signs with) ---
+
+P = 0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff
+N = 0xffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551
+B = 0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b
+G = (0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296,
+     0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5)
+
+
+def _add(p1, p2):
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    (x1, y1), (x2, y2) = p1, p2
+    if x1 == x2:
+        if (y1 + y2) % P == 0:
+            return None
+        slope = (3 * x1 * x1 - 3) * pow(2 * y1, -1, P) % P
+    else:
+        slope = (y2 - y1) * pow(x2 - x1, -1, P) % P
+    x3 = (slope * slope - x1 - x2) % P
+    return x3, (slope * (x1 - x3) - y1) % P
+
+
+def _multiply(k, point):
+    result = None
+    while k:
+        if k & 1:
+            result = _add(result, point)
+        point = _add(point, point)
+        k >>= 1
+    return result
+
+
+def public_key(private_hex):
+    """64-byte x || y, hex, as crypto_get_public_key returns it."""
+    x, y = _multiply(int(private_hex, 16), G)
+    return f"{x:064x}{y:064x}"
+
+
+def parse_public_key(public_hex):
+    x, y = int(public_hex[:64], 16), int(public_hex[64:128], 16)
+    if (y * y - (x * x * x - 3 * x + B)) % P != 0:
+        raise ValueError("public key is not on P-256")
+    return x, y
+
+
+def verify(public, message, signature):
+    """ECDSA P-256 / SHA-256 over `message`; `signature` is r || s (64 bytes)."""
+    if len(signature) != 64:
+        return False
+    r, s = int.from_bytes(signature[:32], "big"), int.from_bytes(signature[32:], "big")
+    if not (0 < r < N and 0 < s < N):
+        return False
+    z = int.from_bytes(hashlib.sha256(message).digest(), "big")
+    w = pow(s, -1, N)
+    point = _add(_multiply(z * w % N, G), _multiply(r * w % N, public))
+    return point is not None and point[0] % N == r
+
+
+def sign(private_hex, message):
+    z = int.from_bytes(hashlib.sha256(message).digest(), "big")
+    d = int(private_hex, 16)
+    while True:
+        k = secrets.randbelow(N - 1) + 1
+        r = _multiply(k, G)[0] % N
+        s = pow(k, -1, N) * (z + r * d) % N
+        if r and s:
+            return r.to_bytes(32, "big") + s.to_bytes(32, "big")
+
+
+def b64url(data):
+    return base64.urlsafe_b64encode(data).rstrip(b"=").decode()
+
+
+def b64url_decode(text):
+    return base64.urlsafe_b64decode(text + "=" * (-len(text) % 4))
+
+
+def make_jwt(header, payload, private_hex=DEVICE_PRIVATE_KEY):
+    """A JWT laid out as crypto_create_jwt builds it."""
+    message = f"{b64url(json.dumps(header, separators=(',', ':')).encode())}." \
+              f"{b64url(json.dumps(payload, separators=(',', ':')).encode())}"
+    return f"{message}.{b64url(sign(private_hex, message.encode()))}"
+
+
+def check_jwt(public, token):
+    """Returns (header, payload) if the ES256 signature verifies, else raises ValueError."""
+    parts = token.strip().split(".")
+    if len(parts) != 3:
+        raise ValueError("not a JWT")
+    header = json.loads(b64url_decode(parts[0]))
+    if header.get("alg") != "ES256":
+        raise ValueError(f"alg {header.get('alg')!r}")
+    if not verify(public, f"{parts[0]}.{parts[1]}".encode(), b64url_decode(parts[2])):
+        raise ValueError("bad signature")
+    return header, json.loads(b64url_decode(parts[1]))
+
+
+# --- Server ---
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        self.started = time.time()
+        self.uploads = 0           # Verified uploads
+        self.rejected = 0          # Bad JWT or signature
+        self.injected_errors = 0
+        self.graphql = {}
+        self.upload_bytes = 0
+        self.readings = 0
+        self.arrivals = []         # time.time() of verified uploads
+        self.handling_ms = []      # Receive and verify, before injected faults
+        self.devices = set()
+
+    def snapshot(self):
+        with self.lock:
+            return {
+                "seconds": time.time() - self.started,
+                "uploads": self.uploads,
+                "rejected": self.rejected,
+                "injectedErrors": self.injected_errors,
+                "graphql": dict(self.graphql),
+                "uploadBytes": self.upload_bytes,
+                "readings": self.readings,
+                "arrivals": list(self.arrivals),
+                "handlingMs": list(self.handling_ms),
+                "devices": sorted(self.devices),
+            }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "backend-standin"
+
+    def log_message(self, format, *args):
+        if self.server.options.verbose:
+            super().log_message(format, *args)
+
+    def do_GET(self):
+        if self.path == "/stats":
+            self.reply(200, json.dumps(self.server.stats.snapshot()), faults=False)
+        else:
+            self.reply(404, '{"error":"not found"}', faults=False)
+
+    def do_DELETE(self):
+        if self.path == "/stats":
+            with self.server.stats.lock:
+                self.server.stats.reset()
+            self.reply(200, "{}", faults=False)
+        else:
+            self.reply(404, '{"error":"not found"}', faults=False)
+
+    def do_POST(self):
+        start = time.perf_counter()
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if self.path.startswith(self.server.options.data_path):
+            self.upload(body, start)
+        elif self.path == "/" or self.path.startswith("/graphql"):
+            self.graphql(body)
+        else:
+            self.reply(404, '{"error":"not found"}')
+
+    def upload(self, body, start):
+        stats = self.server.stats
+        try:
+            header, payload = check_jwt(self.server.public_key, body.decode())
+        except (ValueError, UnicodeDecodeError) as error:
+            with stats.lock:
+                stats.rejected += 1
+            self.reply(400, json.dumps({"error": str(error)}))
+            return
+        # createP1Reading: {"<timestamp ms>": {"serial_number": ..., "rows": [...]}, ...}
+        readings = sum(1 for value in payload.values() if isinstance(value, dict)) or 1
+        with stats.lock:
+            stats.uploads += 1
+            stats.upload_bytes += len(body)
+            stats.readings += readings
+            stats.arrivals.append(time.time())
+            stats.handling_ms.append((time.perf_counter() - start) * 1000)
+            stats.devices.add(header.get("device", "?"))
+        self.reply(200, '{"status":"ok"}')
+
+    def graphql(self, body):
+        try:
+            request = json.loads(body)
+            query = request["query"]
+            variables = request.get("variables", {})
+        except (ValueError, KeyError, TypeError):
+            self.reply(400, '{"errors":[{"message":"invalid request"}]}')
+            return
+        if "gatewayName" in query:
+            operation = "GatewayName"
+            data = {"gatewayConfiguration": {"gatewayName": {"name": f"standin-{variables.get('id', '')[-6:]}"}}}
+        elif "initialize" in query:
+            operation = "Initialize"
+            data = {"gatewayInception": {"initialize": {"initialized": True}}}
+        else:
+            self.reply(400, '{"errors":[{"message":"unknown operation"}]}')
+            return
+        with self.server.stats.lock:
+            self.server.stats.graphql[operation] = self.server.stats.graphql.get(operation, 0) + 1
+        self.reply(200, json.dumps({"data": data}))
+
+    def reply(self, status, text, faults=True):
+        options = self.server.options
+        if faults:
+            delay = options.latency_ms + random.uniform(-options.jitter_ms, options.jitter_ms)
+            if delay > 0:
+                time.sleep(delay / 1000)
+            if status == 200 and random.random() < options.error_rate:
+                with self.server.stats.lock:
+                    self.server.stats.injected_errors += 1
+                status, text = 500, '{"error":"injected"}'
+
+        data = text.encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        if not faults or options.slow_chunks <= 1:
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+            return
+
+        # Slow chunked response: a pause before each chunk
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        self.wfile.flush()
+        size = max(1, -(-len(data) // options.slow_chunks))
+        for index in range(0, len(data), size):
+            time.sleep(options.chunk_delay_ms / 1000)
+            chunk = data[index:index + size]
+            self.wfile.write(f"{len(chunk):x}\r\n".encode() + chunk + b"\r\n")
+            self.wfile.flush()
+        self.wfile.write(b"0\r\n\r\n")
+
+
+def add_arguments(parser):
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--data-path", default="/gw/data/", help="path of the JWT upload endpoint")
+    parser.add_argument("--public-key", default=DEVICE_PUBLIC_KEY, help="device public key, 128 hex digits")
+    parser.add_argument("--latency-ms", type=float, default=0, help="added to every response")
+    parser.add_argument("--jitter-ms", type=float, default=0, help="uniform +/- on the latency")
+    parser.add_argument("--error-rate", type=float, default=0, help="fraction of requests answered 500")
+    parser.add_argument("--slow-chunks", type=int, default=0, help="send responses chunked in this many pieces")
+    parser.add_argument("--chunk-delay-ms", type=float, default=200, help="pause before each slow chunk")
+    parser.add_argument("--verbose", action="store_true", help="log every request")
+
+
+def start_server(options):
+    """Starts the stand-in on a background thread and returns the server."""
+    server = ThreadingHTTPServer((options.bind, options.port), Handler)
+    server.daemon_threads = True
+    server.options = options
+    server.stats = Stats()
+    server.public_key = parse_public_key(options.public_key)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    add_arguments(parser)
+    options = parser.parse_args()
+    server = start_server(options)
+    print(f"Listening on {options.bind}:{server.server_address[1]}, uploads on {options.data_path}")
+    try:
+        while True:
+            time.sleep(10)
+            stats = server.stats.snapshot()
+            print(f"{stats['uploads']} uploads, {stats['rejected']} rejected, "
+                  f"{stats['injectedErrors']} injected errors, graphql {stats['graphql']}")
+    except KeyboardInterrupt:
+        server.shutdown()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""BLE request-to-notification latency, seen from the client and the device.
+
+Writes requests to the request characteristic and times each one until its
+response notification arrives, one at a time and then in bursts that fill
+the device's request queue. Prints p50/p99 for both, then the device's own
+request-to-notify histogram from /api/metrics, which includes the time a
+request waited in the queue.
+
+    python3 tools/ble_latency_test.py AA:BB:CC:DD:EE:FF --count 100 --burst 4
+
+Needs the `bleak` package. Run it against the old and the new firmware to
+compare; the rate limiter admits 20 cheap requests at once and 10 per
+second after, so keep --count modest or raise RATE_LIMIT_CHEAP_RATE.
+"""
+
+import argparse
+import asyncio
+import json
+import time
+
+from http_load_test import percentile
+from sign_bench import REQUEST_CHAR_UUID, BleClient
+from ble_stream_bench import stream_request
+
+
+async def timed_request(client, path):
+    start = time.perf_counter()
+    await client.client.write_gatt_char(REQUEST_CHAR_UUID, f"GET {path} EGWTTP/1.1\r\n\r\n".encode(),
+                                        response=True)
+    await asyncio.wait_for(client.packets.get(), 10)
+    return time.perf_counter() - start
+
+
+async def burst(client, path, size):
+    """Write `size` requests back to back; returns each one's time to its notification."""
+    start = time.perf_counter()
+    for _ in range(size):
+        await client.client.write_gatt_char(REQUEST_CHAR_UUID, f"GET {path} EGWTTP/1.1\r\n\r\n".encode(),
+                                            response=False)
+    latencies = []
+    for _ in range(size):
+        await asyncio.wait_for(client.packets.get(), 10)
+        latencies.append(time.perf_counter() - start)
+    return latencies
+
+
+def report(label, latencies):
+    latencies = sorted(latencies)
+    print(f"{label:10} {len(latencies):4} requests  p50 {percentile(latencies, 0.5) * 1000:7.1f} ms  "
+          f"p99 {percentile(latencies, 0.99) * 1000:7.1f} ms")
+
+
+def histogram_percentile(bounds, histogram, fraction):
+    """Upper bound (us) of the bucket holding the given fraction of samples; None past the last bound."""
+    target = fraction * histogram["n"]
+    seen = 0
+    for index, count in enumerate(histogram["b"]):
+        seen += count
+        if seen >= target:
+            return bounds[index] if index < len(bounds) else None
+    return None
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("address", help="BLE address of the device")
+    parser.add_argument("--path", default="/api/system/info", help="GET path with a one-packet response")
+    parser.add_argument("--count", type=int, default=50, help="sequential requests")
+    parser.add_argument("--burst", type=int, default=4, help="requests per burst (queue holds 5)")
+    parser.add_argument("--bursts", type=int, default=5)
+    args = parser.parse_args()
+
+    from bleak import BleakClient
+    async with BleakClient(args.address) as connection:
+        client = BleClient(connection)
+        await client.start()
+
+        sequential = []
+        for _ in range(args.count):
+            sequential.append(await timed_request(client, args.path))
+        report("sequential", sequential)
+
+        bursts = []
+        for _ in range(args.bursts):
+            await asyncio.sleep(1)  # Let the rate limiter refill
+            bursts += await burst(client, args.path, args.burst)
+        report("burst", bursts)
+
+        await asyncio.sleep(1)
+        metrics = json.loads(await stream_request(client, "GET", "/api/metrics"))
+        histogram = metrics.get("bleRequest", {}).get("latency")
+        if histogram and histogram["n"]:
+            bounds = metrics["boundsUs"]
+            p50, p99 = (histogram_percentile(bounds, histogram, f) for f in (0.5, 0.99))
+            print(f"device     {histogram['n']:4} requests  p50 <= {p50} us  p99 <= {p99} us  "
+                  f"mean {histogram['sumMs'] / histogram['n']:.1f} ms")
+        else:
+            print("device: no bleRequest histogram (older firmware)")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
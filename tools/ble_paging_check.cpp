@@ -0,0 +1,196 @@
+// Host check for BLE response paging (src/ble_response_cache.cpp, src/egwtp.cpp).
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/ble_paging_check.cpp src/ble_response_cache.cpp src/egwtp.cpp -o ble_paging_check
+//   ./ble_paging_check
+//
+// Pages through a 4 KB response the way a client does, one Offset request
+// per 512-byte packet served from the cache, and checks the reassembled
+// bytes. Also checks that interleaved requests to the same path keep their
+// own bodies, expiry, LRU eviction and the size cap, and reports the time
+// per cached page. Then streams the same response as frames at several
+// MTUs and checks the reassembled message.
+
+#include "ble_response_cache.h"
+#include "egwtp.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static const size_t PACKET_SIZE = 512;  // MAX_BLE_PACKET_SIZE
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static std::string makeBody(size_t length, unsigned seed) {
+    std::string body(length, '\0');
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245u + 12345u;
+        body[i] = (char)(' ' + (seed >> 16) % 95);
+    }
+    return body;
+}
+
+// Content-Length and body of a response packet, like a client parses it
+static bool parsePacket(const char* packet, size_t length, size_t& total, std::string& page) {
+    std::string text(packet, length);
+    size_t headerEnd = text.find("\r\n\r\n");
+    size_t lengthHeader = text.find("Content-Length: ");
+    if (headerEnd == std::string::npos || lengthHeader == std::string::npos || lengthHeader > headerEnd) {
+        return false;
+    }
+    total = strtoul(text.c_str() + lengthHeader + 16, nullptr, 10);
+    page = text.substr(headerEnd + 4);
+    return true;
+}
+
+// Read a whole body: the first packet comes from the handler's output, the
+// rest are Offset requests answered from the cache. Returns the packets used.
+static size_t readAll(BleResponseCache& cache, const char* path, const char* id, const std::string& handlerBody,
+                      uint32_t now, std::string& received) {
+    char packet[PACKET_SIZE];
+    size_t pageLength = 0;
+    size_t packetLength = egwtpFrameResponse(packet, sizeof(packet), path, "GET", handlerBody.data(),
+                                             handlerBody.size(), 0, &pageLength);
+    if (pageLength < handlerBody.size()) {
+        cache.store("GET", path, id, handlerBody.data(), handlerBody.size(), now);
+    }
+
+    size_t total = 0;
+    std::string page;
+    check(parsePacket(packet, packetLength, total, page), "first packet parses");
+    received = page;
+    size_t packets = 1;
+    while (received.size() < total) {
+        size_t length = 0;
+        const char* body = cache.find("GET", path, id, now, length);
+        if (body == nullptr) {
+            check(false, "offset page served from the cache");
+            return packets;
+        }
+        packetLength = egwtpFrameResponse(packet, sizeof(packet), path, "GET", body, length, (int)received.size());
+        if (!parsePacket(packet, packetLength, total, page) || page.empty()) {
+            check(false, "offset packet has a page");
+            return packets;
+        }
+        received += page;
+        packets++;
+    }
+    return packets;
+}
+
+// Stream `body` in frames of one notification at `mtu` and reassemble them
+// like a client; returns the frame count
+static size_t streamAll(const std::string& body, size_t mtu, std::string& message) {
+    char header[192];
+    size_t headerLength = egwtpFormatHeader(header, sizeof(header), "/api/readings", "GET", body.size(), 0);
+    size_t capacity = mtu - 3 < PACKET_SIZE ? mtu - 3 : PACKET_SIZE;
+    char frame[PACKET_SIZE];
+    size_t position = 0;
+    size_t frames = 0;
+    size_t total = 0;
+    message.clear();
+    while (size_t length = egwtpStreamFrame(frame, capacity, (uint16_t)frames, header, headerLength,
+                                            body.data(), body.size(), position)) {
+        check(length <= capacity, "frame fits the notification");
+        unsigned sequence = (uint8_t)frame[0] | (uint8_t)frame[1] << 8;
+        check(sequence == frames, "frames are numbered in order");
+        size_t frameTotal = 0;
+        for (int i = 0; i < 4; i++) {
+            frameTotal |= (size_t)(uint8_t)frame[2 + i] << (8 * i);
+        }
+        check(frames == 0 || frameTotal == total, "every frame carries the same total");
+        total = frameTotal;
+        message.append(frame + EGWTP_FRAME_HEADER_SIZE, length - EGWTP_FRAME_HEADER_SIZE);
+        frames++;
+    }
+    check(message.size() == total, "stream delivers the total length");
+    check(message.compare(0, headerLength, header, headerLength) == 0, "stream starts with the header block");
+    return frames;
+}
+
+int main() {
+    BleResponseCache cache;
+    uint32_t now = 1000;
+
+    // A 4 KB body, paged
+    std::string body = makeBody(4096, 1);
+    std::string received;
+    size_t packets = readAll(cache, "/api/system/info", "", body, now, received);
+    check(received == body, "4 KB body reassembled byte for byte");
+    printf("4096-byte body: %zu packets of <= %zu bytes\n", packets, PACKET_SIZE);
+
+    // Two requests to one path, e.g. signing runs with different nonces, keep their own bodies
+    std::string other = makeBody(4096, 2);
+    cache.store("POST", "/api/crypto/sign", "7", body.data(), body.size(), now);
+    cache.store("POST", "/api/crypto/sign", "8", other.data(), other.size(), now);
+    size_t stored = 0;
+    const char* seven = cache.find("POST", "/api/crypto/sign", "7", now, stored);
+    check(seven != nullptr && stored == body.size() && memcmp(seven, body.data(), stored) == 0,
+          "first request id keeps its body");
+    const char* eight = cache.find("POST", "/api/crypto/sign", "8", now, stored);
+    check(eight != nullptr && stored == other.size() && memcmp(eight, other.data(), stored) == 0,
+          "second request id keeps its body");
+
+    // Expiry
+    size_t length = 0;
+    check(cache.find("GET", "/api/system/info", "", now + BLE_RESPONSE_CACHE_TTL_MS, length) != nullptr,
+          "entry valid until the TTL");
+    check(cache.find("GET", "/api/system/info", "", now + BLE_RESPONSE_CACHE_TTL_MS + 1, length) == nullptr,
+          "entry expires after the TTL");
+
+    // LRU: touch the first entry, then fill the cache; the untouched oldest goes
+    cache.clear();
+    std::string small = makeBody(1000, 3);
+    char path[32];
+    for (int i = 0; i < BLE_RESPONSE_CACHE_ENTRIES; i++) {
+        snprintf(path, sizeof(path), "/lru/%d", i);
+        cache.store("GET", path, "", small.data(), small.size(), now);
+    }
+    cache.find("GET", "/lru/0", "", now, length);
+    cache.store("GET", "/lru/new", "", small.data(), small.size(), now);
+    check(cache.find("GET", "/lru/0", "", now, length) != nullptr, "recently used entry kept");
+    check(cache.find("GET", "/lru/1", "", now, length) == nullptr, "least recently used entry evicted");
+    check(cache.find("GET", "/lru/new", "", now, length) != nullptr, "new entry stored");
+
+    // Size cap
+    std::string huge = makeBody(BLE_RESPONSE_CACHE_MAX_BODY + 1, 4);
+    check(!cache.store("GET", "/huge", "", huge.data(), huge.size(), now), "oversized body refused");
+
+    // Time per cached page
+    cache.store("GET", "/api/system/info", "", body.data(), body.size(), now);
+    char packet[PACKET_SIZE];
+    const int rounds = 200000;
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        const char* stored = cache.find("GET", "/api/system/info", "", now, length);
+        sink += egwtpFrameResponse(packet, sizeof(packet), "/api/system/info", "GET", stored, length,
+                                   (int)((i % 8) * 480 + 1));
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+    printf("cached page: %.0f ns (lookup + framing), %zu bytes framed\n", ns, sink);
+
+    // Streaming at common MTUs
+    const size_t mtus[] = { 23, 185, 247, 517 };
+    for (size_t mtu : mtus) {
+        std::string message;
+        size_t frames = streamAll(body, mtu, message);
+        check(message.size() > body.size() && message.compare(message.size() - body.size(), body.size(), body) == 0,
+              "streamed body matches");
+        printf("4096-byte body streamed at MTU %zu: %zu frames\n", mtu, frames);
+    }
+
+    if (failures != 0) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""BLE transfer time of a long response: Offset paging vs streamed frames.
+
+Reads the same response repeatedly over BLE, once by paging it with Offset
+requests (one round trip per 512-byte packet) and once with "Stream: 1"
+(numbered frames, one per notification), and reports the time and bytes
+per second of each. Then prints the device's own bytes per second per
+negotiated MTU from /api/metrics.
+
+    python3 tools/ble_stream_bench.py AA:BB:CC:DD:EE:FF --path /api/readings --repeat 5
+
+Needs the `bleak` package. The MTU is negotiated by the host's BLE stack;
+run from different hosts (or phones) to compare MTUs.
+"""
+
+import argparse
+import asyncio
+import json
+import struct
+import time
+
+from sign_bench import REQUEST_CHAR_UUID, RESPONSE_CHAR_UUID, BleClient
+
+FRAME_HEADER = struct.Struct("<HI")  # Sequence number, total message length
+
+
+async def stream_request(client, method, path):
+    """Send a request with Stream: 1 and reassemble the frames; returns the body."""
+    await client.client.write_gatt_char(REQUEST_CHAR_UUID, f"{method} {path} EGWTTP/1.1\r\nStream: 1\r\n\r\n".encode(),
+                                        response=True)
+    message = b""
+    expected = 0
+    total = None
+    while total is None or len(message) < total:
+        frame = await asyncio.wait_for(client.packets.get(), 10)
+        sequence, total = FRAME_HEADER.unpack_from(frame)
+        if sequence != expected:
+            raise RuntimeError(f"frame {sequence} arrived, expected {expected}")
+        expected += 1
+        message += frame[FRAME_HEADER.size:]
+    return message.partition(b"\r\n\r\n")[2]
+
+
+async def timed(label, repeat, fetch):
+    sizes = []
+    start = time.perf_counter()
+    for _ in range(repeat):
+        sizes.append(len(await fetch()))
+    elapsed = time.perf_counter() - start
+    print(f"{label:8} {repeat} x {sizes[-1]} bytes  {elapsed / repeat * 1000:8.1f} ms each  "
+          f"{sum(sizes) / elapsed:9.0f} B/s")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("address", help="BLE address of the device")
+    parser.add_argument("--path", default="/api/readings", help="GET path with a long response")
+    parser.add_argument("--repeat", type=int, default=5)
+    args = parser.parse_args()
+
+    from bleak import BleakClient
+    async with BleakClient(args.address) as connection:
+        print(f"MTU {connection.mtu_size}")
+        client = BleClient(connection)
+        await client.start()
+        await timed("offset", args.repeat, lambda: client.request("GET", args.path, None))
+        await timed("stream", args.repeat, lambda: stream_request(client, "GET", args.path))
+
+        metrics = json.loads(await stream_request(client, "GET", "/api/metrics"))
+        for entry in metrics.get("bleStream", {}).get("mtus", []):
+            print(f"device: MTU {entry['mtu']:3}  {entry['transfers']} transfers  {entry['bytes']} bytes  "
+                  f"{entry['bytesPerSec']} B/s")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""BLE upload throughput for requests split over several writes.
+
+Sends POST /api/crypto/sign requests of increasing size, each split into
+MTU-sized writes, and reports the time from the first write to the
+response notification and the resulting bytes per second, with and
+without write responses. Finishes with the device's reassembly counters.
+
+    python3 tools/ble_upload_bench.py AA:BB:CC:DD:EE:FF --sizes 256 1024 4000
+
+Needs the `bleak` package. Each size is sent --count times; the rate
+limiter admits only a few signing requests per second, so the tool pauses
+between requests.
+"""
+
+import argparse
+import asyncio
+import json
+import time
+
+from sign_bench import BleClient
+from ble_stream_bench import stream_request
+
+
+def sign_request(size):
+    """A signing request of about `size` bytes, header included."""
+    messages = []
+    content = json.dumps({"messages": messages})
+    while len(content) + 80 < size:
+        messages.append(f"upload-{len(messages):04}-" + "x" * 40)
+        content = json.dumps({"messages": messages})
+    return (f"POST /api/crypto/sign EGWTTP/1.1\r\nContent-Length: {len(content)}\r\n\r\n{content}").encode()
+
+
+async def timed_upload(client, request, response):
+    start = time.perf_counter()
+    await client.send(request, response=response)
+    packet = await asyncio.wait_for(client.packets.get(), 30)
+    return time.perf_counter() - start, packet
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("address", help="BLE address of the device")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[256, 1024, 2048, 4000])
+    parser.add_argument("--count", type=int, default=3, help="requests per size and write type")
+    parser.add_argument("--pause", type=float, default=1.0, help="seconds between requests")
+    args = parser.parse_args()
+
+    from bleak import BleakClient
+    async with BleakClient(args.address) as connection:
+        client = BleClient(connection)
+        await client.start()
+        print(f"MTU {connection.mtu_size}, {connection.mtu_size - 3} bytes per write")
+
+        for response in (True, False):
+            label = "with response" if response else "without response"
+            for size in args.sizes:
+                request = sign_request(size)
+                elapsed = []
+                for _ in range(args.count):
+                    seconds, packet = await timed_upload(client, request, response)
+                    body = packet.partition(b"\r\n\r\n")[2]
+                    if body.startswith(b'{"status":"error"'):
+                        print(f"{len(request)} bytes: {body[:80]!r}")
+                    elapsed.append(seconds)
+                    await asyncio.sleep(args.pause)
+                best = min(elapsed)
+                print(f"{label:17} {len(request):5} bytes  best {best * 1000:7.1f} ms  "
+                      f"{len(request) / best / 1024:6.1f} KB/s")
+
+        metrics = json.loads(await stream_request(client, "GET", "/api/metrics"))
+        counters = metrics.get("bleRequest", {})
+        print(f"device: {counters.get('reassembled', '?')} reassembled, "
+              f"{counters.get('reassemblyDropped', '?')} dropped")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,105 @@
+// Throughput of the EGWTP request parser and response framer (src/egwtp.cpp).
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/egwtp_bench.cpp src/egwtp.cpp -o egwtp_bench
+//   ./egwtp_bench
+//
+// Parses a mix of typical BLE requests and reports nanoseconds per request
+// and MB/s, next to a std::string version of the substring-based parser it
+// replaced (a stand-in for Arduino String, which doesn't build on the
+// host; both allocate per substring). Then times response header framing.
+
+#include "egwtp.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static const char* REQUESTS[] = {
+    "GET /api/system/info EGWTTP/1.1\r\n\r\n",
+    "GET /api/readings?from=1700000000&to=1700003600 EGWTTP/1.1\r\nStream: 1\r\n\r\n",
+    "GET /api/readings EGWTTP/1.1\r\nOffset: 1024\r\nRequest-Id: 4f2a\r\n\r\n",
+    "POST /api/crypto/sign EGWTTP/1.1\r\nContent-Length: 154\r\nRequest-Id: 91\r\n\r\n"
+    "{\"messages\":[\"0123456789abcdef0123456789abcdef\",\"0123456789abcdef0123456789abcdef\","
+    "\"0123456789abcdef0123456789abcdef\",\"0123456789abcdef0123456789abcdef\"]}",
+    "POST /api/wifi EGWTTP/1.1\r\nContent-Length: 47\r\n\r\n{\"ssid\":\"HomeNetwork-5G\",\"psk\":\"correct horse\"}",
+};
+static const size_t REQUEST_COUNT = sizeof(REQUESTS) / sizeof(REQUESTS[0]);
+
+struct StringRequest {
+    std::string method, path, content, requestId;
+    int offset = 0;
+    bool stream = false;
+};
+
+// The previous parser: find/substr over the whole request per header
+static bool parseWithStrings(const std::string& request, StringRequest& parsed) {
+    size_t headerEnd = request.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return false;
+    std::string header = request.substr(0, headerEnd);
+    parsed.content = request.substr(headerEnd + 4);
+    std::string firstLine = header.substr(0, header.find("\r\n"));
+    if (firstLine.size() < 11 || firstLine.compare(firstLine.size() - 11, 11, " EGWTTP/1.1") != 0) return false;
+    size_t methodEnd = firstLine.find(' ');
+    parsed.method = firstLine.substr(0, methodEnd);
+    parsed.path = firstLine.substr(methodEnd + 1, firstLine.size() - 11 - methodEnd - 1);
+    size_t offset = header.find("Offset: ");
+    parsed.offset = offset == std::string::npos ? 0 : atoi(header.substr(offset + 8).c_str());
+    size_t id = header.find("Request-Id: ");
+    if (id != std::string::npos) {
+        size_t idEnd = header.find("\r\n", id);
+        parsed.requestId = header.substr(id + 12, idEnd == std::string::npos ? std::string::npos : idEnd - id - 12);
+    }
+    parsed.stream = header.find("Stream: 1") != std::string::npos;
+    return true;
+}
+
+template <typename Function>
+static double nsPerCall(long rounds, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < rounds; i++) {
+        function(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : 5000000;
+    size_t lengths[REQUEST_COUNT];
+    std::string strings[REQUEST_COUNT];
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < REQUEST_COUNT; i++) {
+        lengths[i] = strlen(REQUESTS[i]);
+        strings[i] = REQUESTS[i];
+        totalBytes += lengths[i];
+
+        EgwtpRequest request;
+        if (egwtpParseRequest(REQUESTS[i], lengths[i], request) != EgwtpParseResult::OK) {
+            printf("request %zu does not parse\n", i);
+            return 1;
+        }
+    }
+    double averageBytes = (double)totalBytes / REQUEST_COUNT;
+
+    volatile size_t sink = 0;
+    double spans = nsPerCall(rounds, [&](long i) {
+        EgwtpRequest request;
+        size_t index = i % REQUEST_COUNT;
+        egwtpParseRequest(REQUESTS[index], lengths[index], request);
+        sink = sink + request.content.length + request.path.length;
+    });
+    double substrings = nsPerCall(rounds / 10, [&](long i) {
+        StringRequest request;
+        parseWithStrings(strings[i % REQUEST_COUNT], request);
+        sink = sink + request.content.size() + request.path.size();
+    });
+    printf("parse, spans:      %7.1f ns/request  %7.1f MB/s\n", spans, averageBytes / spans * 1000);
+    printf("parse, substrings: %7.1f ns/request  %7.1f MB/s\n", substrings, averageBytes / substrings * 1000);
+
+    char packet[512];
+    double framing = nsPerCall(rounds, [&](long i) {
+        sink = sink + egwtpFormatHeader(packet, sizeof(packet), "/api/readings", "GET", 4096 + (i & 1023),
+                                        (int)(i & 511));
+    });
+    printf("response header:   %7.1f ns/packet\n", framing);
+    return 0;
+}
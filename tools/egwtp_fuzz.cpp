@@ -0,0 +1,159 @@
+// Fuzz harness for the EGWTP request parser and response framer (src/egwtp.cpp).
+//
+// With libFuzzer:
+//   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -std=gnu++17 -Isrc tools/egwtp_fuzz.cpp src/egwtp.cpp -o egwtp_fuzz
+//   ./egwtp_fuzz -max_len=1024
+//
+// Without it (g++), the same checks run on mutations of a few seed
+// requests, or on the files given as arguments (e.g. a crash to replay):
+//   g++ -g -O1 -fsanitize=address,undefined -DEGWTP_FUZZ_STANDALONE -std=gnu++17 -Isrc tools/egwtp_fuzz.cpp src/egwtp.cpp -o egwtp_fuzz
+//   ./egwtp_fuzz [iterations | file...]
+//
+// Besides memory errors, checks that spans stay inside the input, that the
+// content is where the header block ends, that cutting a complete request
+// short makes it INCOMPLETE rather than something else, and that framed
+// responses never exceed their buffer.
+
+#include "egwtp.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static void require(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "check failed: %s\n", what);
+        abort();
+    }
+}
+
+static bool inside(EgwtpSpan span, const char* data, size_t size) {
+    return span.data == nullptr ? span.length == 0 : span.data >= data && span.data + span.length <= data + size;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* input, size_t size) {
+    // A copy of exactly `size` bytes, so reads past the end are caught
+    std::vector<char> buffer(input, input + size);
+    const char* data = buffer.data();
+
+    EgwtpRequest request;
+    EgwtpParseResult result = egwtpParseRequest(data, size, request);
+    if (result != EgwtpParseResult::OK) {
+        return 0;
+    }
+
+    require(!request.method.empty() && !request.path.empty(), "method and path present");
+    require(inside(request.method, data, size) && inside(request.path, data, size) &&
+            inside(request.requestId, data, size) && inside(request.content, data, size), "spans inside the input");
+    require(request.content.data == data + request.headerLength, "content follows the header block");
+    require(request.content.length == request.contentLength, "content has the parsed length");
+    require(request.headerLength + request.contentLength <= size, "request fits the input");
+    require(request.hasContentLength || request.headerLength + request.contentLength == size,
+            "without Content-Length the content is the rest");
+    require(request.offset >= 0, "offset is not negative");
+
+    // Any shorter prefix of a complete request with content is incomplete
+    if (request.hasContentLength && request.contentLength > 0) {
+        EgwtpRequest prefix;
+        size_t cut = request.headerLength + request.contentLength - 1;
+        require(egwtpParseRequest(data, cut, prefix) == EgwtpParseResult::INCOMPLETE, "short content is incomplete");
+        require(prefix.headerLength == request.headerLength && prefix.contentLength == request.contentLength,
+                "incomplete request reports the lengths");
+    }
+
+    // Frame a response echoing the path and method
+    char packet[512];
+    size_t page = 0;
+    size_t length = egwtpFrameResponse(packet, sizeof(packet), request.path, request.method, request.content.data,
+                                       request.content.length, request.offset, &page);
+    require(length <= sizeof(packet) && page <= request.content.length, "packet fits its buffer");
+
+    char header[192];
+    size_t headerLength = egwtpFormatHeader(header, sizeof(header), request.path, request.method,
+                                            request.content.length, 0);
+    if (headerLength > 0) {
+        size_t position = 0;
+        size_t total = 0;
+        uint16_t sequence = 0;
+        while (size_t frameLength = egwtpStreamFrame(packet, 20, sequence++, header, headerLength,
+                                                     request.content.data, request.content.length, position)) {
+            require(frameLength <= 20, "frame fits the notification");
+            total += frameLength - EGWTP_FRAME_HEADER_SIZE;
+        }
+        require(total == headerLength + request.content.length, "stream carries the whole message");
+    }
+    return 0;
+}
+
+#ifdef EGWTP_FUZZ_STANDALONE
+
+static const char* SEEDS[] = {
+    "GET /api/system/info EGWTTP/1.1\r\n\r\n",
+    "POST /api/crypto/sign EGWTP/1.1\r\nContent-Length: 17\r\nRequest-Id: 7\r\n\r\n{\"message\":\"abc\"}",
+    "GET /api/readings?from=1&to=2 EGWTTP/1.1\r\nOffset: 512\r\nStream: 1\r\n\r\n",
+    "POST /api/wifi EGWTTP/1.1\r\ncontent-length: 30\r\n\r\n{\"ssid\":\"net\",\"psk\":\"secret1\"}",
+};
+
+static uint32_t rng = 12345;
+
+static uint32_t next() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Byte flips, inserts of protocol characters, deletions and truncation
+static std::vector<uint8_t> mutate(const char* seed) {
+    static const char INTERESTING[] = "\r\n: 0123456789-EGWTP/1.1";
+    std::vector<uint8_t> data(seed, seed + strlen(seed));
+    int edits = 1 + next() % 4;
+    for (int i = 0; i < edits && !data.empty(); i++) {
+        size_t at = next() % data.size();
+        switch (next() % 4) {
+            case 0: data[at] = (uint8_t)next(); break;
+            case 1: data.insert(data.begin() + at, (uint8_t)INTERESTING[next() % (sizeof(INTERESTING) - 1)]); break;
+            case 2: data.erase(data.begin() + at); break;
+            case 3: data.resize(at); break;
+        }
+    }
+    return data;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && atol(argv[1]) == 0) {
+        // Replay files
+        for (int i = 1; i < argc; i++) {
+            FILE* file = fopen(argv[i], "rb");
+            if (file == nullptr) {
+                perror(argv[i]);
+                return 1;
+            }
+            std::vector<uint8_t> data;
+            int c;
+            while ((c = fgetc(file)) != EOF) {
+                data.push_back((uint8_t)c);
+            }
+            fclose(file);
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+        printf("replayed %d file(s)\n", argc - 1);
+        return 0;
+    }
+
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t seeds = sizeof(SEEDS) / sizeof(SEEDS[0]);
+    for (size_t i = 0; i < seeds; i++) {
+        const char* seed = SEEDS[i];
+        EgwtpRequest request;
+        require(egwtpParseRequest(seed, strlen(seed), request) == EgwtpParseResult::OK, "seed parses");
+    }
+    for (long i = 0; i < iterations; i++) {
+        std::vector<uint8_t> data = mutate(SEEDS[i % seeds]);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    printf("%ld inputs ok\n", iterations);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Upload cadence and API admission under a request flood.
+
+Subscribes to /api/stream, where every reading is published just before it
+is uploaded, and times the readings while the API is idle (baseline) and
+then while N connections flood it with a mix of cheap and expensive
+requests. Reports how the device answered each cost class (200 vs 429),
+the latency of admitted requests, and the reading intervals in both
+phases, which should match when admission control is working.
+
+    python3 tools/flood_test.py 192.168.1.100 --baseline 60 --duration 120 --clients 8
+
+Readings are only uploaded while the device is online with SNTP time (and,
+on BLE builds, with BLE stopped), every 10 s. All flood connections come
+from this host, so they share one client's buckets; the rejections show
+up as zap_ratelimit_limited_total and zap_ratelimit_shed_total.
+"""
+
+import argparse
+import asyncio
+import json
+import statistics
+import time
+
+from http_load_test import percentile, read_response
+from heap_soak_test import scrape
+
+# (cost class, method, path, body); the class is the route's, see ROUTE_EXPENSIVE
+REQUESTS = [
+    ("cheap", "GET", "/api/wifi", None),
+    ("cheap", "GET", "/api/name", None),
+    ("cheap", "GET", "/api/crypto", None),
+    ("cheap", "GET", "/api/system/info", None),
+    ("expensive", "POST", "/api/crypto/sign", {"message": "flood"}),
+    ("expensive", "GET", "/api/readings", None),
+]
+
+
+async def watch_readings(args, arrivals, stop):
+    """Append the arrival time of every reading on the event stream."""
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    writer.write(f"GET /api/stream HTTP/1.1\r\nHost: {args.host}\r\nAccept: text/event-stream\r\n\r\n".encode())
+    await writer.drain()
+    status = int((await reader.readline()).split()[1])
+    if status != 200:
+        writer.close()
+        raise SystemExit(f"/api/stream answered {status}")
+    while (await reader.readline()) not in (b"\r\n", b""):
+        pass  # Response headers
+
+    first = True
+    while not stop.is_set():
+        try:
+            line = await asyncio.wait_for(reader.readline(), 1)
+        except asyncio.TimeoutError:
+            continue
+        if not line:
+            break
+        if line.startswith(b"data: "):
+            # The first event may replay the reading from before we subscribed
+            if not first:
+                arrivals.append(time.monotonic())
+            first = False
+    writer.close()
+
+
+async def flood(args, index, deadline, results):
+    reader = writer = None
+    sent = index  # Each connection starts at a different request
+    while time.monotonic() < deadline:
+        cost, method, path, body = REQUESTS[sent % len(REQUESTS)]
+        sent += 1
+        payload = json.dumps(body).encode() if body is not None else b""
+        head = f"{method} {path} HTTP/1.1\r\nHost: {args.host}\r\nConnection: keep-alive\r\n"
+        if payload:
+            head += f"Content-Type: application/json\r\nContent-Length: {len(payload)}\r\n"
+        try:
+            if writer is None:
+                reader, writer = await asyncio.open_connection(args.host, args.port)
+            start = time.perf_counter()
+            writer.write(head.encode() + b"\r\n" + payload)
+            await writer.drain()
+            status, close = await asyncio.wait_for(read_response(reader), args.timeout)
+        except (OSError, ConnectionError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError):
+            results[cost]["failed"] += 1
+            if writer is not None:
+                writer.close()
+            writer = None
+            await asyncio.sleep(0.05)
+            continue
+        results[cost]["statuses"][status] = results[cost]["statuses"].get(status, 0) + 1
+        if status == 200:
+            results[cost]["latencies"].append((time.perf_counter() - start) * 1000)
+        if close:
+            writer.close()
+            writer = None
+    if writer is not None:
+        writer.close()
+
+
+def intervals(arrivals, start, end):
+    times = [t for t in arrivals if start <= t < end]
+    return [b - a for a, b in zip(times, times[1:])]
+
+
+def report_intervals(label, values):
+    if not values:
+        print(f"{label:9} no consecutive readings; run longer or check that the device is uploading")
+        return
+    spread = statistics.pstdev(values) if len(values) > 1 else 0.0
+    print(f"{label:9} {len(values):3} intervals  mean {statistics.mean(values):6.2f} s  "
+          f"min {min(values):6.2f} s  max {max(values):6.2f} s  stdev {spread:5.2f} s")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=8, help="concurrent flood connections")
+    parser.add_argument("--baseline", type=float, default=60.0, help="seconds of readings before the flood")
+    parser.add_argument("--duration", type=float, default=120.0, help="seconds of flood")
+    parser.add_argument("--timeout", type=float, default=5.0, help="per-request timeout")
+    args = parser.parse_args()
+
+    arrivals = []
+    stop = asyncio.Event()
+    watcher = asyncio.create_task(watch_readings(args, arrivals, stop))
+
+    baseline_start = time.monotonic()
+    await asyncio.sleep(args.baseline)
+
+    before = await scrape(args.host, args.port)
+    flood_start = time.monotonic()
+    deadline = flood_start + args.duration
+    results = {cost: {"statuses": {}, "latencies": [], "failed": 0} for cost in ("cheap", "expensive")}
+    await asyncio.gather(*(flood(args, i, deadline, results) for i in range(args.clients)))
+    flood_end = time.monotonic()
+
+    stop.set()
+    await watcher
+    # Let the cheap bucket refill so the scrape itself isn't limited
+    await asyncio.sleep(3)
+    after = await scrape(args.host, args.port)
+
+    print(f"flood: {args.clients} connections for {args.duration:.0f} s")
+    for cost, result in results.items():
+        statuses = "  ".join(f"{status}: {count}" for status, count in sorted(result["statuses"].items()))
+        latencies = sorted(result["latencies"])
+        line = f"  {cost:9} {statuses or 'no responses'}  failed: {result['failed']}"
+        if latencies:
+            line += (f"  admitted p50 {percentile(latencies, 0.50):.1f} ms"
+                     f"  p99 {percentile(latencies, 0.99):.1f} ms")
+        print(line)
+
+    def delta(name, labels=""):
+        return after.get((name, labels), 0) - before.get((name, labels), 0)
+
+    print("device counters during the flood:")
+    for cost in ("cheap", "expensive"):
+        label = f'class="{cost}"'
+        print(f"  {cost:9} admitted {delta('zap_ratelimit_admitted_total', label):.0f}  "
+              f"limited {delta('zap_ratelimit_limited_total', label):.0f}")
+    print(f"  shed by the device-wide budget: {delta('zap_ratelimit_shed_total'):.0f}")
+    print(f"  uploads: {delta('zap_upload_attempts_total'):.0f} attempted, "
+          f"{delta('zap_upload_failures_total'):.0f} failed")
+
+    print("reading intervals:")
+    report_intervals("baseline", intervals(arrivals, baseline_start, flood_start))
+    report_intervals("flood", intervals(arrivals, flood_start, flood_end))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Heap fragmentation soak test for the device's local HTTP API.
+
+Sends a mix of GET and POST requests (10k by default) over one keep-alive
+connection and compares the heap gauges from /api/metrics before and after:
+free bytes, the low-water mark, the largest free block and fragmentation
+(1 - largest block / free). Also prints the request arena's peak use per
+endpoint, for sizing REQUEST_ARENA_SIZE.
+
+    python3 tools/heap_soak_test.py 192.168.1.100 --requests 10000
+
+Run it against two firmware builds to compare their fragmentation.
+"""
+
+import argparse
+import asyncio
+import json
+import re
+import time
+
+from http_load_test import read_response
+
+REQUESTS = [
+    ("GET", "/api/crypto", None),
+    ("GET", "/api/wifi", None),
+    ("GET", "/api/system/info", None),
+    ("POST", "/api/crypto/sign", {"message": "soak"}),
+    ("POST", "/api/crypto/sign", {"message": "x" * 200, "timestamp": "2024-01-01T00:00:00Z"}),
+    ("POST", "/api/crypto/sign", "{not json"),
+]
+
+METRIC_LINE = re.compile(r'^(\w+)(?:\{(.*)\})? (\S+)$')
+
+
+async def send(reader, writer, host, method, path, body):
+    if body is None:
+        payload = b""
+    elif isinstance(body, str):
+        payload = body.encode()
+    else:
+        payload = json.dumps(body).encode()
+    head = f"{method} {path} HTTP/1.1\r\nHost: {host}\r\nConnection: keep-alive\r\n"
+    if payload:
+        head += f"Content-Type: application/json\r\nContent-Length: {len(payload)}\r\n"
+    writer.write(head.encode() + b"\r\n" + payload)
+    await writer.drain()
+    return await read_response(reader)
+
+
+async def scrape(host, port):
+    """Parse the Prometheus text from /api/metrics into {(name, labels): value}."""
+    reader, writer = await asyncio.open_connection(host, port)
+    writer.write(f"GET /api/metrics HTTP/1.1\r\nHost: {host}\r\nConnection: close\r\n\r\n".encode())
+    await writer.drain()
+    raw = await reader.read()
+    writer.close()
+    text = raw.partition(b"\r\n\r\n")[2].decode("latin-1")
+    metrics = {}
+    for line in text.splitlines():
+        match = METRIC_LINE.match(line)
+        if match:
+            metrics[(match.group(1), match.group(2) or "")] = float(match.group(3))
+    return metrics
+
+
+def heap_summary(metrics):
+    free = metrics.get(("zap_heap_free_bytes", ""), 0)
+    largest = metrics.get(("zap_heap_largest_block_bytes", ""), 0)
+    fragmentation = 100.0 * (1 - largest / free) if free else 0.0
+    return {
+        "free": free,
+        "minFree": metrics.get(("zap_heap_min_free_bytes", ""), 0),
+        "largestBlock": largest,
+        "fragmentation": fragmentation,
+    }
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--requests", type=int, default=10000)
+    args = parser.parse_args()
+
+    before = heap_summary(await scrape(args.host, args.port))
+
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    statuses = {}
+    start = time.monotonic()
+    for i in range(args.requests):
+        method, path, body = REQUESTS[i % len(REQUESTS)]
+        try:
+            status, close = await send(reader, writer, args.host, method, path, body)
+        except (ConnectionError, asyncio.IncompleteReadError):
+            status, close = "error", True
+        statuses[status] = statuses.get(status, 0) + 1
+        if close:
+            writer.close()
+            reader, writer = await asyncio.open_connection(args.host, args.port)
+    writer.close()
+    elapsed = time.monotonic() - start
+
+    after_metrics = await scrape(args.host, args.port)
+    after = heap_summary(after_metrics)
+
+    print(f"{args.requests} requests in {elapsed:.1f} s, statuses {statuses}")
+    print(f"{'':14} {'free':>10} {'min free':>10} {'largest':>10} {'frag %':>8}")
+    for name, heap in (("before", before), ("after", after)):
+        print(f"{name:14} {heap['free']:>10.0f} {heap['minFree']:>10.0f} "
+              f"{heap['largestBlock']:>10.0f} {heap['fragmentation']:>8.1f}")
+    print(f"{'change':14} {after['free'] - before['free']:>+10.0f} {after['minFree'] - before['minFree']:>+10.0f} "
+          f"{after['largestBlock'] - before['largestBlock']:>+10.0f} "
+          f"{after['fragmentation'] - before['fragmentation']:>+8.1f}")
+
+    size = after_metrics.get(("zap_request_arena_size_bytes", ""))
+    if size is None:
+        print("no request arena metrics (firmware without the arena)")
+        return
+    print(f"request arena: {size:.0f} bytes, "
+          f"{after_metrics.get(('zap_request_arena_failures_total', ''), 0):.0f} failed allocations")
+    for (name, labels), value in sorted(after_metrics.items()):
+        if name == "zap_request_arena_peak_bytes":
+            print(f"  {labels}: peak {value:.0f}")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,194 @@
+// Host benchmark for the reading history range queries (src/reading_history.cpp).
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/history_bench.cpp src/reading_history.cpp -o history_bench
+//   ./history_bench
+//
+// Fills a 24 h ring with 1 s readings (wrapped once, so the index is
+// rotated), checks every query against a full linear scan and reports
+// the time, index probes and records read per query. Also checks that
+// provisional records stay searchable once their times are corrected.
+
+#include "reading_history.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const uint32_t START = 1700000000;
+static const size_t CAPACITY = 86400;
+
+struct Collected {
+    std::vector<ReadingRecord> rows;
+    std::vector<uint32_t> samples;
+};
+
+static void collect(const ReadingRecord& row, uint32_t samples, void* context) {
+    Collected* collected = static_cast<Collected*>(context);
+    collected->rows.push_back(row);
+    collected->samples.push_back(samples);
+}
+
+static void discard(const ReadingRecord& row, uint32_t, void* context) {
+    *static_cast<float*>(context) += row.powerKw;
+}
+
+static ReadingRecord makeRecord(uint32_t time) {
+    ReadingRecord record = {};
+    record.time = time;
+    record.importKwh = 10000.0f + (time - START) * 0.0004f;
+    record.powerKw = 1.5f + sinf(time / 600.0f);
+    for (int i = 0; i < 3; i++) {
+        record.phasePowerKw[i] = record.powerKw / 3;
+        record.voltage[i] = 230.0f + sinf(time / 10.0f + i);
+        record.current[i] = record.phasePowerKw[i] * 1000 / record.voltage[i];
+    }
+    return record;
+}
+
+// Reference: every record, same bucketing rules
+static Collected linearQuery(const std::vector<ReadingRecord>& all, uint32_t from, uint32_t to, uint32_t step) {
+    Collected result;
+    for (const ReadingRecord& record : all) {
+        if (record.time < from || record.time > to) {
+            continue;
+        }
+        uint32_t time = step > 0 ? from + (record.time - from) / step * step : record.time;
+        if (!result.rows.empty() && result.rows.back().time == time && step > 0) {
+            result.samples.back()++;
+        } else {
+            ReadingRecord row = record;
+            row.time = time;
+            result.rows.push_back(row);
+            result.samples.push_back(1);
+        }
+    }
+    return result;
+}
+
+static bool same(const Collected& a, const Collected& b) {
+    if (a.rows.size() != b.rows.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.rows.size(); i++) {
+        if (a.rows[i].time != b.rows[i].time || a.samples[i] != b.samples[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    ReadingHistory history;
+    if (!history.begin(CAPACITY, false)) {
+        printf("allocation failed\n");
+        return 1;
+    }
+
+    // 1.5 rings, so the oldest half-day has been overwritten
+    std::vector<ReadingRecord> kept;
+    uint32_t total = CAPACITY + CAPACITY / 2;
+    for (uint32_t i = 0; i < total; i++) {
+        ReadingRecord record = makeRecord(START + i);
+        history.append(record);
+        if (i >= total - CAPACITY) {
+            kept.push_back(record);
+        }
+    }
+    uint32_t oldest = history.oldestTime();
+    uint32_t newest = history.newestTime();
+    printf("%zu records (%.1f MB), %u..%u\n", history.size(),
+           history.size() * sizeof(ReadingRecord) / 1e6, oldest, newest);
+
+    struct Case {
+        const char* name;
+        uint32_t from;
+        uint32_t to;
+        uint32_t step;
+    };
+    const Case cases[] = {
+        { "last 5 min, raw",        newest - 300,         newest,               0 },
+        { "1 h in the middle, raw", oldest + 40000,       oldest + 43600,       0 },
+        { "1 h, step 60",           oldest + 40000,       oldest + 43600,       60 },
+        { "24 h, step 60",          oldest,               newest,               60 },
+        { "24 h, step 900",         oldest,               newest,               900 },
+        { "before the ring",        oldest - 5000,        oldest + 10,          0 },
+        { "empty range",            newest + 10,          newest + 20,          0 },
+    };
+
+    printf("%-24s %8s %8s %10s %12s %12s\n", "query", "rows", "probes", "records", "us/query", "linear us");
+    bool ok = true;
+    for (const Case& c : cases) {
+        Collected result;
+        ReadingQueryStats stats = history.query(c.from, c.to, c.step, 100000, collect, &result);
+        Collected expected = linearQuery(kept, c.from, c.to, c.step);
+        if (!same(result, expected)) {
+            printf("MISMATCH in '%s': %zu rows, expected %zu\n", c.name, result.rows.size(), expected.rows.size());
+            ok = false;
+        }
+
+        const int iterations = 200;
+        float sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            history.query(c.from, c.to, c.step, 100000, discard, &sink);
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            sink += linearQuery(kept, c.from, c.to, c.step).rows.size();
+        }
+        double linearUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        printf("%-24s %8u %8u %10u %12.1f %12.1f\n", c.name, stats.rows, stats.indexProbes,
+               stats.recordsRead, us, linearUs);
+    }
+
+    // Paging through a truncated result must visit every row exactly once
+    Collected paged;
+    uint32_t from = oldest;
+    int pages = 0;
+    for (;;) {
+        ReadingQueryStats stats = history.query(from, newest, 60, 500, collect, &paged);
+        pages++;
+        if (!stats.truncated) {
+            break;
+        }
+        from = stats.next;
+    }
+    if (!same(paged, linearQuery(kept, oldest, newest, 60))) {
+        printf("MISMATCH when paging\n");
+        ok = false;
+    }
+    printf("paged 24 h at step 60 in %d pages of 500 rows\n", pages);
+
+    // Readings on a provisional clock 2 h behind, then corrected at the
+    // sync: the index must find them at their SNTP times
+    ReadingHistory provisional;
+    provisional.begin(1024, false);
+    const int64_t behind = 7200;
+    std::vector<ReadingRecord> corrected;
+    for (uint32_t i = 0; i < 700; i++) {
+        ReadingRecord record = makeRecord(START + i);
+        provisional.append(record, true);
+        record.time += behind;
+        corrected.push_back(record);
+    }
+    size_t changed = provisional.correctProvisional(behind);
+    for (uint32_t i = 0; i < 100; i++) {
+        ReadingRecord record = makeRecord(START + behind + 700 + i);
+        provisional.append(record);
+        corrected.push_back(record);
+    }
+    Collected afterSync;
+    provisional.query(START + behind + 130, START + behind + 750, 0, 100000, collect, &afterSync);
+    if (changed != 700 || provisional.provisionalCount() != 0 ||
+        !same(afterSync, linearQuery(corrected, START + behind + 130, START + behind + 750, 0))) {
+        printf("MISMATCH after correcting provisional times\n");
+        ok = false;
+    }
+    printf("corrected %zu provisional records\n", changed);
+
+    printf("%s\n", ok ? "all queries match the linear scan" : "FAILED");
+    return ok ? 0 : 1;
+}
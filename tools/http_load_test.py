@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Load test for the device's local HTTP API.
+
+Opens N concurrent keep-alive connections and sends GET requests as fast as
+each connection allows, then reports throughput and latency percentiles.
+
+    python3 tools/http_load_test.py 192.168.1.100 --clients 8 --duration 10
+"""
+
+import argparse
+import asyncio
+import time
+
+
+async def read_response(reader):
+    """Read one HTTP/1.1 response, return (status, close_requested)."""
+    status_line = await reader.readline()
+    if not status_line:
+        raise ConnectionError("connection closed")
+    status = int(status_line.split()[1])
+
+    length = None
+    chunked = False
+    close = False
+    while True:
+        line = await reader.readline()
+        if line in (b"\r\n", b""):
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        name = name.strip().lower()
+        value = value.strip().lower()
+        if name == "content-length":
+            length = int(value)
+        elif name == "transfer-encoding" and value == "chunked":
+            chunked = True
+        elif name == "connection" and value == "close":
+            close = True
+
+    if chunked:
+        while True:
+            size = int((await reader.readline()).strip(), 16)
+            await reader.readexactly(size + 2)
+            if size == 0:
+                break
+    elif length:
+        await reader.readexactly(length)
+    return status, close
+
+
+async def client(args, deadline, latencies, errors):
+    request = (f"GET {args.path} HTTP/1.1\r\nHost: {args.host}\r\n"
+               "Connection: keep-alive\r\n\r\n").encode()
+    reader = writer = None
+    while time.monotonic() < deadline:
+        try:
+            if writer is None:
+                reader, writer = await asyncio.open_connection(args.host, args.port)
+            start = time.perf_counter()
+            writer.write(request)
+            await writer.drain()
+            status, close = await asyncio.wait_for(read_response(reader), args.timeout)
+            latencies.append(time.perf_counter() - start)
+            if status >= 500:
+                errors.append(status)
+            if close:
+                writer.close()
+                writer = None
+        except (OSError, ConnectionError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError) as e:
+            errors.append(type(e).__name__)
+            if writer is not None:
+                writer.close()
+            writer = None
+            await asyncio.sleep(0.05)
+    if writer is not None:
+        writer.close()
+
+
+def percentile(values, fraction):
+    index = min(len(values) - 1, int(round(fraction * (len(values) - 1))))
+    return values[index]
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/api/crypto")
+    parser.add_argument("--clients", type=int, default=8)
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds")
+    parser.add_argument("--timeout", type=float, default=5.0, help="per request, seconds")
+    args = parser.parse_args()
+
+    latencies, errors = [], []
+    deadline = time.monotonic() + args.duration
+    start = time.monotonic()
+    await asyncio.gather(*(client(args, deadline, latencies, errors) for _ in range(args.clients)))
+    elapsed = time.monotonic() - start
+
+    print(f"{args.clients} clients, {elapsed:.1f} s, GET {args.path}")
+    print(f"requests: {len(latencies)}  errors: {len(errors)}")
+    if latencies:
+        latencies.sort()
+        ms = [v * 1000 for v in latencies]
+        print(f"throughput: {len(latencies) / elapsed:.1f} req/s")
+        print(f"latency ms: p50 {percentile(ms, 0.50):.1f}  p90 {percentile(ms, 0.90):.1f}  "
+              f"p99 {percentile(ms, 0.99):.1f}  max {ms[-1]:.1f}")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""API latency while a WiFi connect job runs on the device.
+
+Posts credentials to /api/wifi, which answers 202 with a job, then keeps
+requesting a probe path until the job finishes and reports the probe
+latency percentiles next to the job's running time.
+
+    python3 tools/job_latency_test.py 192.168.4.1 --ssid MyNetwork --psk secret
+
+Use the device's softAP address: while the station connects, the device's
+station address may be unreachable. A wrong password is fine and makes a
+longer job, since the connect then runs until its timeout.
+"""
+
+import argparse
+import asyncio
+import json
+import time
+
+from http_load_test import percentile
+
+
+async def request(host, port, method, path, body=None):
+    payload = json.dumps(body).encode() if body is not None else b""
+    reader, writer = await asyncio.open_connection(host, port)
+    head = f"{method} {path} HTTP/1.1\r\nHost: {host}\r\nConnection: close\r\n"
+    if payload:
+        head += f"Content-Type: application/json\r\nContent-Length: {len(payload)}\r\n"
+    writer.write(head.encode() + b"\r\n" + payload)
+    await writer.drain()
+    raw = await reader.read()
+    writer.close()
+    status = int(raw.split(b" ", 2)[1])
+    body = raw.partition(b"\r\n\r\n")[2]
+    return status, body
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--ssid", required=True)
+    parser.add_argument("--psk", required=True)
+    parser.add_argument("--probe", default="/api/crypto", help="path timed while the job runs")
+    parser.add_argument("--timeout", type=float, default=60.0, help="seconds to wait for the job")
+    args = parser.parse_args()
+
+    start = time.perf_counter()
+    status, body = await request(args.host, args.port, "POST", "/api/wifi", {"ssid": args.ssid, "psk": args.psk})
+    accepted_ms = (time.perf_counter() - start) * 1000
+    if status != 202:
+        print(f"POST /api/wifi answered {status}: {body.decode(errors='replace')}")
+        return
+    location = json.loads(body)["location"]
+    print(f"POST /api/wifi: 202 in {accepted_ms:.1f} ms, polling {location}")
+
+    latencies = []
+    failures = 0
+    job = None
+    deadline = time.monotonic() + args.timeout
+    while time.monotonic() < deadline:
+        probe_start = time.perf_counter()
+        try:
+            status, _ = await asyncio.wait_for(request(args.host, args.port, "GET", args.probe), 5)
+            if status == 200:
+                latencies.append((time.perf_counter() - probe_start) * 1000)
+            else:
+                failures += 1
+            status, body = await asyncio.wait_for(request(args.host, args.port, "GET", location), 5)
+        except (OSError, asyncio.TimeoutError, ValueError):
+            failures += 1
+            continue
+        if status == 200:
+            job = json.loads(body)
+            if job["state"] in ("succeeded", "failed"):
+                break
+
+    if job is None or job["state"] not in ("succeeded", "failed"):
+        print("job did not finish in time")
+    else:
+        print(f"job {job['id']}: {job['state']} after {job['runMs']} ms running: {job.get('message')}")
+    if latencies:
+        latencies.sort()
+        print(f"GET {args.probe} during the job: {len(latencies)} requests, {failures} failed, "
+              f"p50 {percentile(latencies, 0.50):.1f} ms  p99 {percentile(latencies, 0.99):.1f} ms  "
+              f"max {latencies[-1]:.1f} ms")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,120 @@
+// Lookup cost of the route table hash (src/route_hash.h) as the table grows.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/route_bench.cpp -o route_bench
+//   ./route_bench
+//
+// Builds synthetic tables of 10 to 250 routes, checks that every route is
+// found and that unknown paths miss, then reports nanoseconds per lookup
+// next to the linear `path == "..."` chain pathToEndpoint() used before
+// (std::string standing in for Arduino String, which doesn't build on the
+// host). Lookups are 90% known routes and 10% misses.
+
+#include "route_hash.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+enum class Method : uint8_t { GET, POST };
+
+struct BenchRoute {
+    const char* path;
+    Method method;
+};
+
+static const char* GROUPS[] = { "wifi", "crypto", "system", "readings", "jobs", "ble", "meter", "config" };
+
+struct Lookup {
+    std::string path;
+    Method method;
+};
+
+template <typename Function>
+static double nsPerLookup(const std::vector<Lookup>& lookups, long rounds, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < rounds; i++) {
+        function(lookups[i % lookups.size()]);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+template <size_t N>
+static bool run(long rounds) {
+    // Paths like /api/crypto/endpoint1, GET and POST alternating
+    static std::vector<std::string> names;
+    static BenchRoute routes[N];
+    names.clear();
+    names.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        names.push_back("/api/" + std::string(GROUPS[i % 8]) + "/endpoint" + std::to_string(i));
+        routes[i] = { names.back().c_str(), i % 2 ? Method::POST : Method::GET };
+    }
+
+    constexpr size_t buckets = hashBucketCount(N);
+    constexpr size_t size = hashTableSize(N);
+    auto start = std::chrono::steady_clock::now();
+    static RouteHashTable<buckets, size> table;
+    table = buildRouteHashTable<buckets, size>(routes);
+    double buildUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if (!table.ok) {
+        printf("%zu routes: no collision-free hash\n", N);
+        return false;
+    }
+    uint32_t maxDisplacement = 0;
+    for (uint16_t displacement : table.displacement) {
+        maxDisplacement = displacement > maxDisplacement ? displacement : maxDisplacement;
+    }
+
+    std::vector<Lookup> lookups;
+    for (size_t i = 0; i < N * 9; i++) {
+        const BenchRoute& route = routes[(i * 7) % N];
+        lookups.push_back({ route.path, route.method });
+    }
+    for (size_t i = 0; i < N; i++) {
+        lookups.push_back({ "/api/missing/endpoint" + std::to_string(i), Method::GET });
+    }
+
+    // Every route found, every miss missed, and the wrong method misses too
+    bool ok = true;
+    for (const Lookup& lookup : lookups) {
+        const BenchRoute* found = routeHashFind(table, routes, (uint32_t)lookup.method, lookup.path.c_str(),
+                                                lookup.path.size());
+        bool known = lookup.path.compare(0, 13, "/api/missing/") != 0;
+        if (known != (found != nullptr) || (found && found->path != lookup.path)) {
+            printf("%zu routes: wrong result for %s\n", N, lookup.path.c_str());
+            ok = false;
+        }
+        Method other = lookup.method == Method::GET ? Method::POST : Method::GET;
+        if (known && routeHashFind(table, routes, (uint32_t)other, lookup.path.c_str(), lookup.path.size()) != nullptr) {
+            printf("%zu routes: %s found with the wrong method\n", N, lookup.path.c_str());
+            ok = false;
+        }
+    }
+
+    volatile size_t sink = 0;
+    double hashed = nsPerLookup(lookups, rounds, [&](const Lookup& lookup) {
+        sink = sink + (size_t)routeHashFind(table, routes, (uint32_t)lookup.method, lookup.path.c_str(),
+                                            lookup.path.size());
+    });
+    double chain = nsPerLookup(lookups, rounds / 4, [&](const Lookup& lookup) {
+        for (size_t i = 0; i < N; i++) {
+            if (lookup.path == routes[i].path && lookup.method == routes[i].method) {
+                sink = sink + i;
+                break;
+            }
+        }
+    });
+    printf("%6zu %8zu %8zu %8u %10.1f %12.1f %12.1f\n", N, buckets, size, maxDisplacement, buildUs, hashed, chain);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : 4000000;
+    printf("%6s %8s %8s %8s %10s %12s %12s\n", "routes", "buckets", "slots", "max disp", "build us", "hash ns",
+           "chain ns");
+    bool ok = run<10>(rounds) & run<25>(rounds) & run<50>(rounds) & run<100>(rounds) & run<200>(rounds) &
+              run<250>(rounds);
+    printf("%s\n", ok ? "all lookups correct" : "FAILED");
+    return ok ? 0 : 1;
+}
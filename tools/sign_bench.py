@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""Signatures per second from /api/crypto/sign, single vs batched.
+
+Signs the same number of messages one request at a time and then in
+batches ("messages": [...]), over HTTP and optionally over BLE, and reports
+signatures per second for each.
+
+    python3 tools/sign_bench.py --host 192.168.1.100 --count 64 --batch 16
+    python3 tools/sign_bench.py --ble AA:BB:CC:DD:EE:FF --count 32 --batch 8
+
+BLE needs the `bleak` package. Requests longer than one write are split
+over several (the device takes up to 4096 bytes); responses longer than
+one packet are read back with Offset requests, as the app does.
+"""
+
+import argparse
+import asyncio
+import json
+import time
+
+SERVICE_UUID = "0fda92b2-44a2-4af2-84f5-fa682baa2b8d"
+REQUEST_CHAR_UUID = "51ff12bb-3ed8-46e5-b4f9-d64e2fec021b"
+RESPONSE_CHAR_UUID = "51ff12bb-3ed8-46e5-b4f9-d64e2fec021c"
+
+
+def request_bodies(count, batch):
+    """Bodies that sign `count` messages, `batch` per request (0: single)."""
+    messages = [f"bench-{i}" for i in range(count)]
+    if batch == 0:
+        return [{"message": m} for m in messages]
+    return [{"messages": messages[i:i + batch]} for i in range(0, count, batch)]
+
+
+def signatures_in(body):
+    document = json.loads(body)
+    if "signatures" in document:
+        return len([s for s in document["signatures"] if s.get("sign")])
+    return 1 if document.get("sign") else 0
+
+
+# --- HTTP ---
+
+async def http_run(args, bodies):
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    signed = 0
+    start = time.perf_counter()
+    for body in bodies:
+        payload = json.dumps(body).encode()
+        writer.write((f"POST /api/crypto/sign HTTP/1.1\r\nHost: {args.host}\r\n"
+                      "Connection: keep-alive\r\nContent-Type: application/json\r\n"
+                      f"Content-Length: {len(payload)}\r\n\r\n").encode() + payload)
+        await writer.drain()
+        status, close, response = await read_body(reader)
+        if status == 200:
+            signed += signatures_in(response)
+        if close:
+            writer.close()
+            reader, writer = await asyncio.open_connection(args.host, args.port)
+    elapsed = time.perf_counter() - start
+    writer.close()
+    return signed, elapsed
+
+
+async def read_body(reader):
+    """Read one HTTP/1.1 response, return (status, close_requested, body)."""
+    status_line = await reader.readline()
+    status = int(status_line.split()[1])
+    length = 0
+    chunked = False
+    close = False
+    while True:
+        line = await reader.readline()
+        if line in (b"\r\n", b""):
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        name = name.strip().lower()
+        value = value.strip().lower()
+        if name == "content-length":
+            length = int(value)
+        elif name == "transfer-encoding" and value == "chunked":
+            chunked = True
+        elif name == "connection" and value == "close":
+            close = True
+
+    if not chunked:
+        return status, close, await reader.readexactly(length) if length else b""
+    body = b""
+    while True:
+        size = int((await reader.readline()).strip(), 16)
+        body += (await reader.readexactly(size + 2))[:size]
+        if size == 0:
+            return status, close, body
+
+
+# --- BLE ---
+
+class BleClient:
+    def __init__(self, client):
+        self.client = client
+        self.packets = asyncio.Queue()
+
+    async def start(self):
+        await self.client.start_notify(RESPONSE_CHAR_UUID, lambda _, data: self.packets.put_nowait(bytes(data)))
+
+    async def send(self, request, response=True):
+        """Write a request, split into MTU-sized writes if it doesn't fit in one."""
+        size = max(20, self.client.mtu_size - 3)
+        if len(request) <= size:
+            await self.client.write_gatt_char(REQUEST_CHAR_UUID, request, response=response)
+            return
+        for start in range(0, len(request), size):
+            await self.client.write_gatt_char(REQUEST_CHAR_UUID, request[start:start + size], response=response)
+
+    async def request(self, method, path, body):
+        """Send one EGWTTP request and page through the response body."""
+        content = json.dumps(body)
+        received = b""
+        offset = 0
+        while True:
+            header = f"{method} {path} EGWTTP/1.1\r\nContent-Length: {len(content.encode())}\r\n"
+            if offset > 0:
+                header += f"Offset: {offset}\r\n"
+            await self.send((header + "\r\n" + content).encode())
+            packet = await asyncio.wait_for(self.packets.get(), 10)
+            head, _, page = packet.partition(b"\r\n\r\n")
+            length = 0
+            for line in head.decode("latin-1").split("\r\n"):
+                if line.lower().startswith("content-length:"):
+                    length = int(line.split(":", 1)[1])
+            received += page
+            offset = len(received)
+            if offset >= length or not page:
+                return received
+
+
+async def ble_run(client, bodies):
+    signed = 0
+    start = time.perf_counter()
+    for body in bodies:
+        response = await client.request("POST", "/api/crypto/sign", body)
+        try:
+            signed += signatures_in(response)
+        except ValueError:
+            pass
+    return signed, time.perf_counter() - start
+
+
+def report(transport, label, requests, signed, elapsed):
+    print(f"{transport:5} {label:12} {requests:5} requests  {signed:5} signatures  "
+          f"{elapsed:7.2f} s  {signed / elapsed:7.2f} sig/s")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", help="device address for HTTP")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--ble", help="BLE address of the device")
+    parser.add_argument("--count", type=int, default=64, help="messages to sign per run")
+    parser.add_argument("--batch", type=int, default=16, help="messages per batched request")
+    args = parser.parse_args()
+    if not args.host and not args.ble:
+        parser.error("give --host, --ble or both")
+
+    runs = [("single", request_bodies(args.count, 0)),
+            (f"batch of {args.batch}", request_bodies(args.count, args.batch))]
+
+    if args.host:
+        for label, bodies in runs:
+            signed, elapsed = await http_run(args, bodies)
+            report("http", label, len(bodies), signed, elapsed)
+
+    if args.ble:
+        from bleak import BleakClient
+        async with BleakClient(args.ble) as connection:
+            client = BleClient(connection)
+            await client.start()
+            for label, bodies in runs:
+                signed, elapsed = await ble_run(client, bodies)
+                report("ble", label, len(bodies), signed, elapsed)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
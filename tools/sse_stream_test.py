@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Latency and throughput test for the device's /api/stream event stream.
+
+Subscribes N clients at once, records when each event arrives at each
+client and reports delivery latency, fan-out spread and throughput.
+
+    python3 tools/sse_stream_test.py 192.168.1.100 --clients 4 --duration 60
+
+Latency is measured against the capture timestamp inside each reading (the
+payload's top-level key, epoch ms), so it is only meaningful when this host
+and the device are both NTP-synced. Fan-out spread (last minus first
+arrival of the same event across clients) and missed events (gaps in the
+event ids) need no clock sync.
+"""
+
+import argparse
+import asyncio
+import json
+import time
+
+
+async def subscribe(args, index, deadline, arrivals, stats):
+    request = (f"GET {args.path} HTTP/1.1\r\nHost: {args.host}\r\n"
+               "Accept: text/event-stream\r\n\r\n").encode()
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    writer.write(request)
+    await writer.drain()
+
+    status_line = await reader.readline()
+    status = int(status_line.split()[1])
+    if status != 200:
+        stats["rejected"] += 1
+        writer.close()
+        return
+    while (await reader.readline()) not in (b"\r\n", b""):
+        pass  # Response headers
+
+    last_id = None
+    event_id = None
+    slow = index < args.slow_clients
+    try:
+        while time.monotonic() < deadline:
+            line = await asyncio.wait_for(reader.readline(), deadline - time.monotonic())
+            if not line:
+                stats["closed"] += 1
+                break
+            stats["bytes"][index] += len(line)
+            line = line.rstrip(b"\n")
+            if line.startswith(b"id: "):
+                event_id = int(line[4:])
+            elif line.startswith(b"data: ") and event_id is not None:
+                received = time.time()
+                if last_id is not None and event_id > last_id + 1:
+                    stats["missed"][index] += event_id - last_id - 1
+                # The first event may be a replay of the previous reading
+                if last_id is not None or not args.skip_replay:
+                    timestamp = None
+                    try:
+                        timestamp = int(next(iter(json.loads(line[6:]))))
+                    except (ValueError, StopIteration, TypeError):
+                        pass
+                    arrivals.setdefault(event_id, {})[index] = (received, timestamp)
+                last_id = event_id
+                stats["events"][index] += 1
+                if slow:
+                    await asyncio.sleep(args.slow_delay)
+    except asyncio.TimeoutError:
+        pass
+    finally:
+        writer.close()
+
+
+def percentile(values, fraction):
+    index = min(len(values) - 1, int(round(fraction * (len(values) - 1))))
+    return values[index]
+
+
+def summary(name, values):
+    if not values:
+        return f"{name}: no samples"
+    values.sort()
+    return (f"{name}: p50 {percentile(values, 0.50):.1f}  p90 {percentile(values, 0.90):.1f}  "
+            f"p99 {percentile(values, 0.99):.1f}  max {values[-1]:.1f}")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/api/stream")
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--duration", type=float, default=60.0, help="seconds")
+    parser.add_argument("--slow-clients", type=int, default=0,
+                        help="clients that pause after each event, to exercise backpressure")
+    parser.add_argument("--slow-delay", type=float, default=1.0, help="pause of a slow client, seconds")
+    parser.add_argument("--skip-replay", action="store_true",
+                        help="leave the replayed latest reading out of the latency figures")
+    args = parser.parse_args()
+
+    arrivals = {}
+    stats = {"rejected": 0, "closed": 0,
+             "events": [0] * args.clients, "bytes": [0] * args.clients, "missed": [0] * args.clients}
+    deadline = time.monotonic() + args.duration
+    start = time.monotonic()
+    await asyncio.gather(*(subscribe(args, i, deadline, arrivals, stats) for i in range(args.clients)))
+    elapsed = time.monotonic() - start
+
+    latencies, spreads = [], []
+    for per_client in arrivals.values():
+        for received, timestamp in per_client.values():
+            if timestamp is not None:
+                latencies.append((received - timestamp / 1000.0) * 1000)
+        if len(per_client) > 1:
+            times = [received for received, _ in per_client.values()]
+            spreads.append((max(times) - min(times)) * 1000)
+
+    print(f"{args.clients} subscribers ({args.slow_clients} slow), {elapsed:.1f} s, GET {args.path}")
+    print(f"rejected: {stats['rejected']}  closed by device: {stats['closed']}")
+    for i in range(args.clients):
+        print(f"  client {i}: {stats['events'][i]} events ({stats['events'][i] / elapsed:.2f}/s), "
+              f"{stats['bytes'][i] / elapsed:.0f} B/s, missed {stats['missed'][i]}")
+    print(summary("latency ms (device capture -> host)", latencies))
+    print(summary("fan-out spread ms", spreads))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""End-to-end upload benchmark against the local backend stand-in.
+
+Starts tools/backend_standin.py in-process (all its fault options apply)
+and measures uploads for --duration seconds. With --device, the firmware
+does the uploading: build it with
+
+    -DSRCFUL_DATA_URL=\\"http://<this host>:8080/gw/data/\\" -DSRCFUL_API_URL=\\"http://<this host>:8080/\\"
+    -DSRCFUL_UPLOAD_INTERVAL_MS=1000
+
+and the upload latency percentiles come from the device's own histogram
+(/api/metrics, before and after). Without --device, --clients host
+threads post JWTs laid out like the firmware's, signed with the test key,
+which checks the stand-in and the fault settings.
+
+    python3 tools/upload_bench.py --device 192.168.1.100 --duration 120 --latency-ms 80 --error-rate 0.02
+    python3 tools/upload_bench.py --clients 4 --duration 20 --slow-chunks 3 --chunk-delay-ms 50
+
+Reports uploads/s, success rate, latency p50/p90/p99 and bytes per reading.
+Run it before and after a networking change, with the same fault options.
+"""
+
+import argparse
+import http.client
+import re
+import threading
+import time
+import urllib.request
+
+from backend_standin import add_arguments, make_jwt, start_server
+from http_load_test import percentile
+
+METRIC_LINE = re.compile(r'^(\w+)(?:\{(.*)\})? (\S+)$')
+
+
+def upload_histogram(device):
+    """Cumulative zap_upload_duration_seconds buckets as {le: count}, plus attempts and failures."""
+    with urllib.request.urlopen(f"http://{device}/api/metrics", timeout=10) as response:
+        text = response.read().decode()
+    buckets = {}
+    counters = {"attempts": 0, "failures": 0}
+    for line in text.splitlines():
+        match = METRIC_LINE.match(line)
+        if not match:
+            continue
+        name, labels, value = match.groups()
+        if name == "zap_upload_duration_seconds_bucket":
+            le = re.search(r'le="([^"]+)"', labels or "").group(1)
+            buckets[float("inf") if le == "+Inf" else float(le)] = int(float(value))
+        elif name == "zap_upload_attempts_total":
+            counters["attempts"] = int(float(value))
+        elif name == "zap_upload_failures_total":
+            counters["failures"] = int(float(value))
+    return buckets, counters
+
+
+def histogram_percentile(before, after, fraction):
+    """Upper bound (ms) of the bucket holding `fraction` of the new samples."""
+    bounds = sorted(after)
+    total = after.get(float("inf"), 0) - before.get(float("inf"), 0)
+    if total == 0:
+        return None
+    for bound in bounds:
+        if after[bound] - before.get(bound, 0) >= fraction * total:
+            return bound * 1000
+    return None
+
+
+def reading_payload(sequence):
+    """A createP1Reading-shaped payload: one reading keyed by its timestamp (ms)."""
+    timestamp = int(time.time() * 1000) + sequence
+    rows = ["0-0:1.0.0(240101120000W)", f"1-0:1.8.0({1234.5 + sequence / 1000:08.3f}*kWh)",
+            "1-0:2.8.0(00000000.000*kWh)", "1-0:3.8.0(00000005.151*kVArh)", "1-0:4.8.0(00002109.781*kVArh)",
+            "1-0:1.7.0(001.234*kW)", "1-0:2.7.0(000.000*kW)", "1-0:21.7.0(000.411*kW)",
+            "1-0:41.7.0(000.412*kW)", "1-0:61.7.0(000.411*kW)", "1-0:32.7.0(230.1*V)",
+            "1-0:52.7.0(229.8*V)", "1-0:72.7.0(230.4*V)", "1-0:31.7.0(001.8*A)",
+            "1-0:51.7.0(001.8*A)", "1-0:71.7.0(001.8*A)"]
+    return {str(timestamp): {"serial_number": "LGF5E360", "rows": rows}}
+
+
+HEADER = {"alg": "ES256", "typ": "JWT", "device": "standin-host", "opr": "production",
+          "model": "p1homewizard", "dtype": "p1_telnet_json", "sn": "LGF5E360"}
+
+
+def host_client(port, data_path, deadline, results, lock, sequence):
+    # Each JWT is signed before its clock starts, so signing is not counted
+    connection = http.client.HTTPConnection("127.0.0.1", port, timeout=30)
+    while time.time() < deadline:
+        token = make_jwt(HEADER, reading_payload(next(sequence))).encode()
+        start = time.perf_counter()
+        try:
+            connection.request("POST", data_path, token, {"Content-Type": "text/plain"})
+            response = connection.getresponse()
+            response.read()
+            ok = 200 <= response.status < 300
+        except (OSError, http.client.HTTPException):
+            connection.close()
+            connection = http.client.HTTPConnection("127.0.0.1", port, timeout=30)
+            ok = False
+        with lock:
+            results.append((ok, time.perf_counter() - start))
+
+
+def report_latency(label, latencies_ms):
+    latencies_ms = sorted(latencies_ms)
+    if not latencies_ms:
+        print(f"{label}: no samples")
+        return
+    print(f"{label}: p50 {percentile(latencies_ms, 0.5):.1f} ms  p90 {percentile(latencies_ms, 0.9):.1f} ms  "
+          f"p99 {percentile(latencies_ms, 0.99):.1f} ms  max {latencies_ms[-1]:.1f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    add_arguments(parser)
+    parser.add_argument("--device", help="device address; its firmware uploads to this host")
+    parser.add_argument("--clients", type=int, default=2, help="host upload threads when there's no --device")
+    parser.add_argument("--duration", type=float, default=60, help="seconds to measure")
+    options = parser.parse_args()
+
+    server = start_server(options)
+    port = server.server_address[1]
+    print(f"Stand-in on port {port}: latency {options.latency_ms}+-{options.jitter_ms} ms, "
+          f"error rate {options.error_rate}, slow chunks {options.slow_chunks}")
+
+    if options.device:
+        before, counters_before = upload_histogram(options.device)
+        time.sleep(options.duration)
+        after, counters_after = upload_histogram(options.device)
+    else:
+        results = []
+        lock = threading.Lock()
+        sequence = iter(range(1 << 62))
+        deadline = time.time() + options.duration
+        threads = [threading.Thread(target=host_client,
+                                    args=(port, options.data_path, deadline, results, lock, sequence))
+                   for _ in range(options.clients)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+    stats = server.stats.snapshot()
+    server.shutdown()
+
+    print(f"{stats['uploads']} uploads verified in {options.duration:.0f} s: "
+          f"{stats['uploads'] / options.duration:.2f} uploads/s, {stats['rejected']} rejected (bad JWT), "
+          f"{stats['injectedErrors']} injected errors")
+    if stats["readings"]:
+        print(f"{stats['uploadBytes'] / stats['readings']:.0f} bytes per reading "
+              f"({stats['uploadBytes'] / max(1, stats['uploads']):.0f} per upload)")
+    report_latency("stand-in receive and verify", stats["handlingMs"])
+
+    if options.device:
+        attempts = counters_after["attempts"] - counters_before["attempts"]
+        failures = counters_after["failures"] - counters_before["failures"]
+        print(f"device: {attempts} attempts, {failures} failed")
+        percentiles = [histogram_percentile(before, after, f) for f in (0.5, 0.9, 0.99)]
+        if percentiles[0] is None:
+            print("device: no uploads recorded")
+        else:
+            print("device upload latency: " + "  ".join(
+                f"p{int(f * 100)} <= {'inf' if p is None or p == float('inf') else f'{p:.0f}'} ms"
+                for f, p in zip((0.5, 0.9, 0.99), percentiles)))
+    else:
+        succeeded = sum(1 for ok, _ in results if ok)
+        print(f"host clients: {len(results)} attempts, {len(results) - succeeded} failed")
+        report_latency("host upload latency", [seconds * 1000 for _, seconds in results])
+
+
+if __name__ == "__main__":
+    main()